@@ -11,7 +11,7 @@
          hold a value, but not both
      [ ] Variables that lack a value can contain restrictions on what their
          value can be (TODO: technically true, but need to make this usable)
-     [ ] Two Variables are equal if they hold the same type, if their value-
+     [X] Two Variables are equal if they hold the same type, if their value-
          holding status is the same, and, if they both hold a value, that those
 	 values are equivalent. If they both don't hold a value, they are equal
 	 if both of their restraints are equal.
@@ -51,27 +51,192 @@
       [X] How to wire-up params with predicates of the Rules (maybe use lambdas?)
 */
 #include <vector>
+#include <array>
+#include <tuple>
+#include <utility>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <memory>
 #include <string>
 #include <type_traits>
+#include <typeinfo>
+#include <functional>
+#include <algorithm>
+#include <deque>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <variant>
+#include <optional>
+#if __has_include(<sys/mman.h>)
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  define BACKTRACK_HAS_MMAP 1
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#  include <immintrin.h>
+#  define BACKTRACK_HAS_X86_KERNELS 1
+#endif
+
+template<typename T, typename = void>
+struct is_printable : std::false_type {};
+
+template<typename T>
+struct is_printable<T, std::void_t<decltype(std::declval<std::ostream&>() << std::declval<const T&>())>>
+    : std::true_type {};
+
+template<typename T, typename = void>
+struct is_less_comparable : std::false_type {};
+
+template<typename T>
+struct is_less_comparable<T, std::void_t<decltype(std::declval<const T&>() < std::declval<const T&>())>>
+    : std::true_type {};
+
+template<typename T, typename = void>
+struct is_hashable : std::false_type {};
+
+template<typename T>
+struct is_hashable<T, std::void_t<decltype(std::hash<T>{}(std::declval<const T&>()))>>
+    : std::true_type {};
 
 class IVariable {
 public:
     virtual bool can_unify(const IVariable &o) const = 0;
+    // Structural equality as described above, unlike can_unify
+    virtual bool equals(const IVariable &o) const = 0;
+    // Consistent with equals(); only bound values contribute beyond the type
+    virtual std::size_t hash() const = 0;
+    // The hash of this parameter's type alone (hash() when unbound)
+    virtual std::size_t type_hash() const = 0;
+    // Negative, zero or positive as this sorts before, with or after o:
+    // first by type, then by value. Values whose type has no operator< are
+    // ordered by hash, which is only a total order if is_ordered()
+    virtual int compare(const IVariable &o) const = 0;
+    virtual bool is_ordered() const = 0;
+    virtual bool is_unified() const = 0;
+    virtual bool is_constrained() const { return false; }
+    // "_" (or "_<slot>") when unbound, else the value if it can be printed
+    virtual std::string to_string() const = 0;
+    virtual std::unique_ptr<IVariable> clone() const = 0;
     virtual ~IVariable() {}
 };
 
+// A parameter that is not bound to any particular type or value, identified
+// by its position (slot) among the variables of one clause. This is what the
+// x in B(x) :- F(x), G(x) becomes
+struct Var {
+    std::size_t slot;
+};
+
+class LogicVariable : public IVariable {
+private:
+    std::size_t m_slot;
+public:
+    explicit LogicVariable(std::size_t slot) : m_slot(slot) {}
+
+    // Accepts any value; two unbound variables still can't unify
+    virtual bool can_unify(const IVariable &o) const override { return o.is_unified(); }
+
+    virtual bool equals(const IVariable &o) const override
+    {
+	return typeid(o) == typeid(LogicVariable)
+	    && static_cast<const LogicVariable&>(o).m_slot == m_slot;
+    }
+
+    virtual std::size_t hash() const override { return type_hash() + m_slot; }
+
+    virtual std::size_t type_hash() const override
+    {
+	static const std::size_t result = typeid(LogicVariable).hash_code();
+	return result;
+    }
+
+    virtual int compare(const IVariable &o) const override
+    {
+	if(typeid(o) != typeid(LogicVariable))
+	    return typeid(LogicVariable).before(typeid(o)) ? -1 : 1;
+	std::size_t other = static_cast<const LogicVariable&>(o).m_slot;
+	return m_slot < other ? -1 : m_slot > other;
+    }
+
+    virtual bool is_ordered() const override { return true; }
+
+    virtual bool is_unified() const override { return false; }
+
+    virtual std::string to_string() const override { return "_" + std::to_string(m_slot); }
+
+    virtual std::unique_ptr<IVariable> clone() const override
+    {
+	return std::make_unique<LogicVariable>(*this);
+    }
+
+    std::size_t slot() const { return m_slot; }
+};
+
 template<typename T>
 class Variable : public IVariable {
 public:
     using Predicate = bool(*)(const T&);
+    // One side of a comparison constraint
+    struct Bound {
+	T value;
+	bool inclusive;
+
+	bool operator==(const Bound &other) const
+	{
+	    return value == other.value && inclusive == other.inclusive;
+	}
+    };
 private:
     T m_value;
     bool m_has_value;
     std::vector<Predicate> m_constraints;
+    // Comparison constraints, which unlike Predicates can be read back (so
+    // a Database can answer them from a sorted index). Kept out of line and
+    // shared between copies, since few Variables have any
+    struct Range {
+	std::optional<Bound> lower, upper;
+    };
+    std::shared_ptr<const Range> m_range;
+
+    static const std::optional<Bound>& no_bound()
+    {
+	static const std::optional<Bound> none;
+	return none;
+    }
+
+    bool accepts(const T &value) const
+    {
+	if constexpr(is_less_comparable<T>::value) {
+	    if(m_range) {
+		const auto &lower = m_range->lower;
+		const auto &upper = m_range->upper;
+		if(lower && (lower->inclusive ? value < lower->value : !(lower->value < value)))
+		    return false;
+		if(upper && (upper->inclusive ? upper->value < value : !(value < upper->value)))
+		    return false;
+	    }
+	}
+	for(const auto &predicate : m_constraints) {
+	    if(!predicate(value))
+		return false;
+	}
+	return true;
+    }
 public:
-    Variable() : m_has_value(false) {}
+    Variable() : m_value(), m_has_value(false) {}
 
     Variable(T value) : m_value(value), m_has_value(true)
     {}
@@ -80,6 +245,8 @@ public:
 
     virtual bool can_unify(const IVariable &o) const override
     {
+	if(typeid(o) == typeid(LogicVariable))
+	    return o.can_unify(*this);
 	if(typeid(*this) != typeid(o))
 	    // No way to unify if underlying types differ
 	    return false;
@@ -87,18 +254,10 @@ public:
 
 	if(is_unified() && !other.is_unified()) {
 	    // This Variable has a value; can other accept that value?
-	    for(const auto &predicate : other.m_constraints) {
-		if(!predicate(m_value))
-		    return false;
-	    }
-	    return true;
+	    return other.accepts(m_value);
 	} else if(!is_unified() && other.is_unified()) {
 	    // Other has a value; can this Variable accept that value?
-	    for(const auto &predicate : m_constraints) {
-		if(!predicate(other.m_value))
-		    return false;
-	    }
-	    return true;
+	    return accepts(other.m_value);
 	} else {
 	    // If both have values, are they equivalent?
 	    return is_unified() && other.is_unified()
@@ -107,7 +266,94 @@ public:
 	return true;
     }
 
-    bool is_unified() const { return m_has_value; }
+    virtual bool equals(const IVariable &o) const override
+    {
+	if(typeid(*this) != typeid(o))
+	    return false;
+	const auto &other = static_cast<const Variable<T>&>(o);
+	if(m_has_value != other.m_has_value)
+	    return false;
+	if(m_has_value)
+	    return m_value == other.m_value;
+	return m_constraints == other.m_constraints && lower() == other.lower()
+	    && upper() == other.upper();
+    }
+
+    virtual std::size_t hash() const override
+    {
+	if constexpr(is_hashable<T>::value) {
+	    if(m_has_value)
+		return type_hash() * 31 + std::hash<T>{}(m_value);
+	}
+	return type_hash();
+    }
+
+    virtual std::size_t type_hash() const override
+    {
+	// hash_code() hashes the type's name on every call
+	static const std::size_t result = typeid(T).hash_code();
+	return result;
+    }
+
+    virtual int compare(const IVariable &o) const override
+    {
+	if(typeid(*this) != typeid(o))
+	    return typeid(*this).before(typeid(o)) ? -1 : 1;
+	const auto &other = static_cast<const Variable<T>&>(o);
+	if(m_has_value != other.m_has_value)
+	    return m_has_value ? 1 : -1;
+	if(!m_has_value)
+	    return 0;
+	if constexpr(is_less_comparable<T>::value) {
+	    return m_value < other.m_value ? -1 : other.m_value < m_value;
+	} else {
+	    std::size_t a = hash(), b = other.hash();
+	    return a < b ? -1 : a > b;
+	}
+    }
+
+    virtual bool is_ordered() const override { return is_less_comparable<T>::value; }
+
+    virtual bool is_unified() const override { return m_has_value; }
+
+    virtual bool is_constrained() const override
+    {
+	return !m_constraints.empty() || m_range;
+    }
+
+    const T& value() const { return m_value; }
+
+    // The comparison constraints, if any
+    const std::optional<Bound>& lower() const
+    {
+	return m_range ? m_range->lower : no_bound();
+    }
+
+    const std::optional<Bound>& upper() const
+    {
+	return m_range ? m_range->upper : no_bound();
+    }
+
+    // How many Predicates (as opposed to comparisons) constrain this Variable
+    std::size_t constraint_count() const { return m_constraints.size(); }
+
+    virtual std::string to_string() const override
+    {
+	if(!m_has_value)
+	    return "_";
+	if constexpr(is_printable<T>::value) {
+	    std::ostringstream out;
+	    out << m_value;
+	    return out.str();
+	} else {
+	    return "?";
+	}
+    }
+
+    virtual std::unique_ptr<IVariable> clone() const override
+    {
+	return std::make_unique<Variable<T>>(*this);
+    }
 
     bool constrain(Predicate constraint)
     {
@@ -117,12 +363,41 @@ public:
 	return true;
     }
 
-    bool set_value(T new_value)
+    // Only values above bound (or equal to it, if or_equal) can unify; a
+    // tighter earlier bound is kept. Needs T's operator<
+    bool constrain_greater(T bound, bool or_equal = false)
     {
-	for(const auto &predicate : m_constraints) {
-	    if(!predicate(new_value))
-		return false;
+	static_assert(is_less_comparable<T>::value, "comparison constraints need operator<");
+	if(m_has_value)
+	    return false;
+	const auto &lower = this->lower();
+	if(!lower || lower->value < bound || (!(bound < lower->value) && !or_equal)) {
+	    Range range = m_range ? *m_range : Range();
+	    range.lower = Bound{bound, or_equal};
+	    m_range = std::make_shared<const Range>(std::move(range));
 	}
+	return true;
+    }
+
+    // Only values below bound (or equal to it, if or_equal) can unify
+    bool constrain_less(T bound, bool or_equal = false)
+    {
+	static_assert(is_less_comparable<T>::value, "comparison constraints need operator<");
+	if(m_has_value)
+	    return false;
+	const auto &upper = this->upper();
+	if(!upper || bound < upper->value || (!(upper->value < bound) && !or_equal)) {
+	    Range range = m_range ? *m_range : Range();
+	    range.upper = Bound{bound, or_equal};
+	    m_range = std::make_shared<const Range>(std::move(range));
+	}
+	return true;
+    }
+
+    bool set_value(T new_value)
+    {
+	if(!accepts(new_value))
+	    return false;
 	m_value = new_value;
 	m_has_value = true;
 	return true;
@@ -133,24 +408,117 @@ public:
 template<typename T>
 struct Type {};
 
+// An interned string; compares and hashes as a single integer
+struct Symbol {
+    std::uint32_t id;
+
+    bool operator==(Symbol other) const { return id == other.id; }
+    bool operator!=(Symbol other) const { return id != other.id; }
+    // Order of interning, not alphabetical
+    bool operator<(Symbol other) const { return id < other.id; }
+};
+
+namespace std {
+    template<>
+    struct hash<Symbol> {
+	std::size_t operator()(Symbol symbol) const { return symbol.id; }
+    };
+}
+
+class SymbolTable {
+private:
+    // A deque never moves its elements, so the views in m_ids stay valid
+    std::deque<std::string> m_names;
+    std::unordered_map<std::string_view, Symbol> m_ids;
+public:
+    SymbolTable() = default;
+
+    // The copy's m_ids views its own names
+    SymbolTable(const SymbolTable &other) : m_names(other.m_names)
+    {
+	for(std::size_t id = 0; id < m_names.size(); ++id)
+	    m_ids.emplace(m_names[id], Symbol{static_cast<std::uint32_t>(id)});
+    }
+
+    SymbolTable(SymbolTable&&) = default;
+
+    SymbolTable& operator=(const SymbolTable &other)
+    {
+	if(this != &other)
+	    *this = SymbolTable(other);
+	return *this;
+    }
+
+    SymbolTable& operator=(SymbolTable&&) = default;
+
+    Symbol intern(std::string_view name)
+    {
+	auto match = m_ids.find(name);
+	if(match != m_ids.end())
+	    return match->second;
+	Symbol symbol{static_cast<std::uint32_t>(m_names.size())};
+	m_names.emplace_back(name);
+	m_ids.emplace(m_names.back(), symbol);
+	return symbol;
+    }
+
+    std::string_view name(Symbol symbol) const { return m_names.at(symbol.id); }
+
+    std::size_t size() const { return m_names.size(); }
+};
+
+// How many predicates an enum used to name them (see BasicDatabase) has:
+// Name::Count unless specialized, so Count should be the last enumerator
+template<typename Name>
+struct name_count
+    : std::integral_constant<std::size_t, static_cast<std::size_t>(Name::Count)> {};
+
+// The name that stands for an enumerator wherever a predicate needs a string
+template<typename Name>
+std::string predicate_name(Name name)
+{
+    return "#" + std::to_string(static_cast<std::size_t>(name));
+}
+
 // Holds params, but no predicates
 class RuleVariable {
+public:
+    static constexpr std::size_t no_predicate = std::numeric_limits<std::size_t>::max();
 private:
     std::string m_name;
+    // The enumerator's value, for names given as one
+    std::size_t m_predicate = no_predicate;
     std::vector<std::unique_ptr<IVariable>> m_params;
-
+public:
     template<typename T>
     void add_param(Type<T>)
     {
 	m_params.emplace_back(new Variable<T>());
     }
 
+    void add_param(Var new_param)
+    {
+	m_params.emplace_back(new LogicVariable(new_param.slot));
+    }
+
+    // E.g. an unbound Variable with comparison constraints
+    template<typename T>
+    void add_param(Variable<T> new_param)
+    {
+	m_params.emplace_back(new Variable<T>(std::move(new_param)));
+    }
+
     template<typename T>
     void add_param(T new_param)
     {
 	m_params.emplace_back(new Variable<T>(new_param));
     }
-public:
+
+    void add_param(std::unique_ptr<IVariable> new_param)
+    {
+	m_params.push_back(std::move(new_param));
+    }
+
     template<typename ...Params>
     RuleVariable(std::string name, Params... params)
 	: m_name(name)
@@ -158,15 +526,48 @@ public:
 	(add_param(params), ...);
     }
 
+    template<typename Name, typename ...Params,
+	     typename = std::enable_if_t<std::is_enum_v<Name>>>
+    RuleVariable(Name name, Params... params)
+	: m_name(predicate_name(name)), m_predicate(static_cast<std::size_t>(name))
+    {
+	(add_param(params), ...);
+    }
+
     bool can_unify(const class Rule &other) const;
 
     const auto& name() const { return m_name; }
 
+    // The enumerator this was named by, or no_predicate
+    std::size_t predicate() const { return m_predicate; }
+
+    std::size_t arity() const { return m_params.size(); }
+
+    // Same name and pairwise structurally equal params
+    bool equals(const RuleVariable &other) const
+    {
+	if(m_name != other.m_name || m_params.size() != other.m_params.size())
+	    return false;
+	for(std::size_t i = 0; i < m_params.size(); ++i) {
+	    if(!m_params[i]->equals(*other.m_params[i]))
+		return false;
+	}
+	return true;
+    }
+
     const IVariable* operator[](std::size_t index) const
     {
         return m_params.at(index).get();
     }
 
+    // Calls visit(param) on each param, which visit may change in place
+    template<typename Visitor>
+    void for_each_param(Visitor visit)
+    {
+	for(auto &param : m_params)
+	    visit(*param);
+    }
+
     bool operator==(const RuleVariable &other) const
     {
 	// Note: checks for same addresses of params, not same values
@@ -178,13 +579,44 @@ public:
 class Rule : public RuleVariable {
 private:
     std::vector<RuleVariable> m_predicates;
+    bool m_keeps_order = false;
 public:
     using RuleVariable::RuleVariable;
+
+    // Stops the Database from reordering this Rule's predicates
+    auto& keep_order()
+    {
+	m_keeps_order = true;
+	return *this;
+    }
+
+    bool keeps_order() const { return m_keeps_order; }
     
     bool can_unify(const Rule &) const { return false; }
 
+    bool equals(const Rule &other) const
+    {
+	if(!RuleVariable::equals(other)
+	   || m_predicates.size() != other.m_predicates.size())
+	    return false;
+	for(std::size_t i = 0; i < m_predicates.size(); ++i) {
+	    if(!m_predicates[i].equals(other.m_predicates[i]))
+		return false;
+	}
+	return true;
+    }
+
     const auto& predicates() const { return m_predicates; }
 
+    // Calls visit(param) on each param of the head, then of each predicate
+    template<typename Visitor>
+    void for_each_param(Visitor visit)
+    {
+	RuleVariable::for_each_param(visit);
+	for(auto &predicate : m_predicates)
+	    predicate.for_each_param(visit);
+    }
+
     auto& operator<<(RuleVariable &&predicate)
     {
 	m_predicates.push_back(std::move(predicate));
@@ -208,36 +640,6819 @@ bool RuleVariable::can_unify(const Rule &other) const
 }
 
 
-class Database {
+// Read-only view of a whole file, memory-mapped where the platform allows
+class MappedFile {
 private:
-    std::map<std::string, std::vector<Rule*>> m_rules;
+    const char *m_data = nullptr;
+    std::size_t m_size = 0;
+    bool m_is_mapped = false;
+    bool m_is_open = false;
+    std::string m_fallback;
 public:
-    void add_rule(Rule &new_rule)
+    // sequential hints that the file will be read front to back once
+    explicit MappedFile(const std::string &path, bool sequential = true)
+    {
+#ifdef BACKTRACK_HAS_MMAP
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+	    return;
+	struct stat info;
+	if(::fstat(fd, &info) == 0) {
+	    m_size = static_cast<std::size_t>(info.st_size);
+	    m_is_open = true;
+	    if(m_size > 0) {
+		void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data != MAP_FAILED) {
+		    if(sequential)
+			::madvise(data, m_size, MADV_SEQUENTIAL);
+		    m_data = static_cast<const char*>(data);
+		    m_is_mapped = true;
+		} else {
+		    m_is_open = false;
+		}
+	    }
+	}
+	::close(fd);
+#else
+	(void)sequential;
+	std::ifstream file(path, std::ios::binary);
+	if(!file)
+	    return;
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	m_fallback = contents.str();
+	m_data = m_fallback.data();
+	m_size = m_fallback.size();
+	m_is_open = true;
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
     {
-	m_rules[new_rule.name()].push_back(&new_rule);
+#ifdef BACKTRACK_HAS_MMAP
+	if(m_is_mapped)
+	    ::munmap(const_cast<char*>(m_data), m_size);
+#endif
     }
-    
-    bool query(const RuleVariable &conjecture)
+
+    bool is_open() const { return m_is_open; }
+
+    std::string_view contents() const { return {m_data, m_size}; }
+};
+
+
+// Parses facts and Horn clauses written in Prolog syntax, e.g.
+//   F(3).
+//   B(x) :- F(x), G(x).
+// Numbers become int (long long or double when needed), and quoted text and
+// lowercase names become interned Symbols. Names starting with an uppercase
+// letter or '_' are variables, as are names used in the head of a rule (which
+// is how horne-clause-examples.txt writes them). Queries ("?- ...") and
+// comments are skipped. Tokens are views into the source text, so nothing is
+// copied until a Rule is built
+class ClauseParser {
+private:
+    struct Term {
+	enum class Kind { Integer, BigInteger, Real, Quoted, Name } kind;
+	std::string_view text;
+	long long integer;
+	double real;
+    };
+
+    std::string_view m_text;
+    std::size_t m_pos = 0;
+    std::size_t m_line = 1;
+    SymbolTable &m_symbols;
+    std::string m_error;
+    // Names of the current clause's variables, in slot order
+    std::vector<std::string_view> m_variables;
+    std::vector<std::string_view> m_head_names;
+    std::vector<Term> m_terms;
+
+    static bool is_name_start(char c)
     {
-	if(m_rules.count(conjecture.name()) < 1)
-	    return false;
-	const auto &rule_vec = m_rules[conjecture.name()];
-	for(const auto *rule : rule_vec) {
-	    if(conjecture.can_unify(*rule)) {
-	        for(const auto &each : rule->predicates()) {
-                    if(!query(each))
-                        return false;
-                }
-                return true;
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    static bool is_name_char(char c) { return is_name_start(c) || (c >= '0' && c <= '9'); }
+
+    bool at_end() const { return m_pos >= m_text.size(); }
+
+    char peek(std::size_t offset = 0) const
+    {
+	return m_pos + offset < m_text.size() ? m_text[m_pos + offset] : '\0';
+    }
+
+    bool fail(const char *message)
+    {
+	m_error = message;
+	return false;
+    }
+
+    void skip_space()
+    {
+	while(!at_end()) {
+	    char c = m_text[m_pos];
+	    if(c == '\n') {
+		++m_line;
+		++m_pos;
+	    } else if(c == ' ' || c == '\t' || c == '\r') {
+		++m_pos;
+	    } else if(c == '%') {
+		auto end = m_text.find('\n', m_pos);
+		m_pos = end == std::string_view::npos ? m_text.size() : end;
+	    } else if(c == '/' && peek(1) == '*') {
+		auto end = m_text.find("*/", m_pos + 2);
+		end = end == std::string_view::npos ? m_text.size() : end + 2;
+		m_line += std::count(m_text.begin() + m_pos, m_text.begin() + end, '\n');
+		m_pos = end;
+	    } else {
+		break;
 	    }
 	}
-	return false;
     }
 
-    template<typename ...Args>
-    bool query(std::string name, Args... args)
+    bool expect(char c, const char *message)
     {
-        return query(RuleVariable{name, args...});
+	skip_space();
+	if(peek() != c)
+	    return fail(message);
+	++m_pos;
+	return true;
     }
+
+    std::string_view parse_name()
+    {
+	std::size_t start = m_pos;
+	while(!at_end() && is_name_char(m_text[m_pos]))
+	    ++m_pos;
+	return m_text.substr(start, m_pos - start);
+    }
+
+    bool parse_term(Term &term)
+    {
+	skip_space();
+	char c = peek();
+	const char *first = m_text.data() + m_pos;
+	const char *last = m_text.data() + m_text.size();
+	if(c == '\'' || c == '"') {
+	    auto end = m_text.find(c, m_pos + 1);
+	    if(end == std::string_view::npos)
+		return fail("unterminated quoted atom");
+	    term.kind = Term::Kind::Quoted;
+	    term.text = m_text.substr(m_pos + 1, end - m_pos - 1);
+	    m_pos = end + 1;
+	} else if(is_name_start(c)) {
+	    term.kind = Term::Kind::Name;
+	    term.text = parse_name();
+	} else if((c >= '0' && c <= '9') || c == '-') {
+	    std::size_t end = m_pos + 1;
+	    bool is_real = false;
+	    while(end < m_text.size()) {
+		char d = m_text[end];
+		if(d == '.' || d == 'e' || d == 'E') {
+		    // A '.' not followed by a digit ends the clause
+		    char next = end + 1 < m_text.size() ? m_text[end + 1] : '\0';
+		    if(d == '.' && !(next >= '0' && next <= '9'))
+			break;
+		    is_real = true;
+		    if(d != '.' && (next == '-' || next == '+'))
+			++end;
+		} else if(!(d >= '0' && d <= '9')) {
+		    break;
+		}
+		++end;
+	    }
+	    std::from_chars_result result;
+	    if(is_real) {
+		term.kind = Term::Kind::Real;
+		result = std::from_chars(first, last, term.real);
+	    } else {
+		result = std::from_chars(first, last, term.integer);
+		term.kind = term.integer >= std::numeric_limits<int>::min()
+		    && term.integer <= std::numeric_limits<int>::max()
+		    ? Term::Kind::Integer : Term::Kind::BigInteger;
+	    }
+	    if(result.ec != std::errc() || result.ptr != m_text.data() + end)
+		return fail("malformed number");
+	    m_pos = end;
+	} else {
+	    return fail("expected a number, name or quoted atom");
+	}
+	return true;
+    }
+
+    std::size_t slot(std::string_view name)
+    {
+	if(name != "_") {
+	    auto match = std::find(m_variables.begin(), m_variables.end(), name);
+	    if(match != m_variables.end())
+		return match - m_variables.begin();
+	}
+	m_variables.push_back(name);
+	return m_variables.size() - 1;
+    }
+
+    void add_param(RuleVariable &target, const Term &term, bool name_is_variable)
+    {
+	switch(term.kind) {
+	case Term::Kind::Integer:
+	    target.add_param(static_cast<int>(term.integer));
+	    break;
+	case Term::Kind::BigInteger:
+	    target.add_param(term.integer);
+	    break;
+	case Term::Kind::Real:
+	    target.add_param(term.real);
+	    break;
+	case Term::Kind::Quoted:
+	    target.add_param(m_symbols.intern(term.text));
+	    break;
+	case Term::Kind::Name:
+	    if(name_is_variable)
+		target.add_param(Var{slot(term.text)});
+	    else
+		target.add_param(m_symbols.intern(term.text));
+	    break;
+	}
+    }
+
+    bool is_variable_name(std::string_view name, bool in_rule_head) const
+    {
+	return in_rule_head || !(name[0] >= 'a' && name[0] <= 'z')
+	    || std::find(m_head_names.begin(), m_head_names.end(), name) != m_head_names.end();
+    }
+
+    // Parses name(term, ...) into m_terms, returning the name
+    bool parse_goal(std::string_view &name)
+    {
+	skip_space();
+	if(!is_name_start(peek()))
+	    return fail("expected a fact or rule name");
+	name = parse_name();
+	m_terms.clear();
+	skip_space();
+	if(peek() != '(')
+	    return true;
+	do {
+	    ++m_pos;
+	    m_terms.emplace_back();
+	    if(!parse_term(m_terms.back()))
+		return false;
+	    skip_space();
+	} while(peek() == ',');
+	return expect(')', "expected ',' or ')'");
+    }
+
+    template<typename Sink>
+    bool parse_clause(Sink &sink)
+    {
+	m_variables.clear();
+	m_head_names.clear();
+	std::string_view name;
+	if(!parse_goal(name))
+	    return false;
+	skip_space();
+	bool is_rule = peek() == ':' && peek(1) == '-';
+	Rule rule{std::string(name)};
+	for(const auto &term : m_terms) {
+	    if(is_rule && term.kind == Term::Kind::Name)
+		m_head_names.push_back(term.text);
+	    add_param(rule, term, term.kind == Term::Kind::Name
+		      && is_variable_name(term.text, is_rule));
+	}
+	if(is_rule) {
+	    ++m_pos;
+	    do {
+		++m_pos;
+		if(!parse_goal(name))
+		    return false;
+		RuleVariable goal{std::string(name)};
+		for(const auto &term : m_terms) {
+		    add_param(goal, term, term.kind == Term::Kind::Name
+			      && is_variable_name(term.text, false));
+		}
+		rule << std::move(goal);
+		skip_space();
+	    } while(peek() == ',');
+	}
+	if(!expect('.', "expected '.' at end of clause"))
+	    return false;
+	sink(std::move(rule));
+	return true;
+    }
+public:
+    ClauseParser(std::string_view text, SymbolTable &symbols)
+	: m_text(text), m_symbols(symbols)
+    {}
+
+    // Splits text into at most piece_count pieces, each ending after a '.'
+    // that ends a line, so that the pieces can be parsed independently. A
+    // '.' inside a comment or quoted atom doesn't end anything
+    static std::vector<std::string_view> split(std::string_view text, std::size_t piece_count)
+    {
+	std::vector<std::string_view> pieces;
+	std::size_t start = 0;
+	// The last character that isn't space, a comment or in quotes
+	char last = '\0';
+	std::size_t pos = 0;
+	while(pos < text.size() && pieces.size() + 1 < piece_count) {
+	    char c = text[pos];
+	    std::size_t next = pos + 1;
+	    if(c == '%') {
+		// The newline ending the comment is looked at next
+		next = std::min(text.find('\n', pos), text.size());
+	    } else if(c == '/' && next < text.size() && text[next] == '*') {
+		next = text.find("*/", pos + 2);
+		next = next == std::string_view::npos ? text.size() : next + 2;
+	    } else if(c == '\'' || c == '"') {
+		next = text.find(c, pos + 1);
+		next = next == std::string_view::npos ? text.size() : next + 1;
+		last = c;
+	    } else if(c == '\n') {
+		if(last == '.' && pos >= text.size() * (pieces.size() + 1) / piece_count) {
+		    pieces.push_back(text.substr(start, next - start));
+		    start = next;
+		    last = '\0';
+		}
+	    } else if(c != ' ' && c != '\t' && c != '\r') {
+		last = c;
+	    }
+	    pos = next;
+	}
+	if(start < text.size() || pieces.empty())
+	    pieces.push_back(text.substr(start));
+	return pieces;
+    }
+
+    // Calls sink(Rule&&) for each clause; returns false on the first syntax
+    // error (see error() and line())
+    template<typename Sink>
+    bool parse(Sink sink)
+    {
+	while(true) {
+	    skip_space();
+	    if(at_end())
+		return true;
+	    if(peek() == '?' && peek(1) == '-') {
+		// Skip the query up to its terminating '.'
+		m_pos += 2;
+		while(!at_end() && !(peek() == '.' && !(peek(1) >= '0' && peek(1) <= '9'))) {
+		    if(peek() == '\n')
+			++m_line;
+		    ++m_pos;
+		}
+		if(!expect('.', "expected '.' at end of query"))
+		    return false;
+		continue;
+	    }
+	    if(!parse_clause(sink))
+		return false;
+	}
+    }
+
+    const std::string& error() const { return m_error; }
+
+    std::size_t line() const { return m_line; }
+
+    std::size_t position() const { return m_pos; }
+};
+
+
+struct LoadResult {
+    std::size_t clause_count = 0;
+    std::size_t byte_count = 0;
+    // Line of the first syntax error; 0 if loading succeeded
+    std::size_t error_line = 0;
+    std::string error;
+
+    explicit operator bool() const { return error.empty(); }
+};
+
+
+// Layout of the files written by Database::save() and read in place by
+// MappedDatabase. Every offset is relative to the start of the file and every
+// record is 8-byte aligned, so the file can be mapped anywhere and used
+// without a deserialization pass. Values are stored in host byte order
+struct SnapshotFormat {
+    static constexpr char magic[8] = {'B', 'K', 'T', 'R', 'A', 'C', 'K', '\0'};
+    static constexpr std::uint32_t version = 1;
+    static constexpr std::uint32_t byte_order_mark = 0x01020304;
+    static constexpr std::uint32_t no_predicate = 0xffffffff;
+
+    struct Header {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byte_order_mark;
+	std::uint64_t symbol_count;
+	// SymbolEntry[symbol_count], indexed by Symbol::id
+	std::uint64_t symbols_offset;
+	// std::uint32_t[symbol_count] of Symbol ids, sorted by name
+	std::uint64_t sorted_symbols_offset;
+	std::uint64_t predicate_count;
+	// PredicateEntry[predicate_count], sorted by name
+	std::uint64_t predicates_offset;
+    };
+
+    struct SymbolEntry {
+	std::uint64_t offset;
+	std::uint64_t length;
+    };
+
+    struct PredicateEntry {
+	std::uint64_t name_offset;
+	std::uint64_t name_length;
+	std::uint64_t clause_count;
+	// std::uint64_t[clause_count] of ClauseRecord offsets
+	std::uint64_t clauses_offset;
+	// IndexEntry[indexed_count], sorted; the first-param index of Database
+	std::uint64_t indexed_count;
+	std::uint64_t indexed_offset;
+	// std::uint64_t[unindexed_count] of clause positions
+	std::uint64_t unindexed_count;
+	std::uint64_t unindexed_offset;
+    };
+
+    struct IndexEntry {
+	std::uint64_t hash;
+	std::uint64_t position;
+    };
+
+    enum class Type : std::uint8_t { Int, BigInt, Real, Symbol, Var, Other };
+
+    // One param; the payload holds the value (or slot of a Var) when bound
+    struct Cell {
+	Type type;
+	std::uint8_t is_bound;
+	std::uint8_t padding[6];
+	std::uint64_t payload;
+    };
+
+    // Followed directly by Cell[arity]
+    struct ClauseRecord {
+	std::uint32_t arity;
+	std::uint32_t goal_count;
+	// GoalRecord[goal_count]
+	std::uint64_t goals_offset;
+    };
+
+    struct GoalRecord {
+	// Position in the predicate table, or no_predicate
+	std::uint32_t predicate;
+	std::uint32_t arity;
+	// Cell[arity]
+	std::uint64_t cells_offset;
+    };
+
+    template<typename T>
+    static std::uint64_t to_payload(T value)
+    {
+	static_assert(sizeof(T) <= sizeof(std::uint64_t));
+	std::uint64_t payload = 0;
+	if constexpr(std::is_same_v<T, double>) {
+	    if(value == 0)
+		value = 0; // -0.0 and 0.0 must compare and hash alike
+	}
+	std::memcpy(&payload, &value, sizeof(T));
+	return payload;
+    }
+
+    template<typename T>
+    static bool typed_cell(const IVariable &param, Type type, Cell &cell)
+    {
+	auto *variable = dynamic_cast<const Variable<T>*>(&param);
+	if(!variable)
+	    return false;
+	cell.type = type;
+	cell.is_bound = variable->is_unified();
+	cell.payload = variable->is_unified() ? to_payload(variable->value()) : 0;
+	return true;
+    }
+
+    // Returns false if param can't be stored (other types, constraints).
+    // cell is still usable in queries, where it can only unify with a Var
+    static bool to_cell(const IVariable &param, Cell &cell)
+    {
+	cell = Cell{};
+	if(auto *variable = dynamic_cast<const LogicVariable*>(&param)) {
+	    cell.type = Type::Var;
+	    cell.payload = variable->slot();
+	    return true;
+	}
+	if(typed_cell<int>(param, Type::Int, cell)
+	   || typed_cell<long long>(param, Type::BigInt, cell)
+	   || typed_cell<double>(param, Type::Real, cell)
+	   || typed_cell<Symbol>(param, Type::Symbol, cell))
+	    return !param.is_constrained();
+	cell.type = Type::Other;
+	cell.is_bound = param.is_unified();
+	return false;
+    }
+
+    static bool is_indexable(const Cell &cell) { return cell.is_bound && cell.type != Type::Var; }
+
+    static std::uint64_t hash(const Cell &cell)
+    {
+	return (cell.payload * 0x9e3779b97f4a7c15ull) ^ static_cast<std::uint64_t>(cell.type);
+    }
+
+    // Mirrors Variable<T>::can_unify and LogicVariable::can_unify
+    static bool can_unify(const Cell &a, const Cell &b)
+    {
+	if(a.type == Type::Var)
+	    return b.type != Type::Var && b.is_bound;
+	if(b.type == Type::Var)
+	    return a.is_bound;
+	if(a.type != b.type || a.type == Type::Other)
+	    return false;
+	if(a.is_bound != b.is_bound)
+	    return true;
+	if(!a.is_bound)
+	    return false;
+	if(a.type == Type::Real) {
+	    double x, y;
+	    std::memcpy(&x, &a.payload, sizeof(x));
+	    std::memcpy(&y, &b.payload, sizeof(y));
+	    return x == y;
+	}
+	return a.payload == b.payload;
+    }
+};
+
+
+// Estimates how many distinct hashes it has been given (HyperLogLog with 256
+// one-byte registers, about 6.5% standard error)
+class DistinctCounter {
+private:
+    std::uint8_t m_registers[256] = {};
+public:
+    void add(std::uint64_t hash)
+    {
+	// std::hash is the identity for integers, so mix the bits first
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+	std::uint8_t rank = 1;
+	for(std::uint64_t rest = hash << 8; rank < 57 && !(rest & (1ull << 63)); rest <<= 1)
+	    ++rank;
+	auto &slot = m_registers[hash >> 56];
+	slot = std::max(slot, rank);
+    }
+
+    double estimate() const
+    {
+	constexpr double m = 256;
+	double sum = 0;
+	int empty = 0;
+	for(auto rank : m_registers) {
+	    sum += std::ldexp(1.0, -rank);
+	    empty += rank == 0;
+	}
+	double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+	if(estimate <= 2.5 * m && empty > 0)
+	    return m * std::log(m / empty);
+	return estimate;
+    }
+};
+
+
+// Filters over contiguous column values that set bit i % 64 of bits[i / 64]
+// when row i passes, overwriting the (count + 63) / 64 words. x86 builds
+// pick AVX2 or SSE2 versions at run time; the scalar loops are the fallback
+// and the reference
+class ScanKernels {
+public:
+    enum class Level { Scalar, SSE2, AVX2 };
+private:
+    static Level& selected()
+    {
+	static Level level = supported();
+	return level;
+    }
+
+    template<typename T>
+    static void between_scalar(const T *values, std::size_t count, T low, T high, std::uint64_t *bits)
+    {
+	for(std::size_t word = 0; word * 64 < count; ++word) {
+	    std::size_t end = std::min<std::size_t>(64, count - word * 64);
+	    const T *block = values + word * 64;
+	    std::uint64_t mask = 0;
+	    for(std::size_t i = 0; i < end; ++i)
+		mask |= static_cast<std::uint64_t>(!(block[i] < low) && !(high < block[i])) << i;
+	    bits[word] = mask;
+	}
+    }
+#ifdef BACKTRACK_HAS_X86_KERNELS
+    // Each kernel handles whole vectors of each 64-row word and leaves the
+    // rest of the word to between_scalar's comparison
+    template<typename T>
+    static std::uint64_t tail(const T *block, std::size_t from, std::size_t end, T low, T high)
+    {
+	std::uint64_t mask = 0;
+	for(std::size_t i = from; i < end; ++i)
+	    mask |= static_cast<std::uint64_t>(!(block[i] < low) && !(high < block[i])) << i;
+	return mask;
+    }
+
+    __attribute__((target("avx2")))
+    static void between_avx2(const std::int32_t *values, std::size_t count, std::int32_t low,
+			     std::int32_t high, std::uint64_t *bits)
+    {
+	__m256i below = _mm256_set1_epi32(low), above = _mm256_set1_epi32(high);
+	for(std::size_t word = 0; word * 64 < count; ++word) {
+	    std::size_t end = std::min<std::size_t>(64, count - word * 64), i = 0;
+	    const std::int32_t *block = values + word * 64;
+	    std::uint64_t mask = 0;
+	    for(; i + 8 <= end; i += 8) {
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+		__m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(below, x), _mm256_cmpgt_epi32(x, above));
+		auto lanes = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(out)));
+		mask |= static_cast<std::uint64_t>(~lanes & 0xffu) << i;
+	    }
+	    bits[word] = mask | tail(block, i, end, low, high);
+	}
+    }
+
+    __attribute__((target("avx2")))
+    static void between_avx2(const long long *values, std::size_t count, long long low,
+			     long long high, std::uint64_t *bits)
+    {
+	__m256i below = _mm256_set1_epi64x(low), above = _mm256_set1_epi64x(high);
+	for(std::size_t word = 0; word * 64 < count; ++word) {
+	    std::size_t end = std::min<std::size_t>(64, count - word * 64), i = 0;
+	    const long long *block = values + word * 64;
+	    std::uint64_t mask = 0;
+	    for(; i + 4 <= end; i += 4) {
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+		__m256i out = _mm256_or_si256(_mm256_cmpgt_epi64(below, x), _mm256_cmpgt_epi64(x, above));
+		auto lanes = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(out)));
+		mask |= static_cast<std::uint64_t>(~lanes & 0xfu) << i;
+	    }
+	    bits[word] = mask | tail(block, i, end, low, high);
+	}
+    }
+
+    __attribute__((target("avx2")))
+    static void between_avx2(const double *values, std::size_t count, double low, double high,
+			     std::uint64_t *bits)
+    {
+	__m256d below = _mm256_set1_pd(low), above = _mm256_set1_pd(high);
+	for(std::size_t word = 0; word * 64 < count; ++word) {
+	    std::size_t end = std::min<std::size_t>(64, count - word * 64), i = 0;
+	    const double *block = values + word * 64;
+	    std::uint64_t mask = 0;
+	    for(; i + 4 <= end; i += 4) {
+		__m256d x = _mm256_loadu_pd(block + i);
+		__m256d in = _mm256_and_pd(_mm256_cmp_pd(x, below, _CMP_GE_OQ),
+					   _mm256_cmp_pd(x, above, _CMP_LE_OQ));
+		mask |= static_cast<std::uint64_t>(_mm256_movemask_pd(in)) << i;
+	    }
+	    bits[word] = mask | tail(block, i, end, low, high);
+	}
+    }
+
+    __attribute__((target("sse2")))
+    static void between_sse2(const std::int32_t *values, std::size_t count, std::int32_t low,
+			     std::int32_t high, std::uint64_t *bits)
+    {
+	__m128i below = _mm_set1_epi32(low), above = _mm_set1_epi32(high);
+	for(std::size_t word = 0; word * 64 < count; ++word) {
+	    std::size_t end = std::min<std::size_t>(64, count - word * 64), i = 0;
+	    const std::int32_t *block = values + word * 64;
+	    std::uint64_t mask = 0;
+	    for(; i + 4 <= end; i += 4) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+		__m128i out = _mm_or_si128(_mm_cmpgt_epi32(below, x), _mm_cmpgt_epi32(x, above));
+		auto lanes = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(out)));
+		mask |= static_cast<std::uint64_t>(~lanes & 0xfu) << i;
+	    }
+	    bits[word] = mask | tail(block, i, end, low, high);
+	}
+    }
+
+    __attribute__((target("sse2")))
+    static void between_sse2(const double *values, std::size_t count, double low, double high,
+			     std::uint64_t *bits)
+    {
+	__m128d below = _mm_set1_pd(low), above = _mm_set1_pd(high);
+	for(std::size_t word = 0; word * 64 < count; ++word) {
+	    std::size_t end = std::min<std::size_t>(64, count - word * 64), i = 0;
+	    const double *block = values + word * 64;
+	    std::uint64_t mask = 0;
+	    for(; i + 2 <= end; i += 2) {
+		__m128d x = _mm_loadu_pd(block + i);
+		__m128d in = _mm_and_pd(_mm_cmpge_pd(x, below), _mm_cmple_pd(x, above));
+		mask |= static_cast<std::uint64_t>(_mm_movemask_pd(in)) << i;
+	    }
+	    bits[word] = mask | tail(block, i, end, low, high);
+	}
+    }
+#endif
+public:
+    // The best level this CPU runs
+    static Level supported()
+    {
+#ifdef BACKTRACK_HAS_X86_KERNELS
+	if(__builtin_cpu_supports("avx2"))
+	    return Level::AVX2;
+	if(__builtin_cpu_supports("sse2"))
+	    return Level::SSE2;
+#endif
+	return Level::Scalar;
+    }
+
+    static Level level() { return selected(); }
+
+    // Position of the lowest set bit of a nonzero mask
+    static unsigned lowest_bit(std::uint64_t mask)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+	return static_cast<unsigned>(__builtin_ctzll(mask));
+#else
+	unsigned position = 0;
+	for(; !(mask & 1); mask >>= 1)
+	    ++position;
+	return position;
+#endif
+    }
+
+    // Limits the kernels to level (or the supported one, if lower), e.g. to
+    // compare them. Not safe while other threads are scanning
+    static void use(Level level) { selected() = std::min(level, supported()); }
+
+    // low <= values[i] <= high
+    static void between(const int *values, std::size_t count, int low, int high, std::uint64_t *bits)
+    {
+#ifdef BACKTRACK_HAS_X86_KERNELS
+	static_assert(sizeof(int) == sizeof(std::int32_t));
+	auto *ints = reinterpret_cast<const std::int32_t*>(values);
+	if(level() == Level::AVX2)
+	    return between_avx2(ints, count, low, high, bits);
+	if(level() == Level::SSE2)
+	    return between_sse2(ints, count, low, high, bits);
+#endif
+	between_scalar(values, count, low, high, bits);
+    }
+
+    static void between(const long long *values, std::size_t count, long long low, long long high,
+			std::uint64_t *bits)
+    {
+#ifdef BACKTRACK_HAS_X86_KERNELS
+	if(level() == Level::AVX2)
+	    return between_avx2(values, count, low, high, bits);
+#endif
+	between_scalar(values, count, low, high, bits);
+    }
+
+    static void between(const double *values, std::size_t count, double low, double high,
+			std::uint64_t *bits)
+    {
+#ifdef BACKTRACK_HAS_X86_KERNELS
+	if(level() == Level::AVX2)
+	    return between_avx2(values, count, low, high, bits);
+	if(level() == Level::SSE2)
+	    return between_sse2(values, count, low, high, bits);
+#endif
+	between_scalar(values, count, low, high, bits);
+    }
+
+    // values[i] == key; a range of one value is an equality test
+    template<typename T>
+    static void equal(const T *values, std::size_t count, T key, std::uint64_t *bits)
+    {
+	between(values, count, key, key, bits);
+    }
+
+    // Symbols are only ever compared for equality, as their ids
+    static void equal(const Symbol *values, std::size_t count, Symbol key, std::uint64_t *bits)
+    {
+	static_assert(sizeof(Symbol) == sizeof(std::uint32_t));
+#ifdef BACKTRACK_HAS_X86_KERNELS
+	if(level() != Level::Scalar) {
+	    auto id = static_cast<std::int32_t>(key.id);
+	    auto *ids = reinterpret_cast<const std::int32_t*>(values);
+	    if(level() == Level::AVX2)
+		return between_avx2(ids, count, id, id, bits);
+	    return between_sse2(ids, count, id, id, bits);
+	}
+#endif
+	for(std::size_t word = 0; word * 64 < count; ++word) {
+	    std::size_t end = std::min<std::size_t>(64, count - word * 64);
+	    std::uint64_t mask = 0;
+	    for(std::size_t i = 0; i < end; ++i)
+		mask |= static_cast<std::uint64_t>(values[word * 64 + i] == key) << i;
+	    bits[word] = mask;
+	}
+    }
+};
+
+
+// A set of hashes that can answer "definitely never added" without touching
+// whatever the hashes came from; "maybe added" is wrong at about the rate
+// given by false_positive_rate(). Blocked: all the bits for one hash are in
+// the same 64-byte block, so a lookup costs one cache miss
+class BloomFilter {
+private:
+    static constexpr std::size_t block_words = 8;
+    std::vector<std::uint64_t> m_words;
+    std::size_t m_block_count = 0;
+    unsigned m_hash_count = 1;
+    std::size_t m_size = 0;
+    std::size_t m_capacity = 0;
+
+    static std::uint64_t mix(std::uint64_t hash)
+    {
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+	return hash;
+    }
+
+    // Calls visit(word, bit) for each bit of hash, stopping when it
+    // returns false
+    template<typename Visit>
+    bool each_bit(std::uint64_t hash, Visit visit) const
+    {
+	hash = mix(hash);
+	std::size_t block = static_cast<std::size_t>(((hash >> 32) * m_block_count) >> 32);
+	// Bit positions within the block come from the low 32 bits by double hashing
+	std::uint32_t position = static_cast<std::uint32_t>(hash);
+	std::uint32_t step = (position >> 16) | 1;
+	for(unsigned i = 0; i < m_hash_count; ++i, position += step) {
+	    std::size_t bit = position % (block_words * 64);
+	    if(!visit(block * block_words + bit / 64, std::uint64_t{1} << (bit % 64)))
+		return false;
+	}
+	return true;
+    }
+public:
+    // Empties the filter and sizes it for capacity hashes at about
+    // bits_per_hash bits each (10 gives roughly 1% false positives)
+    void reset(std::size_t capacity, unsigned bits_per_hash = 10)
+    {
+	m_block_count = std::max<std::size_t>(1, (capacity * bits_per_hash + block_words * 64 - 1)
+					      / (block_words * 64));
+	m_words.assign(m_block_count * block_words, 0);
+	m_hash_count = std::max(1u, static_cast<unsigned>(bits_per_hash * 0.693 + 0.5));
+	m_size = 0;
+	m_capacity = capacity;
+    }
+
+    void add(std::uint64_t hash)
+    {
+	each_bit(hash, [&](std::size_t word, std::uint64_t bit) {
+	    m_words[word] |= bit;
+	    return true;
+	});
+	++m_size;
+    }
+
+    bool may_contain(std::uint64_t hash) const
+    {
+	if(m_words.empty())
+	    return false;
+	return each_bit(hash, [&](std::size_t word, std::uint64_t bit) {
+	    return (m_words[word] & bit) != 0;
+	});
+    }
+
+    std::size_t size() const { return m_size; }
+
+    std::size_t capacity() const { return m_capacity; }
+
+    std::size_t bit_count() const { return m_words.size() * 64; }
+
+    // Expected chance that may_contain() is true for a hash never added,
+    // ignoring the uneven load of blocks
+    double false_positive_rate() const
+    {
+	if(m_words.empty())
+	    return 0;
+	double unset = std::exp(-static_cast<double>(m_hash_count) * static_cast<double>(m_size)
+				/ static_cast<double>(bit_count()));
+	return std::pow(1 - unset, m_hash_count);
+    }
+};
+
+
+// Sorted index from keys to fact rows: a B+ tree whose nodes each keep their
+// keys in one cache line. Keys may repeat; since rows only ever grow, equal
+// keys stay in row order. Nodes live in one vector, so copies are cheap to
+// make and need no fixing up
+template<typename T>
+class BTree {
+public:
+    static constexpr std::size_t fanout = std::max<std::size_t>(4, 64 / sizeof(T));
+private:
+    static constexpr std::uint32_t no_node = std::numeric_limits<std::uint32_t>::max();
+    struct Node {
+	// In inner nodes, keys[i] is the smallest key under child items[i]
+	T keys[fanout];
+	std::uint32_t items[fanout];
+	std::uint32_t count = 0;
+	// Leaves only: the leaf with the next keys
+	std::uint32_t next = no_node;
+	bool is_leaf = true;
+    };
+    std::vector<Node> m_nodes;
+    std::uint32_t m_root = no_node;
+    std::size_t m_size = 0;
+
+    // Inserts into the subtree at node; returns the new right sibling if
+    // node had to split
+    std::uint32_t insert(std::uint32_t node, const T &key, std::uint32_t row)
+    {
+	Node *current = &m_nodes[node];
+	// After every key not greater than key, so equal keys stay in row order
+	std::size_t position = std::upper_bound(current->keys, current->keys + current->count, key)
+	    - current->keys;
+	std::uint32_t item = row;
+	T item_key = key;
+	if(!current->is_leaf) {
+	    std::size_t child = position == 0 ? 0 : position - 1;
+	    if(position == 0)
+		current->keys[0] = key;
+	    std::uint32_t sibling = insert(current->items[child], key, row);
+	    current = &m_nodes[node];
+	    if(sibling == no_node)
+		return no_node;
+	    item = sibling;
+	    item_key = m_nodes[sibling].keys[0];
+	    position = child + 1;
+	}
+	if(current->count < fanout) {
+	    std::copy_backward(current->keys + position, current->keys + current->count,
+			       current->keys + current->count + 1);
+	    std::copy_backward(current->items + position, current->items + current->count,
+			       current->items + current->count + 1);
+	    current->keys[position] = item_key;
+	    current->items[position] = item;
+	    ++current->count;
+	    return no_node;
+	}
+	// Split: the upper half moves to a new sibling, then the item goes in
+	// whichever half it belongs to
+	auto sibling = static_cast<std::uint32_t>(m_nodes.size());
+	m_nodes.emplace_back();
+	current = &m_nodes[node];
+	Node &right = m_nodes.back();
+	right.is_leaf = current->is_leaf;
+	std::size_t half = fanout / 2;
+	right.count = static_cast<std::uint32_t>(fanout - half);
+	std::copy(current->keys + half, current->keys + fanout, right.keys);
+	std::copy(current->items + half, current->items + fanout, right.items);
+	current->count = static_cast<std::uint32_t>(half);
+	if(current->is_leaf) {
+	    right.next = current->next;
+	    current->next = sibling;
+	}
+	Node &target = position <= half ? *current : right;
+	std::size_t at = position <= half ? position : position - half;
+	std::copy_backward(target.keys + at, target.keys + target.count, target.keys + target.count + 1);
+	std::copy_backward(target.items + at, target.items + target.count, target.items + target.count + 1);
+	target.keys[at] = item_key;
+	target.items[at] = item;
+	++target.count;
+	return sibling;
+    }
+public:
+    std::size_t size() const { return m_size; }
+
+    void shrink_to_fit() { m_nodes.shrink_to_fit(); }
+
+    void insert(const T &key, std::size_t row)
+    {
+	auto item = static_cast<std::uint32_t>(row);
+	if(m_root == no_node) {
+	    m_nodes.emplace_back();
+	    m_root = 0;
+	}
+	std::uint32_t sibling = insert(m_root, key, item);
+	if(sibling != no_node) {
+	    auto root = static_cast<std::uint32_t>(m_nodes.size());
+	    m_nodes.emplace_back();
+	    Node &top = m_nodes.back();
+	    top.is_leaf = false;
+	    top.count = 2;
+	    top.keys[0] = m_nodes[m_root].keys[0];
+	    top.items[0] = m_root;
+	    top.keys[1] = m_nodes[sibling].keys[0];
+	    top.items[1] = sibling;
+	    m_root = root;
+	}
+	++m_size;
+    }
+
+    // Calls visit(key, row) on each entry with low <= key <= high, in key
+    // order, stopping early when visit returns true
+    template<typename Visitor>
+    bool scan(const T &low, const T &high, Visitor visit) const
+    {
+	if(m_root == no_node || high < low)
+	    return false;
+	std::uint32_t node = m_root;
+	while(!m_nodes[node].is_leaf) {
+	    // The last child whose smallest key is below low; equal keys may
+	    // start in it
+	    const Node &inner = m_nodes[node];
+	    std::size_t child = std::lower_bound(inner.keys, inner.keys + inner.count, low) - inner.keys;
+	    node = inner.items[child == 0 ? 0 : child - 1];
+	}
+	const Node *leaf = &m_nodes[node];
+	std::size_t position = std::lower_bound(leaf->keys, leaf->keys + leaf->count, low) - leaf->keys;
+	while(true) {
+	    for(; position < leaf->count; ++position) {
+		if(high < leaf->keys[position])
+		    return false;
+		if(visit(leaf->keys[position], leaf->items[position]))
+		    return true;
+	    }
+	    if(leaf->next == no_node)
+		return false;
+	    leaf = &m_nodes[leaf->next];
+	    position = 0;
+	}
+    }
+};
+
+
+// Ground facts of one predicate whose params are all int, long long, double
+// or Symbol values, stored as one array per param position instead of as
+// Rules. The param types are fixed by the first fact added. A BloomFilter
+// over whole facts turns away most lookups of absent ground facts
+class FactTable {
+public:
+    // Ground lookups are counted one in sample_rate per thread, so that
+    // concurrent queries don't all write the counters' cache line
+    static constexpr std::uint32_t sample_rate = 16;
+
+    // How well the filter has done on the ground lookups sampled so far
+    struct FilterStats {
+	std::size_t fact_count = 0;
+	std::size_t bit_count = 0;
+	// The filter's expected false positive rate at its current load
+	double expected_rate = 0;
+	std::size_t lookups = 0;
+	// Lookups that asked the filter
+	std::size_t consulted = 0;
+	// Lookups the filter answered alone
+	std::size_t rejected = 0;
+	// Lookups the filter let through that matched no fact
+	std::size_t false_positives = 0;
+
+	double observed_rate() const
+	{
+	    std::size_t absent = rejected + false_positives;
+	    return absent == 0 ? 0 : static_cast<double>(false_positives) / static_cast<double>(absent);
+	}
+    };
+private:
+    using Column = std::variant<std::vector<int>, std::vector<long long>,
+				std::vector<double>, std::vector<Symbol>>;
+    static constexpr std::uint32_t no_row = std::numeric_limits<std::uint32_t>::max();
+    // Roughly how many rows a ScanKernels filter checks in the time find()
+    // takes to check one index entry
+    static constexpr std::size_t kernel_speedup = 8;
+    // How many rows find() samples to guess how many a filter will pass
+    static constexpr std::size_t kernel_samples = 32;
+    // find() keeps the columns it checks in a 64-bit mask
+    static constexpr std::size_t max_columns = 64;
+    std::vector<Column> m_columns;
+    std::size_t m_size = 0;
+    // Hash index on the first param: m_heads[slot] is the last row added to
+    // that slot and m_next links each row to the one added to it before
+    std::vector<std::uint32_t> m_heads;
+    std::vector<std::uint32_t> m_next;
+    unsigned m_shift = 64;
+    // Open-addressed set of whole facts for ground lookups. An entry holds
+    // a row + 1 (0 = empty) in its low half and a tag from the fact's hash
+    // in the high half, so most mismatches are skipped without reading the
+    // columns. Of equal facts only the first row is kept
+    std::vector<std::uint64_t> m_members;
+    // Sorted indexes, for the columns asked for with index_column()
+    using Tree = std::variant<std::monostate, BTree<int>, BTree<long long>, BTree<double>, BTree<Symbol>>;
+    std::vector<Tree> m_trees;
+    std::vector<std::size_t> m_sorted_columns;
+    BloomFilter m_filter;
+    // Updated by sampled const lookups, possibly from several threads
+    struct Counters {
+	std::atomic<std::size_t> lookups{0}, consulted{0}, rejected{0}, false_positives{0};
+
+	Counters() = default;
+
+	Counters(const Counters &other)
+	    : lookups(other.lookups.load()), consulted(other.consulted.load()),
+	      rejected(other.rejected.load()), false_positives(other.false_positives.load())
+	{}
+
+	Counters& operator=(const Counters &other)
+	{
+	    lookups = other.lookups.load();
+	    consulted = other.consulted.load();
+	    rejected = other.rejected.load();
+	    false_positives = other.false_positives.load();
+	    return *this;
+	}
+    };
+    mutable Counters m_counters;
+
+    // Position of param's type in Column, or -1 if it isn't one
+    static int type_of(const IVariable &param)
+    {
+	const auto &type = typeid(param);
+	if(type == typeid(Variable<int>))
+	    return 0;
+	if(type == typeid(Variable<long long>))
+	    return 1;
+	if(type == typeid(Variable<double>))
+	    return 2;
+	if(type == typeid(Variable<Symbol>))
+	    return 3;
+	return -1;
+    }
+
+    template<typename T>
+    static const T& value_of(const IVariable &param)
+    {
+	return static_cast<const Variable<T>&>(param).value();
+    }
+
+    // Same as Variable<T>{value}.hash()
+    template<typename T>
+    static std::size_t hash_value(const T &value)
+    {
+	static const std::size_t type_hash = typeid(T).hash_code();
+	return type_hash * 31 + std::hash<T>{}(value);
+    }
+
+    std::size_t slot(std::size_t hash) const
+    {
+	return static_cast<std::size_t>((static_cast<std::uint64_t>(hash) * 0x9e3779b97f4a7c15ull)
+					>> m_shift);
+    }
+
+    std::size_t first_hash(std::size_t row) const
+    {
+	return std::visit([&](const auto &column) { return hash_value(column[row]); }, m_columns[0]);
+    }
+
+    void rehash()
+    {
+	m_shift = 64 - 4;
+	while((std::size_t{1} << (64 - m_shift)) < m_size)
+	    --m_shift;
+	m_heads.assign(std::size_t{1} << (64 - m_shift), no_row);
+	for(std::size_t row = 0; row < m_size; ++row) {
+	    auto &head = m_heads[slot(first_hash(row))];
+	    m_next[row] = head;
+	    head = static_cast<std::uint32_t>(row);
+	}
+    }
+
+    // Whether the value in column at row can unify with param, which is known
+    // to be of a matching type or a LogicVariable
+    bool matches(const IVariable &param, std::size_t column, std::size_t row) const
+    {
+	return std::visit([&](const auto &values) {
+	    using T = typename std::decay_t<decltype(values)>::value_type;
+	    if(param.is_unified())
+		return value_of<T>(param) == values[row];
+	    return !param.is_constrained() || param.can_unify(Variable<T>{values[row]});
+	}, m_columns[column]);
+    }
+
+    static std::uint64_t tag(std::size_t hash)
+    {
+	auto wide = static_cast<std::uint64_t>(hash);
+	return ((wide ^ (wide >> 32)) & 0xffffffffull) << 32;
+    }
+
+    std::size_t member_slot(std::size_t hash) const
+    {
+	return static_cast<std::size_t>(static_cast<std::uint64_t>(hash) * 0x9e3779b97f4a7c15ull
+					>> 32) & (m_members.size() - 1);
+    }
+
+    bool same_fact(std::size_t a, std::size_t b) const
+    {
+	for(const auto &column : m_columns) {
+	    bool equal = std::visit([&](const auto &values) { return values[a] == values[b]; }, column);
+	    if(!equal)
+		return false;
+	}
+	return true;
+    }
+
+    void insert_member(std::size_t row, std::size_t hash)
+    {
+	std::uint64_t entry = tag(hash) | (row + 1);
+	for(std::size_t i = member_slot(hash);; i = (i + 1) & (m_members.size() - 1)) {
+	    std::uint64_t other = m_members[i];
+	    if(other == 0) {
+		m_members[i] = entry;
+		return;
+	    }
+	    if((other >> 32) == (entry >> 32) && same_fact((other & 0xffffffffull) - 1, row))
+		return;
+	}
+    }
+
+    // The first row holding exactly conjecture's values, which are all
+    // bound and of the columns' types, or size()
+    template<typename Term>
+    std::size_t find_member(const Term &conjecture, std::size_t hash) const
+    {
+	std::uint64_t wanted = tag(hash) >> 32;
+	for(std::size_t i = member_slot(hash);; i = (i + 1) & (m_members.size() - 1)) {
+	    std::uint64_t entry = m_members[i];
+	    if(entry == 0)
+		return m_size;
+	    if((entry >> 32) != wanted)
+		continue;
+	    std::size_t row = (entry & 0xffffffffull) - 1;
+	    bool equal = true;
+	    for(std::size_t column = 0; column < m_columns.size() && equal; ++column)
+		equal = matches(*conjecture[column], column, row);
+	    if(equal)
+		return row;
+	}
+    }
+
+    template<typename T>
+    static T lowest()
+    {
+	if constexpr(std::is_same_v<T, Symbol>)
+	    return Symbol{0};
+	else if constexpr(std::numeric_limits<T>::has_infinity)
+	    return -std::numeric_limits<T>::infinity();
+	else
+	    return std::numeric_limits<T>::lowest();
+    }
+
+    template<typename T>
+    static T highest()
+    {
+	if constexpr(std::is_same_v<T, Symbol>)
+	    return Symbol{std::numeric_limits<std::uint32_t>::max()};
+	else if constexpr(std::numeric_limits<T>::has_infinity)
+	    return std::numeric_limits<T>::infinity();
+	else
+	    return std::numeric_limits<T>::max();
+    }
+
+    // The value next to value, up or down; value must not be the last one
+    // that way
+    template<typename T>
+    static T next(const T &value, bool up)
+    {
+	if constexpr(std::is_same_v<T, Symbol>)
+	    return Symbol{up ? value.id + 1 : value.id - 1};
+	else if constexpr(std::is_floating_point_v<T>)
+	    return std::nextafter(value, up ? highest<T>() : lowest<T>());
+	else
+	    return up ? value + 1 : value - 1;
+    }
+
+    // Sets [low, high] to the values that param (a Variable<T>) limits a
+    // column to by holding a value or by comparison constraints; false if it
+    // does neither. An empty range has high < low
+    template<typename T>
+    static bool range_of(const IVariable &param, T &low, T &high)
+    {
+	const auto &variable = static_cast<const Variable<T>&>(param);
+	if(variable.is_unified()) {
+	    low = high = variable.value();
+	    return true;
+	}
+	if(!variable.lower() && !variable.upper())
+	    return false;
+	low = lowest<T>();
+	high = highest<T>();
+	bool is_empty = false;
+	if(const auto &bound = variable.lower()) {
+	    if(bound->inclusive)
+		low = bound->value;
+	    else if(bound->value == highest<T>())
+		is_empty = true;
+	    else
+		low = next(bound->value, true);
+	}
+	if(const auto &bound = variable.upper()) {
+	    if(bound->inclusive)
+		high = bound->value;
+	    else if(bound->value == lowest<T>())
+		is_empty = true;
+	    else
+		high = next(bound->value, false);
+	}
+	if(is_empty) {
+	    low = highest<T>();
+	    high = lowest<T>();
+	}
+	return true;
+    }
+
+    // next_match() without the filter. Candidate rows come from whichever is
+    // expected to yield the fewest: the hash index, for a bound first param;
+    // a sorted index on a param that is bound or has comparison constraints;
+    // a ScanKernels filter on such a param's column; every row
+    template<typename Term>
+    std::size_t find(const Term &conjecture, std::size_t from) const
+    {
+	if(conjecture.arity() != m_columns.size() || from >= m_size)
+	    return m_size;
+	enum class Access { Rows, Hash, Tree, Kernel };
+	// Params that every row unifies with are skipped
+	std::uint64_t checked = 0;
+	std::size_t driver = m_columns.size();
+	Access access = Access::Rows;
+	// Rows the driver would have find() look at. Index entries are only
+	// counted up to the best cost so far, so costing a driver never takes
+	// longer than using the best one would
+	std::size_t best_cost = m_size - from;
+	auto consider = [&](std::size_t column, Access kind, std::size_t cost) {
+	    if(cost < best_cost) {
+		driver = column;
+		access = kind;
+		best_cost = cost;
+	    }
+	};
+	for(std::size_t i = 0; i < conjecture.arity(); ++i) {
+	    const IVariable &param = *conjecture[i];
+	    if(typeid(param) == typeid(LogicVariable))
+		continue;
+	    if(type_of(param) != static_cast<int>(m_columns[i].index()))
+		return m_size;
+	    if(!param.is_unified() && !param.is_constrained())
+		continue;
+	    checked |= std::uint64_t{1} << i;
+	    bool is_bound = param.is_unified();
+	    bool is_sorted = !m_trees.empty() && m_trees[i].index() != 0;
+	    std::visit([&](const auto &values) {
+		using T = typename std::decay_t<decltype(values)>::value_type;
+		T low{}, high{};
+		if(!range_of<T>(param, low, high))
+		    return;
+		if(is_bound && i == 0) {
+		    std::size_t count = 0;
+		    for(std::uint32_t row = m_heads[slot(param.hash())];
+			row != no_row && count < best_cost; row = m_next[row])
+			++count;
+		    consider(i, Access::Hash, count);
+		}
+		if(is_sorted) {
+		    std::size_t count = 0;
+		    if(best_cost > 0) {
+			std::get<BTree<T>>(m_trees[i]).scan(low, high, [&](const T&, std::size_t) {
+			    return ++count >= best_cost;
+			});
+		    }
+		    consider(i, Access::Tree, count);
+		}
+		// There is no range kernel for Symbols
+		std::size_t rows = m_size - from;
+		if((!is_bound && std::is_same_v<T, Symbol>) || 1 + rows / kernel_speedup >= best_cost)
+		    return;
+		// Its matches are estimated from evenly spaced rows
+		std::size_t step = std::max<std::size_t>(1, rows / kernel_samples);
+		std::size_t sampled = 0, hits = 0;
+		for(std::size_t row = from; row < m_size; row += step, ++sampled)
+		    hits += !(values[row] < low) && !(high < values[row]);
+		consider(i, Access::Kernel, 1 + rows / kernel_speedup + rows * hits / sampled);
+	    }, m_columns[i]);
+	}
+	// The driver's range is exact, so only its Predicates are left to check
+	if(driver < m_columns.size()) {
+	    std::size_t predicate_count = std::visit([&](const auto &values) {
+		using T = typename std::decay_t<decltype(values)>::value_type;
+		return static_cast<const Variable<T>&>(*conjecture[driver]).constraint_count();
+	    }, m_columns[driver]);
+	    if(predicate_count == 0)
+		checked &= ~(std::uint64_t{1} << driver);
+	}
+	auto rest_match = [&](std::size_t row) {
+	    for(std::uint64_t mask = checked; mask != 0; mask &= mask - 1) {
+		std::size_t i = ScanKernels::lowest_bit(mask);
+		if(!matches(*conjecture[i], i, row))
+		    return false;
+	    }
+	    return true;
+	};
+
+	if(access == Access::Hash) {
+	    std::size_t best = m_size;
+	    for(std::uint32_t row = m_heads[slot(conjecture[0]->hash())]; row != no_row; row = m_next[row]) {
+		if(row >= from && row < best && matches(*conjecture[0], 0, row) && rest_match(row))
+		    best = row;
+	    }
+	    return best;
+	}
+	if(driver == m_columns.size()) {
+	    for(std::size_t row = from; row < m_size; ++row) {
+		if(rest_match(row))
+		    return row;
+	    }
+	    return m_size;
+	}
+	return std::visit([&](const auto &values) {
+	    using T = typename std::decay_t<decltype(values)>::value_type;
+	    T low{}, high{};
+	    range_of<T>(*conjecture[driver], low, high);
+	    if(access == Access::Tree) {
+		// Equal keys are in row order, but a range's rows aren't
+		std::size_t best = m_size;
+		bool is_bound = conjecture[driver]->is_unified();
+		std::get<BTree<T>>(m_trees[driver]).scan(low, high, [&](const T&, std::size_t row) {
+		    if(row >= from && row < best && rest_match(row)) {
+			best = row;
+			return is_bound;
+		    }
+		    return false;
+		});
+		return best;
+	    }
+	    // Filter a block of rows at a time, then check the rest of each match
+	    constexpr std::size_t block_size = 4096;
+	    std::uint64_t bits[block_size / 64];
+	    for(std::size_t start = from; start < m_size; start += block_size) {
+		std::size_t count = std::min(block_size, m_size - start);
+		if constexpr(std::is_same_v<T, Symbol>)
+		    ScanKernels::equal(values.data() + start, count, low, bits);
+		else
+		    ScanKernels::between(values.data() + start, count, low, high, bits);
+		for(std::size_t word = 0; word * 64 < count; ++word) {
+		    for(std::uint64_t mask = bits[word]; mask != 0; mask &= mask - 1) {
+			std::size_t row = start + word * 64 + ScanKernels::lowest_bit(mask);
+			if(rest_match(row))
+			    return row;
+		    }
+		}
+	    }
+	    return m_size;
+	}, m_columns[driver]);
+    }
+
+    void build_tree(std::size_t column)
+    {
+	std::visit([&](const auto &values) {
+	    using T = typename std::decay_t<decltype(values)>::value_type;
+	    auto &tree = m_trees[column].template emplace<BTree<T>>();
+	    for(std::size_t row = 0; row < m_size; ++row)
+		tree.insert(values[row], row);
+	}, m_columns[column]);
+    }
+public:
+    std::size_t size() const { return m_size; }
+
+    std::size_t arity() const { return m_columns.size(); }
+
+    // Whether fact is ground and its params fit the columns
+    bool accepts(const RuleVariable &fact) const
+    {
+	if(fact.arity() == 0 || fact.arity() > max_columns || m_size == no_row - 1
+	   || (m_size > 0 && fact.arity() != m_columns.size()))
+	    return false;
+	for(std::size_t i = 0; i < fact.arity(); ++i) {
+	    int type = type_of(*fact[i]);
+	    if(type < 0 || !fact[i]->is_unified()
+	       || (m_size > 0 && type != static_cast<int>(m_columns[i].index())))
+		return false;
+	}
+	return true;
+    }
+
+    // fact must be accepted
+    void add(const RuleVariable &fact)
+    {
+	if(m_size == 0) {
+	    m_columns.clear();
+	    m_trees.clear();
+	    for(std::size_t i = 0; i < fact.arity(); ++i) {
+		switch(type_of(*fact[i])) {
+		case 0: m_columns.emplace_back(std::in_place_index<0>); break;
+		case 1: m_columns.emplace_back(std::in_place_index<1>); break;
+		case 2: m_columns.emplace_back(std::in_place_index<2>); break;
+		default: m_columns.emplace_back(std::in_place_index<3>); break;
+		}
+	    }
+	}
+	if(m_size == 0 && !m_sorted_columns.empty()) {
+	    m_trees.resize(m_columns.size());
+	    for(std::size_t column : m_sorted_columns) {
+		if(column < m_columns.size())
+		    build_tree(column);
+	    }
+	}
+	for(std::size_t i = 0; i < fact.arity(); ++i) {
+	    std::visit([&](auto &column) {
+		using T = typename std::decay_t<decltype(column)>::value_type;
+		column.push_back(value_of<T>(*fact[i]));
+		if(!m_trees.empty() && m_trees[i].index() != 0)
+		    std::get<BTree<T>>(m_trees[i]).insert(column.back(), m_size);
+	    }, m_columns[i]);
+	}
+	m_next.push_back(no_row);
+	if(m_size + 1 > m_filter.capacity()) {
+	    // Grow the filter with the facts so its false positive rate holds
+	    m_filter.reset(std::max<std::size_t>(64, 2 * (m_size + 1)));
+	    for(std::size_t row = 0; row < m_size; ++row)
+		m_filter.add(hash(row));
+	}
+	std::size_t fact_hash = hash(m_size);
+	m_filter.add(fact_hash);
+	// Keep the set at most 3/4 full
+	if(4 * (m_size + 1) > 3 * m_members.size()) {
+	    m_members.assign(std::max<std::size_t>(16, 2 * m_members.size()), 0);
+	    for(std::size_t row = 0; row < m_size; ++row)
+		insert_member(row, hash(row));
+	}
+	insert_member(m_size, fact_hash);
+	if(++m_size > m_heads.size()) {
+	    rehash();
+	} else {
+	    auto &head = m_heads[slot(first_hash(m_size - 1))];
+	    m_next[m_size - 1] = head;
+	    head = static_cast<std::uint32_t>(m_size - 1);
+	}
+    }
+
+    // Frees spare capacity; the table can still grow afterwards
+    void shrink_to_fit()
+    {
+	for(auto &column : m_columns)
+	    std::visit([](auto &values) { values.shrink_to_fit(); }, column);
+	m_next.shrink_to_fit();
+	for(auto &tree : m_trees) {
+	    std::visit([](auto &sorted) {
+		if constexpr(!std::is_same_v<std::decay_t<decltype(sorted)>, std::monostate>)
+		    sorted.shrink_to_fit();
+	    }, tree);
+	}
+    }
+
+    // Keeps a sorted index (a BTree) on column from now on, for lookups and
+    // comparison constraints on it. False if the facts have fewer columns
+    bool index_column(std::size_t column)
+    {
+	if(m_size > 0 && column >= m_columns.size())
+	    return false;
+	if(std::find(m_sorted_columns.begin(), m_sorted_columns.end(), column) != m_sorted_columns.end())
+	    return true;
+	m_sorted_columns.push_back(column);
+	if(m_size > 0) {
+	    m_trees.resize(m_columns.size());
+	    build_tree(column);
+	}
+	return true;
+    }
+
+    // Same as Database::Batch's hash of a Rule with these params
+    std::size_t hash(std::size_t row) const
+    {
+	std::size_t result = m_columns.size();
+	for(const auto &column : m_columns)
+	    result = result * 31 + std::visit([&](const auto &values) { return hash_value(values[row]); }, column);
+	return result;
+    }
+
+    // Whether the params of fact are structurally equal to the ones at row
+    bool equals(std::size_t row, const RuleVariable &fact) const
+    {
+	if(fact.arity() != m_columns.size())
+	    return false;
+	for(std::size_t i = 0; i < fact.arity(); ++i) {
+	    if(type_of(*fact[i]) != static_cast<int>(m_columns[i].index()) || !fact[i]->is_unified()
+	       || !matches(*fact[i], i, row))
+		return false;
+	}
+	return true;
+    }
+
+    // The first row at or after from that can unify with conjecture, or
+    // size() if there is none. Ground lookups ask the filter (unless it has
+    // rarely helped, see below) and then look the fact up in the set.
+    // conjecture is a RuleVariable, or anything else with its arity() and
+    // operator[]
+    template<typename Term>
+    std::size_t next_match(const Term &conjecture, std::size_t from = 0) const
+    {
+	bool is_ground = from == 0 && m_size > 0 && conjecture.arity() == m_columns.size();
+	for(std::size_t i = 0; i < conjecture.arity() && is_ground; ++i) {
+	    is_ground = conjecture[i]->is_unified()
+		&& type_of(*conjecture[i]) == static_cast<int>(m_columns[i].index());
+	}
+	if(!is_ground)
+	    return find(conjecture, from);
+	// Same as hash(row) for a row holding these values
+	std::size_t tuple_hash = conjecture.arity();
+	for(std::size_t i = 0; i < conjecture.arity(); ++i)
+	    tuple_hash = tuple_hash * 31 + conjecture[i]->hash();
+	// Only sampled lookups write the counters. When almost every lookup
+	// finds its fact, the filter only costs a cache miss; it is then
+	// asked on sampled lookups alone, which keeps the statistics
+	// current in case that changes
+	static thread_local std::uint32_t lookup_count = 0;
+	bool is_sampled = ++lookup_count % sample_rate == 0;
+	if(!is_sampled) {
+	    std::size_t consulted = m_counters.consulted.load(std::memory_order_relaxed);
+	    bool rarely_helps = consulted >= 8
+		&& m_counters.rejected.load(std::memory_order_relaxed) * 8 < consulted;
+	    if(rarely_helps)
+		return find_member(conjecture, tuple_hash);
+	    if(!m_filter.may_contain(tuple_hash))
+		return m_size;
+	    return find_member(conjecture, tuple_hash);
+	}
+	m_counters.lookups.fetch_add(1, std::memory_order_relaxed);
+	m_counters.consulted.fetch_add(1, std::memory_order_relaxed);
+	if(!m_filter.may_contain(tuple_hash)) {
+	    m_counters.rejected.fetch_add(1, std::memory_order_relaxed);
+	    return m_size;
+	}
+	std::size_t found = find_member(conjecture, tuple_hash);
+	if(found == m_size)
+	    m_counters.false_positives.fetch_add(1, std::memory_order_relaxed);
+	return found;
+    }
+
+    FilterStats filter_stats() const
+    {
+	FilterStats stats;
+	stats.fact_count = m_size;
+	stats.bit_count = m_filter.bit_count();
+	stats.expected_rate = m_filter.false_positive_rate();
+	stats.lookups = m_counters.lookups.load();
+	stats.consulted = m_counters.consulted.load();
+	stats.rejected = m_counters.rejected.load();
+	stats.false_positives = m_counters.false_positives.load();
+	return stats;
+    }
+
+    // Calls visit(value) on the value in column at row, as its own type
+    template<typename Visitor>
+    decltype(auto) visit_value(std::size_t row, std::size_t column, Visitor visit) const
+    {
+	return std::visit([&](const auto &values) -> decltype(auto) { return visit(values[row]); },
+			  m_columns[column]);
+    }
+
+    // The fact at row as a Rule named name
+    template<typename Name>
+    Rule to_rule(const Name &name, std::size_t row) const
+    {
+	Rule result{name};
+	for(const auto &column : m_columns)
+	    std::visit([&](const auto &values) { result.add_param(values[row]); }, column);
+	return result;
+    }
+};
+
+
+// Discrimination tree over the heads of a predicate's Rules: each level of
+// the tree is one param, reached by its bound value, by its type if it is an
+// unbound Variable<T>, or by a wildcard edge if it is a LogicVariable. One
+// walk finds every head that can unify with a conjecture, whichever of its
+// params are bound. Hashes collide, so some of the heads found may not
+// unify after all
+class HeadIndex {
+private:
+    static constexpr std::uint32_t no_node = std::numeric_limits<std::uint32_t>::max();
+    // The type of a value edge shared by values of different types
+    static constexpr std::size_t mixed_types = 0;
+    struct Edge {
+	std::size_t type;
+	// Position of the first head below the edge
+	std::size_t first;
+	std::uint32_t child;
+    };
+    struct Node {
+	// Edges for bound params, in the order they were made (and so by
+	// first), and where to find each by the hash of its value
+	std::vector<Edge> values;
+	std::unordered_map<std::size_t, std::uint32_t> value_edges;
+	// Edges for unbound Variable<T>s, by type
+	std::vector<Edge> types;
+	std::uint32_t any = no_node;
+	std::size_t first = 0;
+	// Positions of the heads that end here, in insertion order
+	std::vector<std::size_t> positions;
+    };
+    // A subtree still to walk, or (if is_scan) the value edges of node from
+    // cursor on; leaves keep their next position in cursor
+    struct Pending {
+	std::size_t first;
+	std::uint32_t node;
+	std::uint32_t depth;
+	std::uint32_t cursor;
+	bool is_scan;
+
+	bool operator<(const Pending &other) const { return first > other.first; }
+    };
+    std::vector<Node> m_nodes;
+    // Root of the tree for each arity
+    std::vector<std::pair<std::size_t, std::uint32_t>> m_roots;
+
+    std::uint32_t make_node(std::size_t first)
+    {
+	m_nodes.emplace_back();
+	m_nodes.back().first = first;
+	return static_cast<std::uint32_t>(m_nodes.size() - 1);
+    }
+
+    // The child of node that param leads to, made if missing
+    std::uint32_t child(std::uint32_t node, const IVariable &param, std::size_t position)
+    {
+	if(typeid(param) == typeid(LogicVariable)) {
+	    if(m_nodes[node].any == no_node) {
+		std::uint32_t made = make_node(position);
+		m_nodes[node].any = made;
+	    }
+	    return m_nodes[node].any;
+	}
+	if(param.is_unified()) {
+	    auto match = m_nodes[node].value_edges.find(param.hash());
+	    if(match != m_nodes[node].value_edges.end()) {
+		Edge &edge = m_nodes[node].values[match->second];
+		if(edge.type != param.type_hash())
+		    edge.type = mixed_types;
+		return edge.child;
+	    }
+	    std::uint32_t made = make_node(position);
+	    Node &current = m_nodes[node];
+	    current.value_edges.emplace(param.hash(), static_cast<std::uint32_t>(current.values.size()));
+	    current.values.push_back({param.type_hash(), position, made});
+	    return made;
+	}
+	for(const auto &edge : m_nodes[node].types) {
+	    if(edge.type == param.type_hash())
+		return edge.child;
+	}
+	std::uint32_t made = make_node(position);
+	m_nodes[node].types.push_back({param.type_hash(), position, made});
+	return made;
+    }
+
+    // The next value edge of node from cursor on that an unbound param
+    // might unify with, or values.size()
+    static std::uint32_t next_value(const Node &node, std::uint32_t cursor, const IVariable &param)
+    {
+	bool is_any = typeid(param) == typeid(LogicVariable);
+	for(; cursor < node.values.size(); ++cursor) {
+	    std::size_t type = node.values[cursor].type;
+	    if(is_any || type == mixed_types || type == param.type_hash())
+		break;
+	}
+	return cursor;
+    }
+public:
+    // Heads must be added in increasing order of position
+    void add(const RuleVariable &head, std::size_t position)
+    {
+	auto root = std::find_if(m_roots.begin(), m_roots.end(),
+				 [&](const auto &entry) { return entry.first == head.arity(); });
+	std::uint32_t node;
+	if(root != m_roots.end()) {
+	    node = root->second;
+	} else {
+	    node = make_node(position);
+	    m_roots.emplace_back(head.arity(), node);
+	}
+	for(std::size_t i = 0; i < head.arity(); ++i)
+	    node = child(node, *head[i], position);
+	m_nodes[node].positions.push_back(position);
+    }
+
+    // Calls visit(position) in increasing order on the positions of the
+    // heads that might unify with conjecture, stopping early when visit
+    // returns true. Follows IVariable::can_unify: a bound param reaches
+    // equal values, its own type and wildcards; an unbound param only
+    // reaches values (of its type, unless it is a LogicVariable). With
+    // can_alias, as in resolution, an unbound param also reaches the
+    // unbound params it could be aliased with. Subtrees are walked in order
+    // of their first head, so a visit that stops early only walks the part
+    // of the tree in front of it
+    template<typename Term, typename Visitor>
+    bool visit(const Term &conjecture, Visitor visit, bool can_alias = false) const
+    {
+	auto root = std::find_if(m_roots.begin(), m_roots.end(),
+				 [&](const auto &entry) { return entry.first == conjecture.arity(); });
+	if(root == m_roots.end())
+	    return false;
+	std::vector<Pending> pending;
+	auto push = [&](const Pending &next) {
+	    pending.push_back(next);
+	    std::push_heap(pending.begin(), pending.end());
+	};
+	push({m_nodes[root->second].first, root->second, 0, 0, false});
+	while(!pending.empty()) {
+	    std::pop_heap(pending.begin(), pending.end());
+	    Pending current = pending.back();
+	    pending.pop_back();
+	    const Node &node = m_nodes[current.node];
+	    if(current.depth == conjecture.arity()) {
+		if(visit(node.positions[current.cursor]))
+		    return true;
+		if(current.cursor + 1 < node.positions.size())
+		    push({node.positions[current.cursor + 1], current.node, current.depth,
+			  current.cursor + 1, false});
+		continue;
+	    }
+	    const IVariable &param = *conjecture[current.depth];
+	    std::uint32_t depth = current.depth + 1;
+	    if(current.is_scan) {
+		const Edge &edge = node.values[current.cursor];
+		push({edge.first, edge.child, depth, 0, false});
+		std::uint32_t next = next_value(node, current.cursor + 1, param);
+		if(next < node.values.size())
+		    push({node.values[next].first, current.node, current.depth, next, true});
+	    } else if(param.is_unified()) {
+		auto match = node.value_edges.find(param.hash());
+		if(match != node.value_edges.end()) {
+		    const Edge &edge = node.values[match->second];
+		    push({edge.first, edge.child, depth, 0, false});
+		}
+		for(const auto &edge : node.types) {
+		    if(edge.type == param.type_hash())
+			push({edge.first, edge.child, depth, 0, false});
+		}
+		if(node.any != no_node)
+		    push({m_nodes[node.any].first, node.any, depth, 0, false});
+	    } else {
+		std::uint32_t next = next_value(node, 0, param);
+		if(next < node.values.size())
+		    push({node.values[next].first, current.node, current.depth, next, true});
+		if(!can_alias)
+		    continue;
+		bool is_any = typeid(param) == typeid(LogicVariable);
+		for(const auto &edge : node.types) {
+		    if(is_any || edge.type == param.type_hash())
+			push({edge.first, edge.child, depth, 0, false});
+		}
+		if(node.any != no_node)
+		    push({m_nodes[node.any].first, node.any, depth, 0, false});
+	    }
+	}
+	return false;
+    }
+
+    std::size_t node_count() const { return m_nodes.size(); }
+
+    void shrink_to_fit()
+    {
+	m_nodes.shrink_to_fit();
+	for(auto &node : m_nodes) {
+	    node.values.shrink_to_fit();
+	    node.value_edges.rehash(0);
+	    node.types.shrink_to_fit();
+	    node.positions.shrink_to_fit();
+	}
+    }
+};
+
+
+template<typename Rel, typename ...Args>
+struct RelationGoal;
+
+// A predicate whose params have the types Ts..., fixed at compile time.
+// Facts are tuples kept in one vector, indexed by the hash of their first
+// value. A query gives each param a value of exactly its type, or a Type<>
+// of it to leave the param open; anything else doesn't compile, and
+// matching a fact takes no virtual calls or type tests
+template<typename ...Ts>
+class Relation {
+    static_assert(sizeof...(Ts) > 0, "a Relation needs at least one param");
+public:
+    using Tuple = std::tuple<Ts...>;
+private:
+    using First = std::tuple_element_t<0, Tuple>;
+    static constexpr std::uint32_t no_row = std::numeric_limits<std::uint32_t>::max();
+    std::vector<Tuple> m_rows;
+    // Same chained hash as FactTable's on the first param
+    std::vector<std::uint32_t> m_heads;
+    std::vector<std::uint32_t> m_next;
+    unsigned m_shift = 64;
+
+    std::size_t slot(const First &value) const
+    {
+	auto hash = static_cast<std::uint64_t>(std::hash<First>{}(value));
+	return static_cast<std::size_t>((hash * 0x9e3779b97f4a7c15ull) >> m_shift);
+    }
+
+    void rehash()
+    {
+	m_shift = 64 - 4;
+	while((std::size_t{1} << (64 - m_shift)) < m_rows.size())
+	    --m_shift;
+	m_heads.assign(std::size_t{1} << (64 - m_shift), no_row);
+	for(std::size_t row = 0; row < m_rows.size(); ++row) {
+	    auto &head = m_heads[slot(std::get<0>(m_rows[row]))];
+	    m_next[row] = head;
+	    head = static_cast<std::uint32_t>(row);
+	}
+    }
+
+    template<typename T, typename Arg>
+    static bool matches(const T &value, const Arg &arg)
+    {
+	if constexpr(std::is_same_v<Arg, Type<T>>) {
+	    return true;
+	} else {
+	    static_assert(std::is_same_v<Arg, T>,
+			  "each argument must have its param's type, or be a Type<> of it");
+	    return value == arg;
+	}
+    }
+
+    template<std::size_t ...I, typename ...Args>
+    static bool matches(const Tuple &row, std::index_sequence<I...>, const Args &...args)
+    {
+	return (matches(std::get<I>(row), args) && ...);
+    }
+public:
+    std::size_t size() const { return m_rows.size(); }
+
+    const Tuple& operator[](std::size_t row) const { return m_rows[row]; }
+
+    void add(Ts... values)
+    {
+	m_rows.emplace_back(std::move(values)...);
+	if constexpr(is_hashable<First>::value) {
+	    m_next.push_back(no_row);
+	    if(m_rows.size() > m_heads.size()) {
+		rehash();
+	    } else {
+		auto &head = m_heads[slot(std::get<0>(m_rows.back()))];
+		m_next.back() = head;
+		head = static_cast<std::uint32_t>(m_rows.size() - 1);
+	    }
+	}
+    }
+
+    // Calls visit(fact) on the facts matching args, in no particular order,
+    // stopping early when visit returns true
+    template<typename Visitor, typename ...Args>
+    bool for_each_match(Visitor visit, const Args &...args) const
+    {
+	static_assert(sizeof...(Args) == sizeof...(Ts), "one argument per param");
+	const auto &first = std::get<0>(std::forward_as_tuple(args...));
+	if constexpr(is_hashable<First>::value
+		     && !std::is_same_v<std::decay_t<decltype(first)>, Type<First>>) {
+	    if(m_rows.empty())
+		return false;
+	    for(auto row = m_heads[slot(first)]; row != no_row; row = m_next[row]) {
+		if(matches(m_rows[row], std::index_sequence_for<Ts...>{}, args...)
+		   && visit(m_rows[row]))
+		    return true;
+	    }
+	} else {
+	    for(const auto &row : m_rows) {
+		if(matches(row, std::index_sequence_for<Ts...>{}, args...) && visit(row))
+		    return true;
+	    }
+	}
+	return false;
+    }
+
+    template<typename ...Args>
+    bool query(const Args &...args) const
+    {
+	return for_each_match([](const Tuple&) { return true; }, args...);
+    }
+
+    template<typename ...Args>
+    std::size_t count(const Args &...args) const
+    {
+	std::size_t result = 0;
+	for_each_match([&](const Tuple&) { ++result; return false; }, args...);
+	return result;
+    }
+    // A goal on this relation, for a compiled rule (see Placeholder)
+    template<typename ...Args>
+    RelationGoal<Relation, Args...> operator()(const Args &...args) const
+    {
+	static_assert(sizeof...(Args) == sizeof...(Ts), "one argument per param");
+	return {this, {args...}};
+    }
+};
+
+
+// The bindings of one query's variables, kept apart from the Rules they
+// come from. Variables are numbered slots: unify() aliases two of them, even
+// while both are unbound, and bind() gives one a value. Aliased slots form
+// a union-find tree whose root holds the value, so binding any slot binds
+// them all, and find() points the slots it passes straight at their root.
+// The root is the class's oldest slot, as in the WAM, so slots only point
+// at older ones and the newest can be dropped with discard(). Values are
+// borrowed, so they must outlive the Bindings. undo(mark) takes back
+// everything since mark(), for backtracking
+class Bindings {
+public:
+    struct Mark {
+	std::size_t slot_count, trail_size, extra_count, boundary;
+    };
+private:
+    struct Slot {
+	std::size_t parent;
+	// Null while unbound and untyped; otherwise an unbound Variable
+	// (a type and maybe constraints) or a value
+	const IVariable *value;
+    };
+
+    std::vector<Slot> m_slots;
+    // The old state of each changed slot that is older than the newest mark
+    std::vector<std::pair<std::size_t, Slot>> m_trail;
+    // Constraints of an unbound class besides its root's, each with some
+    // slot of the class; only aliasing two constrained Variables adds these
+    std::vector<std::pair<std::size_t, const IVariable*>> m_extra_constraints;
+    std::size_t m_boundary = 0;
+    // discard()'s moved slots
+    std::vector<Slot> m_moved;
+
+    void set(std::size_t slot, const Slot &value)
+    {
+	if(slot < m_boundary)
+	    m_trail.emplace_back(slot, m_slots[slot]);
+	m_slots[slot] = value;
+    }
+
+    // Whether the extra constraints of the classes rooted at a and b
+    // accept value
+    bool extras_accept(std::size_t a, std::size_t b, const IVariable &value)
+    {
+	for(std::size_t i = 0; i < m_extra_constraints.size(); ++i) {
+	    auto [slot, constraint] = m_extra_constraints[i];
+	    std::size_t root = find(slot);
+	    if((root == a || root == b) && !constraint->can_unify(value))
+		return false;
+	}
+	return true;
+    }
+
+    // The value of the class made by joining the ones rooted at a and b
+    bool merge(std::size_t a, std::size_t b, const IVariable *value_a, const IVariable *value_b,
+	       const IVariable *&merged)
+    {
+	if(!value_a || !value_b) {
+	    merged = value_a ? value_a : value_b;
+	    return true;
+	}
+	if(value_a->is_unified() || value_b->is_unified()) {
+	    if(!value_a->can_unify(*value_b))
+		return false;
+	    merged = value_a->is_unified() ? value_a : value_b;
+	    return m_extra_constraints.empty() || extras_accept(a, b, *merged);
+	}
+	// Two unbound Variables: the same type, and both sets of constraints
+	if(typeid(*value_a) != typeid(*value_b))
+	    return false;
+	merged = value_a->is_constrained() ? value_a : value_b;
+	if(value_a->is_constrained() && value_b->is_constrained())
+	    m_extra_constraints.emplace_back(b, value_b);
+	return true;
+    }
+public:
+    // Adds count unbound slots; returns the first
+    std::size_t add(std::size_t count = 1)
+    {
+	std::size_t first = m_slots.size();
+	for(std::size_t i = 0; i < count; ++i)
+	    m_slots.push_back(Slot{first + i, nullptr});
+	return first;
+    }
+
+    std::size_t size() const { return m_slots.size(); }
+
+    // The root of slot's class
+    std::size_t find(std::size_t slot)
+    {
+	std::size_t root = slot;
+	while(m_slots[root].parent != root)
+	    root = m_slots[root].parent;
+	while(m_slots[slot].parent != root) {
+	    std::size_t next = m_slots[slot].parent;
+	    Slot compressed = m_slots[slot];
+	    compressed.parent = root;
+	    set(slot, compressed);
+	    slot = next;
+	}
+	return root;
+    }
+
+    bool is_aliased(std::size_t a, std::size_t b) { return find(a) == find(b); }
+
+    // Null if slot's class is unbound and untyped
+    const IVariable* value(std::size_t slot) { return m_slots[find(slot)].value; }
+
+    bool is_bound(std::size_t slot)
+    {
+	const IVariable *bound = value(slot);
+	return bound && bound->is_unified();
+    }
+
+    // Binds slot's class to value, or, if value is unbound, constrains it to
+    // value's type and constraints. A LogicVariable binds nothing. False if
+    // the class's value or constraints reject it
+    bool bind(std::size_t slot, const IVariable &value)
+    {
+	if(typeid(value) == typeid(LogicVariable))
+	    return true;
+	std::size_t root = find(slot);
+	const IVariable *merged;
+	if(!merge(root, root, m_slots[root].value, &value, merged))
+	    return false;
+	if(merged != m_slots[root].value)
+	    set(root, Slot{root, merged});
+	return true;
+    }
+
+    // Joins the classes of a and b under the older root
+    bool unify(std::size_t a, std::size_t b)
+    {
+	a = find(a);
+	b = find(b);
+	if(a == b)
+	    return true;
+	const IVariable *merged;
+	if(!merge(a, b, m_slots[a].value, m_slots[b].value, merged))
+	    return false;
+	if(b < a)
+	    std::swap(a, b);
+	set(b, Slot{a, m_slots[b].value});
+	set(a, Slot{a, merged});
+	return true;
+    }
+
+    // Changes to slots added after this are not trailed, since undo()
+    // removes those slots
+    Mark mark()
+    {
+	Mark result{m_slots.size(), m_trail.size(), m_extra_constraints.size(), m_boundary};
+	m_boundary = m_slots.size();
+	return result;
+    }
+
+    // Forgets mark, once nothing will go back to it: changes since are only
+    // kept on the trail for slots older than the mark before it
+    void release(const Mark &mark)
+    {
+	std::size_t kept = mark.trail_size;
+	for(std::size_t i = mark.trail_size; i < m_trail.size(); ++i) {
+	    if(m_trail[i].first < mark.boundary)
+		m_trail[kept++] = m_trail[i];
+	}
+	m_trail.resize(kept);
+	m_boundary = mark.boundary;
+    }
+
+    // Drops the slots from first up to end and moves the ones after them
+    // down to first. A moved slot whose root is dropped becomes the root in
+    // its place. False, changing nothing, if a mark is newer than first
+    bool discard(std::size_t first, std::size_t end)
+    {
+	if(m_boundary > first || first > end || end > m_slots.size())
+	    return false;
+	std::size_t shift = end - first;
+	// Points every slot that moves or holds constraints at its root
+	for(std::size_t slot = end; slot < m_slots.size(); ++slot)
+	    find(slot);
+	for(auto &[slot, constraint] : m_extra_constraints)
+	    slot = find(slot);
+	// A dropped root's parent becomes the slot that replaces it
+	m_moved.clear();
+	for(std::size_t slot = end; slot < m_slots.size(); ++slot) {
+	    std::size_t root = m_slots[slot].parent;
+	    if(root < first) {
+		m_moved.push_back(Slot{root, m_slots[slot].value});
+	    } else if(root >= end) {
+		m_moved.push_back(Slot{root - shift, m_slots[slot].value});
+	    } else if(m_slots[root].parent == root) {
+		m_moved.push_back(Slot{slot - shift, m_slots[root].value});
+		m_slots[root].parent = slot;
+	    } else {
+		m_moved.push_back(Slot{m_slots[root].parent - shift, m_slots[slot].value});
+	    }
+	}
+	std::size_t kept = 0;
+	for(auto [slot, constraint] : m_extra_constraints) {
+	    if(slot >= first && slot < end) {
+		// Every slot of the class was dropped
+		if(m_slots[slot].parent == slot)
+		    continue;
+		slot = m_slots[slot].parent;
+	    }
+	    m_extra_constraints[kept++] = {slot < first ? slot : slot - shift, constraint};
+	}
+	m_extra_constraints.resize(kept);
+	m_slots.resize(first);
+	m_slots.insert(m_slots.end(), m_moved.begin(), m_moved.end());
+	return true;
+    }
+
+    // Calls visit(value) on the value of each class that has one
+    template<typename Visitor>
+    void for_each_value(Visitor visit) const
+    {
+	for(std::size_t slot = 0; slot < m_slots.size(); ++slot) {
+	    if(m_slots[slot].parent == slot && m_slots[slot].value)
+		visit(*m_slots[slot].value);
+	}
+    }
+
+    void undo(const Mark &mark)
+    {
+	while(m_trail.size() > mark.trail_size) {
+	    m_slots[m_trail.back().first] = m_trail.back().second;
+	    m_trail.pop_back();
+	}
+	m_slots.resize(mark.slot_count);
+	m_extra_constraints.resize(mark.extra_count);
+	m_boundary = mark.boundary;
+    }
+
+    void clear()
+    {
+	m_slots.clear();
+	m_trail.clear();
+	m_extra_constraints.clear();
+	m_boundary = 0;
+    }
+};
+
+
+// Predicates are named by Name: std::string, or an enum whose name_count is
+// its number of enumerators. An enum-named Database keeps its predicates in
+// an array indexed by enumerator, so finding one takes no hashing and no
+// string comparison; it only takes clauses and queries named by enumerators
+template<typename Name = std::string>
+class BasicDatabase {
+    static_assert(std::is_same_v<Name, std::string> || std::is_enum_v<Name>,
+		  "predicates are named by std::string or by an enum");
+private:
+    static constexpr bool is_enum_named = std::is_enum_v<Name>;
+    // What predicates are found by: the name, or the enumerator's value
+    using Key = std::conditional_t<is_enum_named, std::size_t, std::string>;
+
+    static decltype(auto) key_of(const RuleVariable &term)
+    {
+	if constexpr(is_enum_named)
+	    return term.predicate();
+	else
+	    return term.name();
+    }
+
+    static decltype(auto) key_of(const Name &name)
+    {
+	if constexpr(is_enum_named)
+	    return static_cast<std::size_t>(name);
+	else
+	    return name;
+    }
+
+    static bool is_valid(const Key &key)
+    {
+	if constexpr(is_enum_named)
+	    return key < name_count<Name>::value;
+	else
+	    return true;
+    }
+
+    static std::string name_of(const Name &name)
+    {
+	if constexpr(is_enum_named)
+	    return predicate_name(name);
+	else
+	    return name;
+    }
+    // All clauses sharing a name. Ground facts that fit a FactTable are kept
+    // there; the other clauses are kept as Rules, whose heads are indexed
+    // so queries skip the Rules that can't unify with them
+    struct Bucket {
+	std::vector<const Rule*> rules;
+	// The Rules among rules that were added by value or loaded from
+	// text. Copies of the bucket share them, so a Rule lives as long as
+	// some version of its bucket does
+	std::vector<std::shared_ptr<const Rule>> owned;
+	FactTable facts;
+	// For each Rule, how many facts were added before it, which keeps
+	// clause order across the two
+	std::vector<std::size_t> facts_before;
+	// For each Rule, how many variable slots a call to it takes: one
+	// past the highest LogicVariable slot in its head and body
+	std::vector<std::size_t> slot_counts;
+	HeadIndex heads;
+	// Distinct values among the bound params at each position
+	std::vector<DistinctCounter> distinct;
+	// Set by freeze(): each counter's estimate, which can't change anymore
+	std::vector<double> distinct_estimates;
+
+	void count_distinct(const RuleVariable &clause)
+	{
+	    if(distinct.size() < clause.arity())
+		distinct.resize(clause.arity());
+	    for(std::size_t i = 0; i < clause.arity(); ++i) {
+		if(clause[i]->is_unified())
+		    distinct[i].add(clause[i]->hash());
+	    }
+	}
+
+	static std::size_t slot_count(const Rule &rule)
+	{
+	    std::size_t count = 0;
+	    auto count_params = [&](const RuleVariable &term) {
+		for(std::size_t i = 0; i < term.arity(); ++i) {
+		    const IVariable &param = *term[i];
+		    if(typeid(param) == typeid(LogicVariable))
+			count = std::max(count, static_cast<const LogicVariable&>(param).slot() + 1);
+		}
+	    };
+	    count_params(rule);
+	    for(const auto &goal : rule.predicates())
+		count_params(goal);
+	    return count;
+	}
+
+	void index(std::size_t position)
+	{
+	    heads.add(*rules[position], position);
+	    count_distinct(*rules[position]);
+	}
+
+	// Whether add(rule) would copy rule into facts rather than refer to it
+	bool stores_as_fact(const Rule &rule) const
+	{
+	    return rule.predicates().empty() && facts.accepts(rule);
+	}
+
+	void add(const Rule &rule)
+	{
+	    if(stores_as_fact(rule)) {
+		facts.add(rule);
+		count_distinct(rule);
+		return;
+	    }
+	    rules.push_back(&rule);
+	    facts_before.push_back(facts.size());
+	    slot_counts.push_back(slot_count(rule));
+	    index(rules.size() - 1);
+	}
+
+	std::size_t size() const { return rules.size() + facts.size(); }
+
+	double distinct_count(std::size_t position) const
+	{
+	    return position < distinct_estimates.size() ? distinct_estimates[position]
+		: distinct[position].estimate();
+	}
+
+	// Gives back spare capacity and works out in advance what can only
+	// change when clauses are added
+	void freeze()
+	{
+	    rules.shrink_to_fit();
+	    owned.shrink_to_fit();
+	    facts.shrink_to_fit();
+	    facts_before.shrink_to_fit();
+	    slot_counts.shrink_to_fit();
+	    heads.shrink_to_fit();
+	    distinct_estimates.clear();
+	    for(const auto &counter : distinct)
+		distinct_estimates.push_back(counter.estimate());
+	}
+
+	// Calls visit(clause) on every clause in insertion order, stopping
+	// early when visit returns true. Facts are passed as temporary Rules
+	template<typename Visitor>
+	bool for_each_clause(const Name &name, Visitor visit) const
+	{
+	    std::size_t row = 0;
+	    for(std::size_t position = 0; position <= rules.size(); ++position) {
+		std::size_t end = position < rules.size() ? facts_before[position] : facts.size();
+		for(; row < end; ++row) {
+		    if(visit(facts.to_rule(name, row)))
+			return true;
+		}
+		if(position < rules.size() && visit(*rules[position]))
+		    return true;
+	    }
+	    return false;
+	}
+
+	// Whether head can't unify with conjecture because of a value
+	template<typename Term>
+	static bool clashes(const Term &conjecture, const Rule &head)
+	{
+	    if(conjecture.arity() != head.arity())
+		return true;
+	    for(std::size_t i = 0; i < head.arity(); ++i) {
+		const IVariable &param = *conjecture[i];
+		if(param.is_unified() && head[i]->is_unified() && !param.can_unify(*head[i]))
+		    return true;
+	    }
+	    return false;
+	}
+
+	// Calls visit(position, rule) in insertion order on each Rule (not
+	// fact) that might unify with conjecture, stopping early when visit
+	// returns true. can_alias is passed on to HeadIndex::visit
+	template<typename Term, typename Visitor>
+	bool visit_candidates(const Term &conjecture, Visitor visit, bool can_alias = false) const
+	{
+	    // Walking the tree costs more than comparing a few heads' values
+	    if(rules.size() <= 4) {
+		for(std::size_t position = 0; position < rules.size(); ++position) {
+		    if(!clashes(conjecture, *rules[position]) && visit(position, *rules[position]))
+			return true;
+		}
+		return false;
+	    }
+	    return heads.visit(conjecture, [&](std::size_t position) {
+		return visit(position, *rules[position]);
+	    }, can_alias);
+	}
+    };
+    // Buckets and the table of buckets are shared between a Database and its
+    // snapshots; whichever one adds a Rule first copies only what it touches
+    // The table of an enum-named Database: a slot per enumerator
+    struct DenseTable {
+	std::array<std::shared_ptr<Bucket>, name_count<Name>::value> slots;
+    };
+    using Table = std::conditional_t<is_enum_named, DenseTable,
+				     std::map<std::string, std::shared_ptr<Bucket>>>;
+
+    static std::shared_ptr<Bucket>& slot_of(Table &table, const Key &key)
+    {
+	if constexpr(is_enum_named)
+	    return table.slots[key];
+	else
+	    return table[key];
+    }
+
+    // Calls visit(name, bucket) on each predicate, stopping early when visit
+    // returns true
+    template<typename Tables, typename Visitor>
+    static bool for_each_bucket(Tables &table, Visitor visit)
+    {
+	if constexpr(is_enum_named) {
+	    for(std::size_t i = 0; i < table.slots.size(); ++i) {
+		if(table.slots[i] && visit(static_cast<Name>(i), table.slots[i]))
+		    return true;
+	    }
+	} else {
+	    for(auto &[name, bucket] : table) {
+		if(visit(name, bucket))
+		    return true;
+	    }
+	}
+	return false;
+    }
+
+    // A Table that will never change, looked up through a minimal perfect
+    // hash (hash and displace): names are put in groups by one hash, then
+    // each group gets the first seed that sends its names to free slots of
+    // an array with one slot per name. Finding a name costs one string hash
+    // and one comparison
+    class FrozenTable {
+    private:
+	std::shared_ptr<const Table> m_table;
+	// Per group: the seed, or -(slot + 1) for a group of one name
+	std::vector<std::int64_t> m_seeds;
+	std::vector<std::pair<const std::string*, const Bucket*>> m_slots;
+
+	static std::size_t mix(std::size_t hash, std::size_t seed, std::size_t size)
+	{
+	    std::uint64_t x = hash + seed * 0x9e3779b97f4a7c15ull;
+	    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	    return static_cast<std::size_t>((x ^ (x >> 31)) % size);
+	}
+    public:
+	explicit FrozenTable(std::shared_ptr<const Table> table)
+	    : m_table(std::move(table))
+	{
+	    std::size_t size = m_table->size();
+	    std::vector<std::pair<std::size_t, typename Table::const_iterator>> names;
+	    for(auto entry = m_table->begin(); entry != m_table->end(); ++entry)
+		names.emplace_back(std::hash<std::string>{}(entry->first), entry);
+	    std::vector<std::vector<std::size_t>> groups(size);
+	    for(std::size_t i = 0; i < size; ++i)
+		groups[mix(names[i].first, 0, size)].push_back(i);
+	    std::vector<std::size_t> order(size);
+	    for(std::size_t i = 0; i < size; ++i)
+		order[i] = i;
+	    // Larger groups are harder to place, so they go first
+	    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+		return groups[a].size() > groups[b].size();
+	    });
+	    m_seeds.assign(size, 0);
+	    m_slots.assign(size, {nullptr, nullptr});
+	    std::vector<std::size_t> slots;
+	    std::size_t free_slot = 0;
+	    for(std::size_t group : order) {
+		const auto &members = groups[group];
+		if(members.size() == 1) {
+		    while(m_slots[free_slot].first)
+			++free_slot;
+		    slots.assign(1, free_slot);
+		    m_seeds[group] = -static_cast<std::int64_t>(free_slot) - 1;
+		} else if(members.size() > 1) {
+		    for(std::size_t seed = 1;; ++seed) {
+			slots.clear();
+			for(std::size_t i : members) {
+			    std::size_t slot = mix(names[i].first, seed, size);
+			    if(m_slots[slot].first
+			       || std::find(slots.begin(), slots.end(), slot) != slots.end())
+				break;
+			    slots.push_back(slot);
+			}
+			if(slots.size() == members.size()) {
+			    m_seeds[group] = static_cast<std::int64_t>(seed);
+			    break;
+			}
+			if(seed == 1u << 20) {
+			    // Names whose hashes are equal can't be told apart
+			    // by any seed; fall back to the Table
+			    m_slots.clear();
+			    return;
+			}
+		    }
+		}
+		for(std::size_t i = 0; i < slots.size(); ++i) {
+		    auto entry = names[members[i]].second;
+		    m_slots[slots[i]] = {&entry->first, entry->second.get()};
+		}
+		slots.clear();
+	    }
+	}
+
+	// The Bucket of name, or nullptr
+	const Bucket* find(const std::string &name) const
+	{
+	    if(m_slots.empty()) {
+		auto match = m_table->find(name);
+		return match != m_table->end() ? match->second.get() : nullptr;
+	    }
+	    std::size_t hash = std::hash<std::string>{}(name);
+	    std::int64_t seed = m_seeds[mix(hash, 0, m_slots.size())];
+	    std::size_t slot = seed < 0 ? static_cast<std::size_t>(-seed - 1)
+		: mix(hash, static_cast<std::size_t>(seed), m_slots.size());
+	    return *m_slots[slot].first == name ? m_slots[slot].second : nullptr;
+	}
+    };
+    std::shared_ptr<Table> m_rules;
+    // From freeze() on, m_rules never changes
+    bool m_is_frozen = false;
+    // Set by freeze() if named by strings
+    std::shared_ptr<const FrozenTable> m_frozen;
+    std::shared_ptr<SymbolTable> m_symbols;
+    // Orders found by plan() for one version of the table, by Rule and by
+    // which of the Rule's params the call gives a value. Entries are only
+    // ever added, so a reference to one stays valid
+    struct Plans {
+	std::weak_ptr<const void> table;
+	std::shared_mutex mutex;
+	std::map<std::pair<const Rule*, std::uint64_t>, std::vector<std::size_t>> orders;
+    };
+    // The Plans of the table last queried, dropped once another is queried
+    struct PlanCache {
+	std::shared_ptr<Plans> current;
+    };
+    // Replaced whenever this Database's table changes in place
+    std::shared_ptr<PlanCache> m_plans;
+
+    Bucket& writable_bucket(const Key &key)
+    {
+	m_plans = std::make_shared<PlanCache>();
+	if(m_rules.use_count() > 1)
+	    m_rules = std::make_shared<Table>(*m_rules);
+	auto &bucket = slot_of(*m_rules, key);
+	if(!bucket)
+	    bucket = std::make_shared<Bucket>();
+	else if(bucket.use_count() > 1)
+	    bucket = std::make_shared<Bucket>(*bucket);
+	return *bucket;
+    }
+
+    std::shared_ptr<const Table> current_table() const { return std::atomic_load(&m_rules); }
+
+    static const Bucket* find_bucket(const Table &table, const Key &key)
+    {
+	if constexpr(is_enum_named) {
+	    return key < table.slots.size() ? table.slots[key].get() : nullptr;
+	} else {
+	    auto match = table.find(key);
+	    return match != table.end() ? match->second.get() : nullptr;
+	}
+    }
+
+    static const Bucket* find_bucket(const FrozenTable &table, const std::string &name)
+    {
+	return table.find(name);
+    }
+
+    static bool is_bound(const IVariable &param, const std::vector<bool> &bound_slots)
+    {
+	if(param.is_unified())
+	    return true;
+	auto *variable = dynamic_cast<const LogicVariable*>(&param);
+	return variable && variable->slot() < bound_slots.size() && bound_slots[variable->slot()];
+    }
+
+    // Expected number of clauses matching goal: the predicate's size divided
+    // by the distinct value count of each bound argument
+    template<typename Tables>
+    static double estimate(const Tables &table, const RuleVariable &goal,
+			   const std::vector<bool> &bound_slots)
+    {
+	const Bucket *found = find_bucket(table, key_of(goal));
+	if(!found)
+	    return 0;
+	const Bucket &bucket = *found;
+	double rows = static_cast<double>(bucket.size());
+	for(std::size_t i = 0; i < goal.arity() && i < bucket.distinct.size(); ++i) {
+	    if(is_bound(*goal[i], bound_slots))
+		rows /= std::max(1.0, bucket.distinct_count(i));
+	}
+	return rows;
+    }
+
+    // Order in which to prove rule's predicates when called with conjecture:
+    // repeatedly takes the predicate with the lowest estimate, counting the
+    // variables bound by conjecture and by predicates already taken as bound.
+    // A predicate calling the Rule's own name is never moved ahead of the
+    // predicates written before it, so recursion stays where the user put it
+    template<typename Tables>
+    static std::vector<std::size_t> plan(const Tables &table, const Rule &rule,
+					 const RuleVariable &conjecture,
+					 std::vector<double> *estimates = nullptr)
+    {
+	const auto &goals = rule.predicates();
+	std::vector<std::size_t> order;
+	order.reserve(goals.size());
+	if(rule.keeps_order() || goals.size() < 2) {
+	    for(std::size_t i = 0; i < goals.size(); ++i)
+		order.push_back(i);
+	    if(estimates) {
+		std::vector<bool> none;
+		for(const auto &goal : goals)
+		    estimates->push_back(estimate(table, goal, none));
+	    }
+	    return order;
+	}
+
+	std::vector<bool> bound_slots;
+	auto bind_slots = [&](const RuleVariable &source, const RuleVariable *values) {
+	    for(std::size_t i = 0; i < source.arity(); ++i) {
+		auto *variable = dynamic_cast<const LogicVariable*>(source[i]);
+		if(!variable || (values && !(i < values->arity() && (*values)[i]->is_unified())))
+		    continue;
+		if(bound_slots.size() <= variable->slot())
+		    bound_slots.resize(variable->slot() + 1);
+		bound_slots[variable->slot()] = true;
+	    }
+	};
+	bind_slots(rule, &conjecture);
+	std::vector<bool> taken(goals.size(), false);
+	std::size_t first_untaken = 0;
+	while(order.size() < goals.size()) {
+	    std::size_t best = goals.size();
+	    double best_estimate = 0;
+	    for(std::size_t i = first_untaken; i < goals.size(); ++i) {
+		if(taken[i])
+		    continue;
+		bool is_recursive = goals[i].name() == rule.name();
+		if(is_recursive && i > first_untaken)
+		    continue;
+		double rows = estimate(table, goals[i], bound_slots);
+		if(best == goals.size() || rows < best_estimate) {
+		    best = i;
+		    best_estimate = rows;
+		}
+	    }
+	    taken[best] = true;
+	    order.push_back(best);
+	    if(estimates)
+		estimates->push_back(best_estimate);
+	    bind_slots(goals[best], nullptr);
+	    while(first_untaken < goals.size() && taken[first_untaken])
+		++first_untaken;
+	}
+	return order;
+    }
+
+    // The Plans of table; they become the cached ones if they weren't
+    std::shared_ptr<Plans> plans_for(const std::shared_ptr<const void> &table) const
+    {
+	auto plans = std::atomic_load(&m_plans->current);
+	if(plans && !plans->table.owner_before(table) && !table.owner_before(plans->table))
+	    return plans;
+	plans = std::make_shared<Plans>();
+	plans->table = table;
+	std::atomic_store(&m_plans->current, plans);
+	return plans;
+    }
+
+    // plan(table, rule, conjecture), worked out once per table and pattern
+    // of conjecture's params with a value. Rules with more params than the
+    // pattern can hold are planned on each call, into uncached
+    template<typename Tables>
+    static const std::vector<std::size_t>& cached_plan(const Tables &table, Plans &plans,
+						       const Rule &rule,
+						       const RuleVariable &conjecture,
+						       std::vector<std::size_t> &uncached)
+    {
+	if(conjecture.arity() > 64) {
+	    uncached = plan(table, rule, conjecture);
+	    return uncached;
+	}
+	std::uint64_t pattern = 0;
+	for(std::size_t i = 0; i < conjecture.arity(); ++i) {
+	    if(conjecture[i]->is_unified())
+		pattern |= std::uint64_t(1) << i;
+	}
+	std::pair<const Rule*, std::uint64_t> key{&rule, pattern};
+	{
+	    std::shared_lock<std::shared_mutex> lock(plans.mutex);
+	    auto found = plans.orders.find(key);
+	    if(found != plans.orders.end())
+		return found->second;
+	}
+	auto order = plan(table, rule, conjecture);
+	std::unique_lock<std::shared_mutex> lock(plans.mutex);
+	return plans.orders.try_emplace(key, std::move(order)).first->second;
+    }
+
+    template<typename Tables>
+    static bool query(const Tables &table, Plans &plans, const RuleVariable &conjecture)
+    {
+	const Bucket *found = find_bucket(table, key_of(conjecture));
+	if(!found)
+	    return false;
+	// The first clause that unifies decides; a fact proves conjecture
+	const Bucket &bucket = *found;
+	std::size_t fact = bucket.facts.next_match(conjecture);
+	if(bucket.rules.empty())
+	    return fact < bucket.facts.size();
+	bool result = false;
+	bool found_rule = bucket.visit_candidates(conjecture, [&](std::size_t position, const Rule &rule) {
+	    if(!conjecture.can_unify(rule))
+		return false;
+	    result = true;
+	    if(fact < bucket.facts_before[position])
+		return true;
+	    const auto &goals = rule.predicates();
+	    if(goals.size() < 2 || rule.keeps_order()) {
+		for(const auto &each : goals) {
+		    if(!query(table, plans, each)) {
+			result = false;
+			break;
+		    }
+		}
+	    } else {
+		std::vector<std::size_t> uncached;
+		for(std::size_t i : cached_plan(table, plans, rule, conjecture, uncached)) {
+		    if(!query(table, plans, goals[i])) {
+			result = false;
+			break;
+		    }
+		}
+	    }
+	    return true;
+	});
+	return found_rule ? result : fact < bucket.facts.size();
+    }
+
+    static Name name_of(const RuleVariable &term)
+    {
+	if constexpr(is_enum_named)
+	    return static_cast<Name>(term.predicate());
+	else
+	    return term.name();
+    }
+
+    // One for_each_solution() call: resolution with Prolog's semantics, where
+    // a variable bound by one goal stays bound in the goals after it. The
+    // bindings live in a Bindings of the call's own, indexed by a frame's
+    // base slot plus a LogicVariable's slot, so the Rules are only read and
+    // any number of calls can run on one Database at once. A Rule is never
+    // copied for a call: its terms are shared, and the call only adds as
+    // many slots as the Rule has variables. Once its vectors have grown, a
+    // resolution step allocates nothing. When no choice point can go back
+    // into a call, its frame and slots are dropped on return, and a call to
+    // the last goal of a Rule's body takes over its caller's frame, so
+    // deterministic tail recursion runs in constant memory
+    template<typename Tables>
+    class Resolution {
+    private:
+	// A Rule whose body is being proven, with its slots at [base, end),
+	// and the goal its caller continues after
+	struct Frame {
+	    const RuleVariable *goals;
+	    std::size_t goal_count;
+	    std::size_t base, end;
+	    std::size_t parent, parent_goal;
+	};
+
+	// A goal with its bound values filled in: params[i] is the value of
+	// the goal's ith param, or a wildcard. Read by the fact and head
+	// indexes in place of a RuleVariable
+	struct Probe {
+	    const IVariable *const *params;
+	    std::size_t count;
+
+	    std::size_t arity() const { return count; }
+	    const IVariable* operator[](std::size_t index) const { return params[index]; }
+	};
+
+	// A call, and the clauses left to try for it: the Rules at
+	// m_candidates[next_candidate..candidates_end), and the facts from
+	// next_row on that match the goal's probe, kept in m_probes from
+	// probe_begin on
+	struct ChoicePoint {
+	    std::size_t frame, goal;
+	    Bindings::Mark mark;
+	    std::size_t frame_count, value_count;
+	    const Bucket *bucket;
+	    std::size_t candidates_begin, next_candidate, candidates_end;
+	    std::size_t next_row;
+	    std::size_t probe_begin;
+	};
+
+	const Tables &m_table;
+	Bindings m_bindings;
+	std::vector<Frame> m_frames;
+	std::vector<ChoicePoint> m_choices;
+	std::vector<std::size_t> m_candidates;
+	std::vector<const IVariable*> m_probes;
+	// Values from fact rows that slots are bound to. The first
+	// m_value_count are in use; the rest are reused when their type fits
+	std::vector<std::unique_ptr<IVariable>> m_values;
+	std::size_t m_value_count = 0;
+	// collect_values()'s list of the values slots hold
+	std::vector<const IVariable*> m_held;
+
+	static const LogicVariable* as_variable(const IVariable &param)
+	{
+	    return typeid(param) == typeid(LogicVariable) ? static_cast<const LogicVariable*>(&param) : nullptr;
+	}
+
+	// Unifies a param of a goal (in the frame at a_base) with one of a
+	// head (at b_base)
+	bool unify(const IVariable &a, std::size_t a_base, const IVariable &b, std::size_t b_base)
+	{
+	    auto *x = as_variable(a);
+	    auto *y = as_variable(b);
+	    if(x && y)
+		return m_bindings.unify(a_base + x->slot(), b_base + y->slot());
+	    if(x)
+		return m_bindings.bind(a_base + x->slot(), b);
+	    if(y)
+		return m_bindings.bind(b_base + y->slot(), a);
+	    // Two Type<>s only need the same type
+	    return a.is_unified() || b.is_unified() ? a.can_unify(b) : typeid(a) == typeid(b);
+	}
+
+	// Adds goal's probe to m_probes
+	void add_probe(const RuleVariable &goal, std::size_t base)
+	{
+	    static const LogicVariable wildcard{0};
+	    for(std::size_t i = 0; i < goal.arity(); ++i) {
+		const IVariable *value = goal[i];
+		if(auto *variable = as_variable(*value))
+		    value = m_bindings.value(base + variable->slot());
+		m_probes.push_back(value ? value : &wildcard);
+	    }
+	}
+
+	Probe probe_of(const ChoicePoint &choice, std::size_t arity) const
+	{
+	    return Probe{m_probes.data() + choice.probe_begin, arity};
+	}
+
+	// The value in column at row of facts, kept until backtracking
+	// past this point
+	const IVariable& hold(const FactTable &facts, std::size_t row, std::size_t column)
+	{
+	    return facts.visit_value(row, column, [&](const auto &value) -> const IVariable& {
+		using T = std::decay_t<decltype(value)>;
+		auto &entry = m_value_count < m_values.size() ? m_values[m_value_count] : m_values.emplace_back();
+		++m_value_count;
+		if(entry) {
+		    IVariable &spare = *entry;
+		    if(typeid(spare) == typeid(Variable<T>)) {
+			static_cast<Variable<T>&>(spare).set_value(value);
+			return spare;
+		    }
+		}
+		entry = std::make_unique<Variable<T>>(value);
+		return *entry;
+	    });
+	}
+
+	// Moves the values no slot holds anymore, among those taken since the
+	// newest choice point, behind the ones in use. Only runs once they
+	// outnumber the slots, so it takes amortized O(1) time a value
+	void collect_values()
+	{
+	    std::size_t first = m_choices.empty() ? 0 : m_choices.back().value_count;
+	    if(m_value_count - first <= 2 * m_bindings.size() + 16)
+		return;
+	    m_held.clear();
+	    m_bindings.for_each_value([&](const IVariable &value) { m_held.push_back(&value); });
+	    std::less<const IVariable*> before;
+	    std::sort(m_held.begin(), m_held.end(), before);
+	    auto end = std::partition(m_values.begin() + first, m_values.begin() + m_value_count,
+				      [&](const auto &value) {
+					  return std::binary_search(m_held.begin(), m_held.end(), value.get(),
+								    before);
+				      });
+	    m_value_count = static_cast<std::size_t>(end - m_values.begin());
+	}
+
+	void pop_choice()
+	{
+	    const ChoicePoint &choice = m_choices.back();
+	    m_bindings.release(choice.mark);
+	    m_candidates.resize(choice.candidates_begin);
+	    m_probes.resize(choice.probe_begin);
+	    m_choices.pop_back();
+	}
+
+	// Drops the frames and slots of the calls that have returned to
+	// frame, unless a choice point may go back into them
+	void trim(std::size_t frame)
+	{
+	    std::size_t frame_count = frame + 1;
+	    std::size_t slot_count = m_frames[frame].end;
+	    if(!m_choices.empty()) {
+		frame_count = std::max(frame_count, m_choices.back().frame_count);
+		slot_count = std::max(slot_count, m_choices.back().mark.slot_count);
+	    }
+	    if(frame_count < m_frames.size())
+		m_frames.resize(frame_count);
+	    if(slot_count < m_bindings.size())
+		m_bindings.discard(slot_count, m_bindings.size());
+	    collect_values();
+	}
+
+	// Puts the newest frame, which proves the last goal of caller, in
+	// caller's place if no choice point may go back into caller: the new
+	// frame's slots move down over caller's, which nothing needs once
+	// the head is unified (last-call optimization)
+	bool reuse_frame(std::size_t caller)
+	{
+	    const Frame &old = m_frames[caller];
+	    if(caller == 0 || (!m_choices.empty() && m_choices.back().frame_count > caller))
+		return false;
+	    Frame callee = m_frames.back();
+	    if(!m_bindings.discard(old.base, callee.base))
+		return false;
+	    callee.end -= callee.base - old.base;
+	    callee.base = old.base;
+	    callee.parent = old.parent;
+	    callee.parent_goal = old.parent_goal;
+	    m_frames.resize(caller + 1);
+	    m_frames[caller] = callee;
+	    collect_values();
+	    return true;
+	}
+
+	// Tries the newest choice point's clauses from the next one on, and
+	// on success moves frame and goal to what is proven next. The choice
+	// point is popped once its last clause is taken
+	bool resume(std::size_t &frame, std::size_t &goal)
+	{
+	    while(true) {
+		ChoicePoint &choice = m_choices.back();
+		const Bucket &bucket = *choice.bucket;
+		m_bindings.undo(choice.mark);
+		choice.mark = m_bindings.mark();
+		m_frames.resize(choice.frame_count);
+		m_value_count = choice.value_count;
+		frame = choice.frame;
+		goal = choice.goal;
+		const Frame &caller = m_frames[frame];
+		const RuleVariable &term = caller.goals[goal];
+		bool has_rule = choice.next_candidate < choice.candidates_end;
+		bool has_fact = choice.next_row < bucket.facts.size();
+		if(!has_rule && !has_fact) {
+		    pop_choice();
+		    return false;
+		}
+		bool ok = true;
+		if(has_fact && (!has_rule || choice.next_row < bucket.facts_before[m_candidates[choice.next_candidate]])) {
+		    std::size_t row = choice.next_row;
+		    Probe probe = probe_of(choice, term.arity());
+		    choice.next_row = bucket.facts.next_match(probe, row + 1);
+		    // The row already equals the probe's bound values
+		    for(std::size_t i = 0; i < term.arity() && ok; ++i) {
+			if(!probe[i]->is_unified())
+			    ok = unify(*term[i], caller.base, hold(bucket.facts, row, i), 0);
+		    }
+		    ++goal;
+		} else {
+		    std::size_t position = m_candidates[choice.next_candidate++];
+		    const Rule &rule = *bucket.rules[position];
+		    ok = rule.arity() == term.arity();
+		    std::size_t base = m_bindings.add(bucket.slot_counts[position]);
+		    for(std::size_t i = 0; i < term.arity() && ok; ++i)
+			ok = unify(*term[i], caller.base, *rule[i], base);
+		    if(rule.predicates().empty()) {
+			++goal;
+		    } else {
+			m_frames.push_back(Frame{rule.predicates().data(), rule.predicates().size(), base,
+						 m_bindings.size(), frame, goal});
+			frame = m_frames.size() - 1;
+			goal = 0;
+		    }
+		}
+		if(choice.next_candidate == choice.candidates_end && choice.next_row == bucket.facts.size()) {
+		    std::size_t caller = choice.frame;
+		    bool is_last_call = goal == 0 && choice.goal + 1 == m_frames[caller].goal_count;
+		    pop_choice();
+		    if(!ok)
+			return false;
+		    if(is_last_call && reuse_frame(caller))
+			frame = caller;
+		}
+		if(ok)
+		    return true;
+	    }
+	}
+
+	// Pushes a choice point for the goal and tries its first clause
+	bool call(std::size_t &frame, std::size_t &goal)
+	{
+	    const RuleVariable &term = m_frames[frame].goals[goal];
+	    const Bucket *bucket = find_bucket(m_table, key_of(term));
+	    if(!bucket)
+		return false;
+	    ChoicePoint choice{frame, goal, m_bindings.mark(), m_frames.size(), m_value_count, bucket,
+			       m_candidates.size(), m_candidates.size(), m_candidates.size(),
+			       bucket->facts.size(), m_probes.size()};
+	    add_probe(term, m_frames[frame].base);
+	    Probe probe = probe_of(choice, term.arity());
+	    bucket->visit_candidates(probe, [&](std::size_t position, const Rule&) {
+		m_candidates.push_back(position);
+		return false;
+	    }, true);
+	    choice.candidates_end = m_candidates.size();
+	    if(bucket->facts.size() > 0)
+		choice.next_row = bucket->facts.next_match(probe);
+	    m_choices.push_back(choice);
+	    return resume(frame, goal);
+	}
+    public:
+	explicit Resolution(const Tables &table) : m_table(table) {}
+
+	template<typename Visitor>
+	bool solve(const RuleVariable &conjecture, Visitor visit)
+	{
+	    // The query is a frame of its own, with a slot for each Type<> too
+	    std::size_t slot_count = 0;
+	    for(std::size_t i = 0; i < conjecture.arity(); ++i) {
+		if(auto *variable = as_variable(*conjecture[i]))
+		    slot_count = std::max(slot_count, variable->slot() + 1);
+	    }
+	    RuleVariable query{name_of(conjecture)};
+	    std::vector<std::size_t> typed;
+	    for(std::size_t i = 0; i < conjecture.arity(); ++i) {
+		const IVariable &param = *conjecture[i];
+		if(auto *variable = as_variable(param)) {
+		    query.add_param(Var{variable->slot()});
+		} else if(!param.is_unified()) {
+		    query.add_param(Var{slot_count + typed.size()});
+		    typed.push_back(i);
+		} else {
+		    query.add_param(param.clone());
+		}
+	    }
+	    m_bindings.add(slot_count + typed.size());
+	    for(std::size_t k = 0; k < typed.size(); ++k)
+		m_bindings.bind(slot_count + k, *conjecture[typed[k]]);
+	    m_frames.push_back(Frame{&query, 1, 0, m_bindings.size(), 0, 0});
+
+	    bool found = false;
+	    std::size_t frame = 0, goal = 0;
+	    while(true) {
+		if(frame != 0 && goal == m_frames[frame].goal_count) {
+		    while(frame != 0 && goal == m_frames[frame].goal_count) {
+			goal = m_frames[frame].parent_goal + 1;
+			frame = m_frames[frame].parent;
+		    }
+		    trim(frame);
+		}
+		bool ok;
+		if(frame == 0 && goal == 1) {
+		    found = true;
+		    RuleVariable solution{name_of(conjecture)};
+		    for(std::size_t i = 0; i < conjecture.arity(); ++i) {
+			const IVariable *value = nullptr;
+			if(auto *variable = as_variable(*query[i]))
+			    value = m_bindings.value(variable->slot());
+			bool is_bound = value && value->is_unified();
+			solution.add_param((is_bound ? value : conjecture[i])->clone());
+		    }
+		    if(visit(static_cast<const RuleVariable&>(solution)))
+			return true;
+		    ok = false;
+		} else {
+		    ok = call(frame, goal);
+		}
+		while(!ok) {
+		    if(m_choices.empty())
+			return found;
+		    ok = resume(frame, goal);
+		}
+	    }
+	}
+    };
+
+    std::string describe(const RuleVariable &term) const
+    {
+	std::string text = term.name() + "(";
+	for(std::size_t i = 0; i < term.arity(); ++i) {
+	    auto *symbol = dynamic_cast<const Variable<Symbol>*>(term[i]);
+	    if(i > 0)
+		text += ", ";
+	    if(symbol && symbol->is_unified() && symbol->value().id < m_symbols->size())
+		text += m_symbols->name(symbol->value());
+	    else
+		text += term[i]->to_string();
+	}
+	return text + ")";
+    }
+public:
+    using name_type = Name;
+
+    // Collects Rules and adds them to the Database in one step on commit(), so
+    // each touched bucket is copied and indexed once per batch instead of once
+    // per Rule. Queries (from any thread) see either none or all of a batch
+    class Batch {
+    private:
+	BasicDatabase &m_db;
+	// Each pending Rule, and whether it is one of m_arena's
+	std::vector<std::pair<Rule*, bool>> m_pending;
+	// Rules added by value; on commit the ones that aren't stored as facts
+	// move to the Database
+	std::deque<Rule> m_arena;
+
+	static std::size_t head_hash(const Rule &rule)
+	{
+	    std::size_t result = rule.arity();
+	    for(std::size_t i = 0; i < rule.arity(); ++i)
+		result = result * 31 + rule[i]->hash();
+	    return result;
+	}
+    public:
+	explicit Batch(BasicDatabase &db) : m_db(db) {}
+
+	void add_rule(Rule &new_rule) { m_pending.emplace_back(&new_rule, false); }
+
+	// Same as above, but the Database keeps the Rule alive
+	void add_rule(Rule &&new_rule)
+	{
+	    m_arena.push_back(std::move(new_rule));
+	    m_pending.emplace_back(&m_arena.back(), true);
+	}
+
+	std::size_t size() const { return m_pending.size(); }
+
+	void rollback()
+	{
+	    m_pending.clear();
+	    m_arena.clear();
+	}
+
+	// Groups the pending Rules by name, drops any that are structurally
+	// equal to an earlier one (in the batch or already in the Database),
+	// then publishes the new buckets together. Returns the number added,
+	// which is 0 (and the batch is dropped) if the Database is frozen.
+	// Only batches drop duplicates: BasicDatabase::add_rule() keeps each
+	// copy it is given, and a commit leaves copies already in the
+	// Database alone. load() goes through a Batch
+	std::size_t commit()
+	{
+	    if(m_db.m_is_frozen) {
+		rollback();
+		return 0;
+	    }
+	    std::stable_sort(m_pending.begin(), m_pending.end(), [](const auto &a, const auto &b) {
+		return a.first->name() < b.first->name();
+	    });
+	    auto table = std::make_shared<Table>(*m_db.current_table());
+	    std::size_t added = 0;
+	    auto group = m_pending.begin();
+	    while(group != m_pending.end()) {
+		const auto &name = group->first->name();
+		auto group_end = std::find_if(group, m_pending.end(),
+					      [&](const auto &p) { return p.first->name() != name; });
+		if(!is_valid(key_of(*group->first))) {
+		    group = group_end;
+		    continue;
+		}
+		auto &slot = slot_of(*table, key_of(*group->first));
+		// The old bucket may still be read through the old table, so the
+		// batch always goes into a copy
+		auto bucket = slot ? std::make_shared<Bucket>(*slot) : std::make_shared<Bucket>();
+		// Roughly how many Rules won't be stored as facts
+		auto rule_estimate = std::count_if(group, group_end, [&](const auto &p) {
+		    return !bucket->stores_as_fact(*p.first);
+		});
+		bucket->rules.reserve(bucket->rules.size() + rule_estimate);
+
+		// Candidates are the bucket's Rules, then its facts, then the
+		// pending Rules. Sort (hash, candidate) pairs so duplicates end up
+		// next to each other; a pending Rule is dropped if an earlier
+		// candidate in its run equals it
+		std::size_t rule_count = bucket->rules.size();
+		std::size_t old_size = rule_count + bucket->facts.size();
+		std::size_t candidate_count = old_size + (group_end - group);
+		auto pending = [&](std::size_t i) -> const Rule& { return *group[i - old_size].first; };
+		std::vector<std::pair<std::size_t, std::size_t>> order(candidate_count);
+		for(std::size_t i = 0; i < candidate_count; ++i) {
+		    std::size_t hash = i < rule_count ? head_hash(*bucket->rules[i])
+			: i < old_size ? bucket->facts.hash(i - rule_count) : head_hash(pending(i));
+		    order[i] = {hash, i};
+		}
+		std::sort(order.begin(), order.end());
+		auto equals = [&](std::size_t earlier, const Rule &rule) {
+		    if(earlier < rule_count)
+			return bucket->rules[earlier]->equals(rule);
+		    if(earlier < old_size)
+			return rule.predicates().empty()
+			    && bucket->facts.equals(earlier - rule_count, rule);
+		    return pending(earlier).equals(rule);
+		};
+		std::vector<bool> duplicate(candidate_count, false);
+		for(std::size_t run = 0; run < order.size();) {
+		    std::size_t run_end = run + 1;
+		    while(run_end < order.size() && order[run_end].first == order[run].first)
+			++run_end;
+		    for(std::size_t i = run + 1; i < run_end; ++i) {
+			if(order[i].second < old_size)
+			    continue;
+			const Rule &rule = pending(order[i].second);
+			for(std::size_t j = run; j < i && !duplicate[order[i].second]; ++j) {
+			    duplicate[order[i].second] = !duplicate[order[j].second]
+				&& equals(order[j].second, rule);
+			}
+		    }
+		    run = run_end;
+		}
+		for(std::size_t i = old_size; i < candidate_count; ++i) {
+		    if(duplicate[i])
+			continue;
+		    auto [rule, is_owned] = group[i - old_size];
+		    if(is_owned && !bucket->stores_as_fact(*rule)) {
+			bucket->owned.push_back(std::make_shared<const Rule>(std::move(*rule)));
+			bucket->add(*bucket->owned.back());
+		    } else {
+			bucket->add(*rule);
+		    }
+		    ++added;
+		}
+		group = group_end;
+		slot = std::move(bucket);
+	    }
+	    std::atomic_store(&m_db.m_rules, std::move(table));
+	    m_pending.clear();
+	    m_arena.clear();
+	    return added;
+	}
+    };
+
+    BasicDatabase()
+	: m_rules(std::make_shared<Table>()),
+	  m_symbols(std::make_shared<SymbolTable>()),
+	  m_plans(std::make_shared<PlanCache>())
+    {}
+
+    // Not safe while other threads are querying this Database; use a Batch.
+    // False if the Database is frozen (or named by an enum new_rule's name
+    // isn't one of). Unlike a Batch, keeps duplicates of Rules already in the
+    // Database. new_rule must outlive the Database, which sees later
+    // changes to it, except for a ground fact whose params are all int,
+    // long long, double or Symbol values: that is copied into its
+    // predicate's FactTable, so later changes to it aren't seen
+    bool add_rule(Rule &new_rule)
+    {
+	if(m_is_frozen || !is_valid(key_of(new_rule)))
+	    return false;
+	writable_bucket(key_of(new_rule)).add(new_rule);
+	return true;
+    }
+
+    // Same as above, but the Database keeps the Rule alive
+    bool add_rule(Rule &&new_rule)
+    {
+	if(m_is_frozen || !is_valid(key_of(new_rule)))
+	    return false;
+	Bucket &bucket = writable_bucket(key_of(new_rule));
+	if(bucket.stores_as_fact(new_rule)) {
+	    bucket.add(new_rule);
+	    return true;
+	}
+	bucket.owned.push_back(std::make_shared<const Rule>(std::move(new_rule)));
+	bucket.add(*bucket.owned.back());
+	return true;
+    }
+
+    // Makes this Database read-only for good: every bucket gives back its
+    // spare capacity and keeps its distinct value estimates precomputed,
+    // and predicates are found through a perfect hash instead of by
+    // comparing names (if named by strings). Afterwards add_rule(),
+    // add_index(), load() and Batch::commit() fail, and snapshots are frozen
+    // too. Not safe while other threads are querying this Database
+    void freeze()
+    {
+	if(m_is_frozen)
+	    return;
+	m_plans = std::make_shared<PlanCache>();
+	if(m_rules.use_count() > 1)
+	    m_rules = std::make_shared<Table>(*m_rules);
+	for_each_bucket(*m_rules, [](const Name &, std::shared_ptr<Bucket> &bucket) {
+	    // Snapshots sharing a bucket must still see it as it was
+	    if(bucket.use_count() > 1)
+		bucket = std::make_shared<Bucket>(*bucket);
+	    bucket->freeze();
+	    return false;
+	});
+	if constexpr(!is_enum_named)
+	    m_frozen = std::make_shared<const FrozenTable>(m_rules);
+	m_is_frozen = true;
+    }
+
+    bool is_frozen() const { return m_is_frozen; }
+
+    // Copies the symbols first if a snapshot or copy of this Database still
+    // shares them, so keep the reference no longer than until the next
+    // snapshot()
+    SymbolTable& symbols()
+    {
+	if(m_symbols.use_count() > 1)
+	    m_symbols = std::make_shared<SymbolTable>(*m_symbols);
+	return *m_symbols;
+    }
+
+    const SymbolTable& symbols() const { return *m_symbols; }
+
+    // Parses clauses written in Prolog syntax (see ClauseParser) and adds them
+    // as one Batch; on a syntax error nothing is added, symbols included.
+    // With more than one thread (0 = one per core), the source is split at
+    // clause boundaries and the pieces are parsed concurrently into separate
+    // arenas before being merged in order. Symbols get the same ids whatever
+    // the thread count
+    LoadResult load(std::string_view source, unsigned thread_count = 1)
+    {
+	if(m_is_frozen || is_enum_named) {
+	    // Parsed clauses are named by strings
+	    LoadResult result;
+	    result.error = m_is_frozen ? "database is frozen" : "database is named by an enum";
+	    return result;
+	}
+	if(thread_count == 0)
+	    thread_count = std::max(1u, std::thread::hardware_concurrency());
+	auto pieces = ClauseParser::split(source, thread_count);
+	struct Piece {
+	    std::deque<Rule> rules;
+	    // The piece's symbols, numbered from 0 in order of first use;
+	    // only a load without errors interns them into this Database's
+	    SymbolTable symbols;
+	    std::string error;
+	    std::size_t error_line = 0;
+	};
+	std::vector<Piece> parsed(pieces.size());
+	auto parse_piece = [&](std::size_t i) {
+	    ClauseParser parser{pieces[i], parsed[i].symbols};
+	    auto &arena = parsed[i].rules;
+	    if(!parser.parse([&](Rule &&rule) { arena.push_back(std::move(rule)); })) {
+		parsed[i].error = parser.error();
+		parsed[i].error_line = parser.line();
+	    }
+	};
+	if(pieces.size() == 1) {
+	    parse_piece(0);
+	} else {
+	    std::vector<std::thread> workers;
+	    for(std::size_t i = 0; i < pieces.size(); ++i)
+		workers.emplace_back(parse_piece, i);
+	    for(auto &worker : workers)
+		worker.join();
+	}
+
+	LoadResult result;
+	result.byte_count = source.size();
+	std::size_t line_offset = 0;
+	for(std::size_t i = 0; i < pieces.size(); ++i) {
+	    if(!parsed[i].error.empty()) {
+		result.error = parsed[i].error;
+		result.error_line = line_offset + parsed[i].error_line;
+		return result;
+	    }
+	    line_offset += std::count(pieces[i].begin(), pieces[i].end(), '\n');
+	}
+	// Interning each piece's symbols in the order they were first seen,
+	// piece after piece, gives them the ids one parser would have
+	SymbolTable &table = symbols();
+	for(std::size_t i = 0; i < pieces.size(); ++i) {
+	    const auto &symbols = parsed[i].symbols;
+	    std::vector<Symbol> ids(symbols.size());
+	    bool is_renumbered = false;
+	    for(std::uint32_t id = 0; id < ids.size(); ++id) {
+		ids[id] = table.intern(symbols.name(Symbol{id}));
+		is_renumbered = is_renumbered || ids[id].id != id;
+	    }
+	    if(!is_renumbered)
+		continue;
+	    for(auto &rule : parsed[i].rules) {
+		rule.for_each_param([&](IVariable &param) {
+		    if(typeid(param) == typeid(Variable<Symbol>)) {
+			auto &symbol = static_cast<Variable<Symbol>&>(param);
+			symbol.set_value(ids[symbol.value().id]);
+		    }
+		});
+	    }
+	}
+	auto batch = begin_batch();
+	for(auto &piece : parsed) {
+	    for(auto &rule : piece.rules)
+		batch.add_rule(std::move(rule));
+	    result.clause_count += piece.rules.size();
+	    piece.rules.clear();
+	}
+	batch.commit();
+	return result;
+    }
+
+    // Writes this Database in SnapshotFormat for MappedDatabase. Fails if the
+    // file can't be written or a param isn't an unconstrained int, long long,
+    // double, Symbol or Var
+    bool save(const std::string &path) const
+    {
+	using Format = SnapshotFormat;
+	std::vector<char> out;
+	auto align = [&] { out.resize((out.size() + 7) / 8 * 8); };
+	auto reserve = [&](std::size_t size) {
+	    align();
+	    std::size_t offset = out.size();
+	    out.resize(offset + size);
+	    return offset;
+	};
+	auto write = [&](std::size_t offset, const auto &value) {
+	    std::memcpy(out.data() + offset, &value, sizeof(value));
+	};
+	// data() of an empty vector may be null, which memcpy must never get
+	auto write_all = [&](std::size_t offset, const auto &values) {
+	    if(!values.empty())
+		std::memcpy(out.data() + offset, values.data(), values.size() * sizeof(values[0]));
+	};
+	auto append_string = [&](std::string_view text) {
+	    std::size_t offset = out.size();
+	    out.insert(out.end(), text.begin(), text.end());
+	    return offset;
+	};
+	auto table = current_table();
+
+	Format::Header header{};
+	std::memcpy(header.magic, Format::magic, sizeof(header.magic));
+	header.version = Format::version;
+	header.byte_order_mark = Format::byte_order_mark;
+	reserve(sizeof(header));
+
+	std::vector<Format::SymbolEntry> symbols(m_symbols->size());
+	std::vector<std::uint32_t> sorted_symbols(symbols.size());
+	for(std::uint32_t id = 0; id < symbols.size(); ++id) {
+	    auto name = m_symbols->name(Symbol{id});
+	    symbols[id] = {append_string(name), name.size()};
+	    sorted_symbols[id] = id;
+	}
+	std::sort(sorted_symbols.begin(), sorted_symbols.end(), [&](std::uint32_t a, std::uint32_t b) {
+	    return m_symbols->name(Symbol{a}) < m_symbols->name(Symbol{b});
+	});
+	header.symbol_count = symbols.size();
+	header.symbols_offset = reserve(symbols.size() * sizeof(Format::SymbolEntry));
+	write_all(header.symbols_offset, symbols);
+	header.sorted_symbols_offset = reserve(sorted_symbols.size() * sizeof(std::uint32_t));
+	write_all(header.sorted_symbols_offset, sorted_symbols);
+
+	// Sorted by name, the order MappedDatabase searches them in
+	struct Predicate {
+	    std::string text;
+	    Name name;
+	    const Bucket *bucket;
+	};
+	std::vector<Predicate> predicates;
+	for_each_bucket(*table, [&](const Name &name, const auto &bucket) {
+	    predicates.push_back({name_of(name), name, bucket.get()});
+	    return false;
+	});
+	std::sort(predicates.begin(), predicates.end(),
+		  [](const auto &a, const auto &b) { return a.text < b.text; });
+	std::map<std::string_view, std::uint32_t> predicate_ids;
+	for(const auto &predicate : predicates)
+	    predicate_ids.emplace(predicate.text, static_cast<std::uint32_t>(predicate_ids.size()));
+	header.predicate_count = predicate_ids.size();
+	header.predicates_offset = reserve(predicate_ids.size() * sizeof(Format::PredicateEntry));
+
+	auto write_cells = [&](const RuleVariable &source, std::size_t offset) {
+	    for(std::size_t i = 0; i < source.arity(); ++i) {
+		Format::Cell cell;
+		if(!Format::to_cell(*source[i], cell))
+		    return false;
+		write(offset + i * sizeof(cell), cell);
+	    }
+	    return true;
+	};
+	std::size_t predicate_position = 0;
+	for(const auto &[text, name, bucket] : predicates) {
+	    Format::PredicateEntry entry{};
+	    entry.name_length = text.size();
+	    entry.name_offset = append_string(text);
+	    entry.clause_count = bucket->size();
+	    std::vector<std::uint64_t> clause_offsets;
+	    std::vector<Format::IndexEntry> indexed;
+	    std::vector<std::uint64_t> unindexed;
+	    std::size_t position = 0;
+	    bool failed = bucket->for_each_clause(name, [&](const Rule &rule) {
+		std::size_t clause_offset = reserve(sizeof(Format::ClauseRecord)
+						    + rule.arity() * sizeof(Format::Cell));
+		if(!write_cells(rule, clause_offset + sizeof(Format::ClauseRecord)))
+		    return true;
+		Format::ClauseRecord clause{static_cast<std::uint32_t>(rule.arity()),
+					    static_cast<std::uint32_t>(rule.predicates().size()), 0};
+		clause.goals_offset = reserve(rule.predicates().size() * sizeof(Format::GoalRecord));
+		for(std::size_t i = 0; i < rule.predicates().size(); ++i) {
+		    const auto &goal = rule.predicates()[i];
+		    auto predicate = predicate_ids.find(goal.name());
+		    Format::GoalRecord record{predicate != predicate_ids.end()
+					      ? predicate->second : Format::no_predicate,
+					      static_cast<std::uint32_t>(goal.arity()), 0};
+		    record.cells_offset = reserve(goal.arity() * sizeof(Format::Cell));
+		    if(!write_cells(goal, record.cells_offset))
+			return true;
+		    write(clause.goals_offset + i * sizeof(record), record);
+		}
+		write(clause_offset, clause);
+		clause_offsets.push_back(clause_offset);
+
+		Format::Cell first{};
+		if(rule.arity() > 0)
+		    Format::to_cell(*rule[0], first);
+		if(rule.arity() > 0 && Format::is_indexable(first))
+		    indexed.push_back({Format::hash(first), position});
+		else
+		    unindexed.push_back(position);
+		++position;
+		return false;
+	    });
+	    if(failed)
+		return false;
+	    std::sort(indexed.begin(), indexed.end(), [](const auto &a, const auto &b) {
+		return a.hash < b.hash || (a.hash == b.hash && a.position < b.position);
+	    });
+	    entry.clauses_offset = reserve(clause_offsets.size() * sizeof(std::uint64_t));
+	    write_all(entry.clauses_offset, clause_offsets);
+	    entry.indexed_count = indexed.size();
+	    entry.indexed_offset = reserve(indexed.size() * sizeof(Format::IndexEntry));
+	    write_all(entry.indexed_offset, indexed);
+	    entry.unindexed_count = unindexed.size();
+	    entry.unindexed_offset = reserve(unindexed.size() * sizeof(std::uint64_t));
+	    write_all(entry.unindexed_offset, unindexed);
+	    write(header.predicates_offset + predicate_position++ * sizeof(entry), entry);
+	}
+	write(0, header);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(out.data(), static_cast<std::streamsize>(out.size()));
+	return static_cast<bool>(file);
+    }
+
+    LoadResult load_file(const std::string &path, unsigned thread_count = 1)
+    {
+	MappedFile file{path};
+	if(!file.is_open()) {
+	    LoadResult result;
+	    result.error = "could not open " + path;
+	    return result;
+	}
+	return load(file.contents(), thread_count);
+    }
+
+    Batch begin_batch() { return Batch(*this); }
+
+    // Calls visit(rule) on every clause, grouped by name. Facts stored in
+    // columns are passed as temporary Rules
+    template<typename Visitor>
+    void for_each_rule(Visitor visit) const
+    {
+	auto table = current_table();
+	for_each_bucket(*table, [&](const Name &name, const auto &bucket) {
+	    return bucket->for_each_clause(name, [&](const Rule &rule) {
+		visit(rule);
+		return false;
+	    });
+	});
+    }
+
+    // O(1); the snapshot and this Database can then diverge independently
+    // (the first to intern a new symbol copies the SymbolTable). Versions
+    // are freed once no Database refers to them
+    BasicDatabase snapshot() const
+    {
+	BasicDatabase result{*this};
+	result.m_rules = std::atomic_load(&m_rules);
+	result.m_plans = std::make_shared<PlanCache>();
+	return result;
+    }
+
+    bool query(const RuleVariable &conjecture) const
+    {
+	if constexpr(!is_enum_named) {
+	    if(m_frozen)
+		return query(*m_frozen, *plans_for(m_frozen), conjecture);
+	}
+	// Nothing writes m_rules anymore once frozen
+	if(m_is_frozen)
+	    return query(*m_rules, *plans_for(m_rules), conjecture);
+	auto table = current_table();
+	return query(*table, *plans_for(table), conjecture);
+    }
+
+    template<typename ...Args>
+    bool query(Name name, Args... args) const
+    {
+        return query(RuleVariable{name, args...});
+    }
+
+    // Calls visit(solution) for each solution of conjecture until it returns
+    // true, and returns whether there was one. Unlike query(), this proves
+    // conjecture with Prolog's semantics: a variable bound by one goal is
+    // bound in the goals after it, and unbound variables unify with each
+    // other. solution is conjecture with each Var and Type<> that got a
+    // value replaced by it. Any number of threads can call this at once
+    template<typename Visitor>
+    bool for_each_solution(const RuleVariable &conjecture, Visitor visit) const
+    {
+	if constexpr(!is_enum_named) {
+	    if(m_frozen)
+		return Resolution<FrozenTable>{*m_frozen}.solve(conjecture, visit);
+	}
+	if(m_is_frozen)
+	    return Resolution<Table>{*m_rules}.solve(conjecture, visit);
+	auto table = current_table();
+	return Resolution<Table>{*table}.solve(conjecture, visit);
+    }
+
+    // Keeps name's facts sorted on the param at position too, so that ground
+    // lookups on it and comparison constraints (Variable::constrain_less()
+    // and constrain_greater()) are answered from a B-tree instead of a scan.
+    // False if name's facts have fewer params or the Database is frozen.
+    // Not safe while other threads are querying this Database
+    bool add_index(const Name &name, std::size_t position)
+    {
+	return !m_is_frozen && is_valid(key_of(name))
+	    && writable_bucket(key_of(name)).facts.index_column(position);
+    }
+
+    // Statistics of the filter over name's ground facts (all zero if there
+    // are none)
+    FactTable::FilterStats filter_stats(const Name &name) const
+    {
+	auto table = current_table();
+	const Bucket *bucket = find_bucket(*table, key_of(name));
+	return bucket ? bucket->facts.filter_stats() : FactTable::FilterStats{};
+    }
+
+    // Lists each Rule that conjecture unifies with and the order query()
+    // would prove its predicates in, with the estimated number of matching
+    // clauses for each
+    std::string explain(const RuleVariable &conjecture) const
+    {
+	auto table = current_table();
+	const Bucket *found = find_bucket(*table, key_of(conjecture));
+	if(!found)
+	    return describe(conjecture) + ": no such fact or rule\n";
+	std::ostringstream out;
+	const Bucket &bucket = *found;
+	std::size_t fact = bucket.facts.next_match(conjecture);
+	auto describe_facts = [&](std::size_t end) {
+	    for(; fact < end; fact = bucket.facts.next_match(conjecture, fact + 1)) {
+		out << describe(conjecture) << " matches "
+		    << describe(bucket.facts.to_rule(conjecture.name(), fact)) << '\n';
+	    }
+	};
+	bucket.visit_candidates(conjecture, [&](std::size_t position, const Rule &rule) {
+	    if(!conjecture.can_unify(rule))
+		return false;
+	    describe_facts(bucket.facts_before[position]);
+	    out << describe(conjecture) << " matches " << describe(rule);
+	    if(rule.keeps_order())
+		out << " (order kept)";
+	    out << '\n';
+	    std::vector<double> estimates;
+	    auto order = plan(*table, rule, conjecture, &estimates);
+	    for(std::size_t i = 0; i < order.size(); ++i) {
+		const auto &goal = rule.predicates()[order[i]];
+		const Bucket *called = find_bucket(*table, key_of(goal));
+		out << "  " << i + 1 << ". " << describe(goal) << "  ~" << estimates[i] << " of "
+		    << (called ? called->size() : 0) << " clauses\n";
+	    }
+	    return false;
+	});
+	describe_facts(bucket.facts.size());
+	return out.str();
+    }
+};
+
+using Database = BasicDatabase<>;
+
+
+// Rules over Relations, written as expression templates and compiled into
+// nested loops at compile time, e.g.
+//     constexpr Placeholder<0, int> x;
+//     auto b = (B(x) <<= F(x) && G(x));
+//     b.query(3);
+// Goals are tried left to right. Which variables each goal finds bound is
+// known at compile time, so a bound variable becomes a lookup key and an
+// unbound one a Type<> that the matching facts bind. goal() calls a
+// predicate of a runtime Database from such a rule
+
+// A variable of a compiled rule: N tells a rule's variables apart (N < 64)
+// and T is the type of value it stands for
+template<std::size_t N, typename T>
+struct Placeholder {
+    static_assert(N < 64, "a compiled rule has at most 64 variables");
+    static constexpr std::size_t slot = N;
+    using type = T;
+};
+
+template<typename T>
+struct is_placeholder : std::false_type {};
+
+template<std::size_t N, typename T>
+struct is_placeholder<Placeholder<N, T>> : std::true_type {};
+
+namespace compiled {
+    template<typename T>
+    struct is_type : std::false_type {};
+
+    template<typename T>
+    struct is_type<Type<T>> : std::true_type {};
+
+    template<typename Arg>
+    constexpr std::uint64_t mask_of()
+    {
+	if constexpr(is_placeholder<Arg>::value)
+	    return std::uint64_t{1} << Arg::slot;
+	else
+	    return 0;
+    }
+
+    template<typename ...Args>
+    constexpr std::uint64_t mask_of_all() { return (mask_of<Args>() | ... | 0); }
+
+    // Whether position I of Args is the first to use its variable among the
+    // positions in Counted
+    template<std::size_t I, std::uint64_t Counted, typename ...Args>
+    constexpr bool is_first_use()
+    {
+	constexpr std::uint64_t masks[] = {mask_of<Args>()..., 0};
+	for(std::size_t j = 0; j < I; ++j) {
+	    if((Counted >> j & 1) && masks[j] == masks[I])
+		return false;
+	}
+	return true;
+    }
+
+    // The type of variable N: that of its first Placeholder among Ps
+    template<std::size_t N, typename ...Ps>
+    struct slot_type {
+	using type = std::monostate;
+    };
+
+    template<std::size_t N, typename P, typename ...Ps>
+    struct slot_type<N, P, Ps...> : slot_type<N, Ps...> {};
+
+    template<std::size_t N, typename T, typename ...Ps>
+    struct slot_type<N, Placeholder<N, T>, Ps...> {
+	using type = T;
+    };
+
+    // Values of a rule's variables, by N
+    template<typename Indexes, typename ...Ps>
+    struct Environment;
+
+    template<std::size_t ...N, typename ...Ps>
+    struct Environment<std::index_sequence<N...>, Ps...> {
+	using type = std::tuple<typename slot_type<N, Ps...>::type...>;
+    };
+
+    template<typename ...Ps>
+    constexpr std::size_t slot_count()
+    {
+	std::uint64_t mask = mask_of_all<Ps...>();
+	std::size_t count = 0;
+	for(; mask != 0; mask >>= 1)
+	    ++count;
+	return count;
+    }
+}
+
+// R(args...) in a compiled rule, where each arg is a value or a Placeholder
+template<typename Rel, typename ...Args>
+struct RelationGoal {
+    const Rel *relation;
+    std::tuple<Args...> args;
+
+    static constexpr std::uint64_t binds = compiled::mask_of_all<Args...>();
+
+    // What Relation::for_each_match gets for param I
+    template<std::uint64_t Bound, std::size_t I, typename Env>
+    decltype(auto) key(const Env &env) const
+    {
+	using Arg = std::tuple_element_t<I, std::tuple<Args...>>;
+	using Param = std::tuple_element_t<I, typename Rel::Tuple>;
+	if constexpr(!is_placeholder<Arg>::value) {
+	    return (std::get<I>(args));
+	} else {
+	    static_assert(std::is_same_v<typename Arg::type, Param>,
+			  "a variable's type must match the params it is passed to");
+	    if constexpr((Bound & compiled::mask_of<Arg>()) != 0)
+		return (std::get<Arg::slot>(env));
+	    else
+		return Type<Param>();
+	}
+    }
+
+    // Binds param I's variable to value if it wasn't bound before this
+    // goal; false if the variable was bound earlier in this goal to a
+    // different value
+    template<std::uint64_t Bound, std::size_t I, typename Env, typename T>
+    static bool bind(Env &env, const T &value)
+    {
+	using Arg = std::tuple_element_t<I, std::tuple<Args...>>;
+	if constexpr(!is_placeholder<Arg>::value || (Bound & compiled::mask_of<Arg>()) != 0) {
+	    return true;
+	} else if constexpr(compiled::is_first_use<I, ~std::uint64_t{0}, Args...>()) {
+	    std::get<Arg::slot>(env) = value;
+	    return true;
+	} else {
+	    return std::get<Arg::slot>(env) == value;
+	}
+    }
+
+    // Calls next() for each matching fact, with the variables it binds set
+    // in env, until next returns true
+    template<std::uint64_t Bound, typename Env, typename Next, std::size_t ...I>
+    bool solve(Env &env, const Next &next, std::index_sequence<I...>) const
+    {
+	return relation->for_each_match([&](const typename Rel::Tuple &fact) {
+	    return (bind<Bound, I>(env, std::get<I>(fact)) && ...) && next();
+	}, key<Bound, I>(env)...);
+    }
+
+    template<std::uint64_t Bound, typename Env, typename Next>
+    bool solve(Env &env, const Next &next) const
+    {
+	return solve<Bound>(env, next, std::index_sequence_for<Args...>{});
+    }
+};
+
+// A call to a runtime Database's predicate from a compiled rule. The
+// Database doesn't report bindings, so this binds no variables; unbound
+// ones are passed as Type<>s
+template<typename Name, typename ...Args>
+struct DatabaseGoal {
+    const BasicDatabase<Name> *db;
+    Name name;
+    std::tuple<Args...> args;
+
+    static constexpr std::uint64_t binds = 0;
+
+    template<std::uint64_t Bound, typename Env, typename Next, std::size_t ...I>
+    bool solve(Env &env, const Next &next, std::index_sequence<I...>) const
+    {
+	RuleVariable conjecture{name};
+	auto add = [&](const auto &arg) {
+	    using Arg = std::decay_t<decltype(arg)>;
+	    if constexpr(!is_placeholder<Arg>::value)
+		conjecture.add_param(arg);
+	    else if constexpr((Bound & compiled::mask_of<Arg>()) != 0)
+		conjecture.add_param(std::get<Arg::slot>(env));
+	    else
+		conjecture.add_param(Type<typename Arg::type>());
+	};
+	(add(std::get<I>(args)), ...);
+	return db->query(conjecture) && next();
+    }
+
+    template<std::uint64_t Bound, typename Env, typename Next>
+    bool solve(Env &env, const Next &next) const
+    {
+	return solve<Bound>(env, next, std::index_sequence_for<Args...>{});
+    }
+};
+
+template<typename Name, typename ...Args>
+DatabaseGoal<Name, Args...>
+goal(const BasicDatabase<Name> &db, const typename BasicDatabase<Name>::name_type &name,
+     const Args &...args)
+{
+    return {&db, name, {args...}};
+}
+
+template<typename ...Goals>
+struct Conjunction {
+    std::tuple<Goals...> goals;
+};
+
+template<typename T>
+struct is_goal : std::false_type {};
+
+template<typename Rel, typename ...Args>
+struct is_goal<RelationGoal<Rel, Args...>> : std::true_type {};
+
+template<typename Name, typename ...Args>
+struct is_goal<DatabaseGoal<Name, Args...>> : std::true_type {};
+
+template<typename T>
+struct is_conjunction : std::false_type {};
+
+template<typename ...Goals>
+struct is_conjunction<Conjunction<Goals...>> : std::true_type {};
+
+template<typename Goal>
+std::tuple<Goal> goals_of(const Goal &goal) { return {goal}; }
+
+template<typename ...Goals>
+const std::tuple<Goals...>& goals_of(const Conjunction<Goals...> &body) { return body.goals; }
+
+template<typename L, typename R,
+	 typename = std::enable_if_t<(is_goal<L>::value || is_conjunction<L>::value)
+				     && (is_goal<R>::value || is_conjunction<R>::value)>>
+auto operator&&(const L &left, const R &right)
+{
+    auto goals = std::tuple_cat(goals_of(left), goals_of(right));
+    return std::apply([](const auto &...each) {
+	return Conjunction<std::decay_t<decltype(each)>...>{{each...}};
+    }, goals);
+}
+
+template<typename Head, typename ...Goals>
+class CompiledRule;
+
+template<typename Rel, typename ...HeadArgs, typename ...Goals>
+class CompiledRule<RelationGoal<Rel, HeadArgs...>, Goals...> {
+private:
+    using Head = RelationGoal<Rel, HeadArgs...>;
+    Head m_head;
+    std::tuple<Goals...> m_goals;
+
+    template<typename Goal>
+    struct args_of;
+
+    template<typename GoalRel, typename ...Args>
+    struct args_of<RelationGoal<GoalRel, Args...>> {
+	template<template<typename...> class List, typename ...Before>
+	using append = List<Before..., Args...>;
+    };
+
+    template<typename Name, typename ...Args>
+    struct args_of<DatabaseGoal<Name, Args...>> {
+	template<template<typename...> class List, typename ...Before>
+	using append = List<Before..., Args...>;
+    };
+
+    // Every variable and value of the head and the body, in order
+    template<typename ...Ts>
+    struct TermList {
+	template<typename Goal>
+	using with = typename args_of<Goal>::template append<TermList, Ts...>;
+
+	using Env = typename compiled::Environment<
+	    std::make_index_sequence<compiled::slot_count<Ts...>()>, Ts...>::type;
+    };
+
+    template<typename List, typename ...Rest>
+    struct collect {
+	using type = List;
+    };
+
+    template<typename List, typename Goal, typename ...Rest>
+    struct collect<List, Goal, Rest...> {
+	using type = typename collect<typename List::template with<Goal>, Rest...>::type;
+    };
+
+    using Env = typename collect<TermList<HeadArgs...>, Goals...>::type::Env;
+
+    static constexpr std::uint64_t body_binds = (Goals::binds | ... | 0);
+
+    template<std::size_t K, std::uint64_t Bound, typename Visit>
+    bool search(Env &env, const Visit &visit) const
+    {
+	if constexpr(K == sizeof...(Goals)) {
+	    return visit(env);
+	} else {
+	    using Goal = std::tuple_element_t<K, std::tuple<Goals...>>;
+	    return std::get<K>(m_goals).template solve<Bound>(env, [&] {
+		return search<K + 1, Bound | Goal::binds>(env, visit);
+	    });
+	}
+    }
+
+    // Which head params a query gives values for
+    template<typename ...Args>
+    static constexpr std::uint64_t given()
+    {
+	constexpr bool is_given[] = {!compiled::is_type<Args>::value..., false};
+	std::uint64_t result = 0;
+	for(std::size_t i = 0; i < sizeof...(Args); ++i)
+	    result |= std::uint64_t{is_given[i]} << i;
+	return result;
+    }
+
+    // Binds the head's variables to a query's values, and checks its values
+    template<std::uint64_t Given, std::size_t ...I, typename ...Args>
+    bool bind_head(Env &env, std::index_sequence<I...>, const Args &...args) const
+    {
+	auto bind = [&](auto index, const auto &arg) {
+	    constexpr std::size_t i = decltype(index)::value;
+	    using HeadArg = std::tuple_element_t<i, std::tuple<HeadArgs...>>;
+	    using Param = std::tuple_element_t<i, typename Rel::Tuple>;
+	    using Arg = std::decay_t<decltype(arg)>;
+	    if constexpr(std::is_same_v<Arg, Type<Param>>) {
+		return true;
+	    } else {
+		static_assert(std::is_same_v<Arg, Param>,
+			      "each argument must have its param's type, or be a Type<> of it");
+		if constexpr(!is_placeholder<HeadArg>::value) {
+		    return std::get<i>(m_head.args) == arg;
+		} else if constexpr(compiled::is_first_use<i, Given, HeadArgs...>()) {
+		    std::get<HeadArg::slot>(env) = arg;
+		    return true;
+		} else {
+		    return std::get<HeadArg::slot>(env) == arg;
+		}
+	    }
+	};
+	return (bind(std::integral_constant<std::size_t, I>{}, args) && ...);
+    }
+
+    template<std::uint64_t Given, typename ...Args>
+    static constexpr std::uint64_t bound_by()
+    {
+	constexpr std::uint64_t masks[] = {compiled::mask_of<HeadArgs>()..., 0};
+	std::uint64_t result = 0;
+	for(std::size_t i = 0; i < sizeof...(HeadArgs); ++i) {
+	    if(Given >> i & 1)
+		result |= masks[i];
+	}
+	return result;
+    }
+public:
+    CompiledRule(const Head &head, const std::tuple<Goals...> &goals)
+	: m_head(head), m_goals(goals)
+    {}
+
+    // One argument per head param: a value of its type, or a Type<> of it
+    // to leave it open. True if the body can be proven
+    template<typename ...Args>
+    bool query(const Args &...args) const
+    {
+	static_assert(sizeof...(Args) == sizeof...(HeadArgs), "one argument per param");
+	constexpr std::uint64_t given_params = given<Args...>();
+	Env env{};
+	if(!bind_head<given_params>(env, std::index_sequence_for<Args...>{}, args...))
+	    return false;
+	return search<0, bound_by<given_params, Args...>()>(env, [](const Env&) { return true; });
+    }
+
+    // Calls visit(head) for the head of every solution of the body, until
+    // visit returns true. Every variable of the head must occur in the body
+    template<typename Visitor>
+    bool for_each_solution(Visitor visit) const
+    {
+	static_assert((compiled::mask_of_all<HeadArgs...>() & ~body_binds) == 0,
+		      "every variable of the head must be bound by a goal on a Relation");
+	Env env{};
+	return search<0, 0>(env, [&](const Env &solved) {
+	    return std::apply([&](const auto &...arg) {
+		auto value = [&](const auto &each) -> decltype(auto) {
+		    using Arg = std::decay_t<decltype(each)>;
+		    if constexpr(is_placeholder<Arg>::value)
+			return (std::get<Arg::slot>(solved));
+		    else
+			return (each);
+		};
+		return visit(typename Rel::Tuple{value(arg)...});
+	    }, m_head.args);
+	});
+    }
+};
+
+template<typename Rel, typename ...HeadArgs, typename Body,
+	 typename = std::enable_if_t<is_goal<Body>::value || is_conjunction<Body>::value>>
+auto operator<<=(const RelationGoal<Rel, HeadArgs...> &head, const Body &body)
+{
+    return std::apply([&](const auto &...goals) {
+	return CompiledRule<RelationGoal<Rel, HeadArgs...>, std::decay_t<decltype(goals)>...>{
+	    head, {goals...}};
+    }, goals_of(body));
+}
+
+
+// Evaluates the Rules of a Database bottom-up: starting from the facts, every
+// rule is applied until nothing new can be derived. Evaluation is semi-naive,
+// so after the first round each rule is only joined against the tuples the
+// round before it derived. Only Datalog is supported: facts must be ground
+// and every variable in the head of a rule must appear in its body. Facts
+// are copied, but rules point at values owned by the Database's Rules, so
+// the Database must outlive the engine
+class FixpointEngine {
+public:
+    struct Term {
+	// A Pattern is an unbound Variable<T> (e.g. from Type<T>()), which
+	// matches any value it can unify with
+	enum class Kind { Variable, Constant, Pattern } kind;
+	std::size_t slot;
+	const IVariable *value;
+    };
+
+    struct Atom {
+	std::string name;
+	std::vector<Term> args;
+    };
+
+    struct Clause {
+	Atom head;
+	std::vector<Atom> body;
+	std::size_t slot_count;
+    };
+private:
+    // A set of tuples stored row after row, with hash indexes on the
+    // combinations of bound columns that joins have asked for
+    struct Relation {
+	using Index = std::unordered_map<std::size_t, std::vector<std::size_t>>;
+	std::size_t arity = 0;
+	std::size_t row_count = 0;
+	std::vector<const IVariable*> cells;
+	// Rows [stable, limit) are the ones derived in the previous round;
+	// rows past limit were derived in this one
+	std::size_t stable = 0;
+	std::size_t limit = 0;
+	// Keyed by a bitmask of columns; all columns is used to deduplicate
+	std::map<std::uint64_t, Index> indexes;
+
+	const IVariable* const* row(std::size_t position) const
+	{
+	    return cells.data() + position * arity;
+	}
+
+	std::uint64_t all_columns() const { return arity >= 64 ? ~0ull : (1ull << arity) - 1; }
+
+	// values holds one entry per column, but only the masked ones are read
+	static std::size_t hash(const IVariable* const *values, std::uint64_t mask, std::size_t arity)
+	{
+	    std::size_t result = 0;
+	    for(std::size_t i = 0; i < arity; ++i) {
+		if(mask & (1ull << i))
+		    result = result * 31 + values[i]->hash();
+	    }
+	    return result;
+	}
+
+	Index& index(std::uint64_t mask)
+	{
+	    auto match = indexes.find(mask);
+	    if(match != indexes.end())
+		return match->second;
+	    Index &index = indexes[mask];
+	    for(std::size_t i = 0; i < row_count; ++i)
+		index[hash(row(i), mask, arity)].push_back(i);
+	    return index;
+	}
+
+	// Positions of rows that may equal values in the masked columns, ascending
+	const std::vector<std::size_t>& lookup(std::uint64_t mask, const IVariable* const *values)
+	{
+	    static const std::vector<std::size_t> none;
+	    auto &rows = index(mask);
+	    auto match = rows.find(hash(values, mask, arity));
+	    return match != rows.end() ? match->second : none;
+	}
+
+	bool contains(const IVariable* const *values)
+	{
+	    for(std::size_t position : lookup(all_columns(), values)) {
+		if(std::equal(values, values + arity, row(position),
+			      [](const IVariable *a, const IVariable *b) { return a->equals(*b); }))
+		    return true;
+	    }
+	    return false;
+	}
+
+	bool insert(const IVariable* const *values)
+	{
+	    if(contains(values))
+		return false;
+	    cells.insert(cells.end(), values, values + arity);
+	    for(auto &[mask, index] : indexes)
+		index[hash(values, mask, arity)].push_back(row_count);
+	    ++row_count;
+	    return true;
+	}
+    };
+
+    // A call of rewrite_for(): the queried name, which of its arguments
+    // were bound, and their values
+    struct Seed {
+	std::string name;
+	std::string adornment;
+	std::vector<const IVariable*> values;
+    };
+
+    std::vector<Clause> m_clauses;
+    // The clauses load() found, which every rewrite_for() starts from, and
+    // the names they derive
+    std::vector<Clause> m_loaded;
+    std::set<std::string> m_derived;
+    std::map<std::string, Relation> m_relations;
+    std::vector<Seed> m_seeds;
+    // The (name, adornment) pairs whose adorned clauses are in m_clauses
+    std::set<std::pair<std::string, std::string>> m_adorned;
+    // Copies of the query constants rewrite_for() seeds magic facts with
+    std::vector<std::unique_ptr<IVariable>> m_owned_values;
+    // m_loaded evaluated in full, for goals that no seed covers; made on
+    // first use
+    mutable std::unique_ptr<FixpointEngine> m_full;
+    std::size_t m_round_count = 0;
+public:
+    // How rule bodies are joined; Automatic uses leapfrog triejoin for
+    // cyclic bodies of three or more predicates, nested loops otherwise
+    enum class JoinStrategy { Automatic, NestedLoop, Leapfrog };
+private:
+    JoinStrategy m_join_strategy = JoinStrategy::Automatic;
+
+    static Term to_term(const IVariable &param)
+    {
+	if(auto *variable = dynamic_cast<const LogicVariable*>(&param))
+	    return {Term::Kind::Variable, variable->slot(), nullptr};
+	if(param.is_unified())
+	    return {Term::Kind::Constant, 0, &param};
+	return {Term::Kind::Pattern, 0, &param};
+    }
+
+    static Atom to_atom(const RuleVariable &source, std::size_t &slot_count)
+    {
+	Atom atom{source.name(), {}};
+	for(std::size_t i = 0; i < source.arity(); ++i) {
+	    atom.args.push_back(to_term(*source[i]));
+	    if(atom.args.back().kind == Term::Kind::Variable)
+		slot_count = std::max(slot_count, atom.args.back().slot + 1);
+	}
+	return atom;
+    }
+
+    Relation& relation(const std::string &name, std::size_t arity)
+    {
+	auto &result = m_relations[name];
+	result.arity = arity;
+	return result;
+    }
+
+    template<typename Emit>
+    void join(const Clause &clause, std::size_t position, std::size_t delta_position,
+	      std::vector<const IVariable*> &slots, Emit &emit)
+    {
+	if(position == clause.body.size()) {
+	    emit();
+	    return;
+	}
+	const Atom &atom = clause.body[position];
+	auto match = m_relations.find(atom.name);
+	if(match == m_relations.end() || match->second.arity != atom.args.size())
+	    return;
+	Relation &relation = match->second;
+	std::size_t first = position == delta_position ? relation.stable : 0;
+	std::size_t last = relation.limit;
+
+	std::uint64_t mask = 0;
+	std::vector<const IVariable*> probe(atom.args.size(), nullptr);
+	for(std::size_t i = 0; i < atom.args.size(); ++i) {
+	    const Term &term = atom.args[i];
+	    if(term.kind == Term::Kind::Constant)
+		probe[i] = term.value;
+	    else if(term.kind == Term::Kind::Variable)
+		probe[i] = slots[term.slot];
+	    if(probe[i])
+		mask |= 1ull << i;
+	}
+
+	auto try_row = [&](std::size_t row_position) {
+	    auto *row = relation.row(row_position);
+	    std::size_t bound_count = 0;
+	    std::size_t bound_here[64];
+	    bool matches = true;
+	    for(std::size_t i = 0; i < atom.args.size() && matches; ++i) {
+		const Term &term = atom.args[i];
+		if(probe[i]) {
+		    matches = probe[i]->equals(*row[i]);
+		} else if(term.kind == Term::Kind::Pattern) {
+		    matches = term.value->can_unify(*row[i]);
+		} else if(slots[term.slot]) {
+		    // Repeated variable, bound earlier in this same row
+		    matches = slots[term.slot]->equals(*row[i]);
+		} else {
+		    slots[term.slot] = row[i];
+		    bound_here[bound_count++] = term.slot;
+		}
+	    }
+	    if(matches)
+		join(clause, position + 1, delta_position, slots, emit);
+	    for(std::size_t i = 0; i < bound_count; ++i)
+		slots[bound_here[i]] = nullptr;
+	};
+
+	if(mask == 0) {
+	    for(std::size_t i = first; i < last; ++i)
+		try_row(i);
+	} else {
+	    // Indexed by position, since rows derived meanwhile can grow the vector
+	    const auto &rows = relation.lookup(mask, probe.data());
+	    std::size_t i = std::lower_bound(rows.begin(), rows.end(), first) - rows.begin();
+	    for(; i < rows.size() && rows[i] < last; ++i)
+		try_row(rows[i]);
+	}
+    }
+
+    // Body atoms sharing variables in a cycle (like the triangle
+    // E(a,b), E(b,c), E(a,c)) defeat pairwise joins. GYO reduction: drop
+    // variables used by only one atom and atoms covered by another atom;
+    // the body is acyclic iff at most one atom is left
+    static bool is_cyclic(const Clause &clause)
+    {
+	std::vector<std::set<std::size_t>> edges;
+	for(const auto &atom : clause.body) {
+	    std::set<std::size_t> variables;
+	    for(const auto &term : atom.args) {
+		if(term.kind == Term::Kind::Variable)
+		    variables.insert(term.slot);
+	    }
+	    edges.push_back(std::move(variables));
+	}
+	bool changed = true;
+	while(changed && edges.size() > 1) {
+	    changed = false;
+	    for(auto &edge : edges) {
+		for(auto variable = edge.begin(); variable != edge.end();) {
+		    auto users = std::count_if(edges.begin(), edges.end(), [&](const auto &other) {
+			return other.count(*variable) > 0;
+		    });
+		    if(users == 1) {
+			variable = edge.erase(variable);
+			changed = true;
+		    } else {
+			++variable;
+		    }
+		}
+	    }
+	    for(std::size_t i = 0; i < edges.size(); ++i) {
+		for(std::size_t j = 0; j < edges.size(); ++j) {
+		    if(i != j && std::includes(edges[j].begin(), edges[j].end(),
+					       edges[i].begin(), edges[i].end())) {
+			edges.erase(edges.begin() + i);
+			changed = true;
+			i = edges.size();
+			break;
+		    }
+		}
+	    }
+	}
+	return edges.size() > 1;
+    }
+
+    bool uses_leapfrog(const Clause &clause) const
+    {
+	switch(m_join_strategy) {
+	case JoinStrategy::NestedLoop:
+	    return false;
+	case JoinStrategy::Leapfrog:
+	    return clause.body.size() > 1;
+	default:
+	    return clause.body.size() > 2 && is_cyclic(clause);
+	}
+    }
+
+    static int compare_rows(const IVariable* const *a, const IVariable* const *b, std::size_t width)
+    {
+	for(std::size_t i = 0; i < width; ++i) {
+	    if(int order = a[i]->compare(*b[i]))
+		return order;
+	}
+	return 0;
+    }
+
+    // The rows of one body atom, projected onto its variables (in the join's
+    // variable order), sorted and deduplicated. A sorted array is the trie:
+    // the children of a prefix are the contiguous rows sharing it
+    struct Trie {
+	std::size_t width = 0;
+	std::size_t row_count = 0;
+	std::vector<const IVariable*> cells;
+
+	const IVariable* at(std::size_t row, std::size_t column) const
+	{
+	    return cells[row * width + column];
+	}
+    };
+
+    // Walks a Trie one variable (depth) at a time; at each depth it points at
+    // one key among the rows that share the keys chosen above it
+    class TrieIterator {
+    private:
+	const Trie *m_trie;
+	std::size_t m_depth = 0;
+	// Per depth, the row range sharing the parent prefix and the position
+	std::vector<std::size_t> m_end, m_position;
+
+	// First row in [from, m_end) whose key at this depth is not less than
+	// key (or, if after_equal, greater than key)
+	std::size_t search(std::size_t from, const IVariable &key, bool after_equal) const
+	{
+	    std::size_t column = m_depth - 1;
+	    std::size_t low = from, high = m_end[column];
+	    while(low < high) {
+		std::size_t middle = low + (high - low) / 2;
+		int order = m_trie->at(middle, column)->compare(key);
+		if(order < 0 || (after_equal && order == 0))
+		    low = middle + 1;
+		else
+		    high = middle;
+	    }
+	    return low;
+	}
+    public:
+	explicit TrieIterator(const Trie &trie)
+	    : m_trie(&trie), m_end(trie.width + 1), m_position(trie.width + 1)
+	{
+	    m_end[0] = trie.row_count;
+	}
+
+	void open()
+	{
+	    std::size_t start = m_depth == 0 ? 0 : m_position[m_depth - 1];
+	    std::size_t end = m_depth == 0 ? m_trie->row_count
+		: search(start, *key(), true);
+	    ++m_depth;
+	    m_position[m_depth - 1] = start;
+	    m_end[m_depth - 1] = end;
+	}
+
+	void up() { --m_depth; }
+
+	bool at_end() const { return m_position[m_depth - 1] >= m_end[m_depth - 1]; }
+
+	const IVariable* key() const { return m_trie->at(m_position[m_depth - 1], m_depth - 1); }
+
+	void next() { m_position[m_depth - 1] = search(m_position[m_depth - 1], *key(), true); }
+
+	void seek(const IVariable &target)
+	{
+	    m_position[m_depth - 1] = search(m_position[m_depth - 1], target, false);
+	}
+    };
+
+    // A Trie leapfrog_join() built for a body atom over its relation's rows
+    // [first, last). Rows are only ever appended, so it stays valid until
+    // the round's range changes, and each is built at most once per round
+    struct CachedTrie {
+	std::size_t first = 0;
+	std::size_t last = 0;
+	bool is_built = false;
+	// False if a value couldn't be ordered
+	bool is_ordered = true;
+	Trie trie;
+    };
+    // Keyed by body atom and by whether the trie holds only its delta rows;
+    // cleared by evaluate(), since the atoms belong to m_clauses
+    std::map<std::pair<const Atom*, bool>, CachedTrie> m_tries;
+
+    // Builds the Trie for atom over rows [first, last), keeping only rows
+    // that match its constants, patterns and repeated variables. Returns
+    // false if a value can't be ordered
+    static bool build_trie(const Atom &atom, const Relation &relation, std::size_t first,
+			   std::size_t last, const std::vector<std::size_t> &variables, Trie &trie)
+    {
+	// Column of atom holding each of variables
+	std::vector<std::size_t> columns;
+	for(std::size_t variable : variables) {
+	    for(std::size_t i = 0; i < atom.args.size(); ++i) {
+		if(atom.args[i].kind == Term::Kind::Variable && atom.args[i].slot == variable) {
+		    columns.push_back(i);
+		    break;
+		}
+	    }
+	}
+	trie.width = columns.size();
+	std::vector<const IVariable*> cells;
+	for(std::size_t position = first; position < last; ++position) {
+	    auto *row = relation.row(position);
+	    bool matches = true;
+	    for(std::size_t i = 0; i < atom.args.size() && matches; ++i) {
+		const Term &term = atom.args[i];
+		if(term.kind == Term::Kind::Constant)
+		    matches = term.value->equals(*row[i]);
+		else if(term.kind == Term::Kind::Pattern)
+		    matches = term.value->can_unify(*row[i]);
+		else
+		    matches = row[i]->equals(*row[columns[std::find(variables.begin(), variables.end(),
+								    term.slot) - variables.begin()]]);
+	    }
+	    if(!matches)
+		continue;
+	    for(std::size_t column : columns) {
+		if(!row[column]->is_ordered())
+		    return false;
+		cells.push_back(row[column]);
+	    }
+	}
+	std::size_t width = trie.width;
+	std::size_t row_count = cells.size() / width;
+	std::vector<std::size_t> order(row_count);
+	for(std::size_t i = 0; i < row_count; ++i)
+	    order[i] = i;
+	std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+	    return compare_rows(&cells[a * width], &cells[b * width], trie.width) < 0;
+	});
+	for(std::size_t i = 0; i < row_count; ++i) {
+	    if(i > 0 && compare_rows(&cells[order[i] * width], &cells[order[i - 1] * width],
+				     trie.width) == 0)
+		continue;
+	    trie.cells.insert(trie.cells.end(), &cells[order[i] * width],
+			      &cells[order[i] * width] + trie.width);
+	    ++trie.row_count;
+	}
+	return true;
+    }
+
+    // Leapfrog triejoin: binds one variable at a time to the keys that every
+    // atom using it agrees on, seeking each atom's trie past the others'
+    // keys instead of enumerating pairs. Returns false (having emitted
+    // nothing) if some value can't be ordered
+    template<typename Emit>
+    bool leapfrog_join(const Clause &clause, std::size_t delta_position,
+		       std::vector<const IVariable*> &slots, Emit &emit)
+    {
+	// Join variables, most shared first
+	std::map<std::size_t, std::size_t> uses;
+	std::vector<std::size_t> order;
+	for(const auto &atom : clause.body) {
+	    std::set<std::size_t> seen;
+	    for(const auto &term : atom.args) {
+		if(term.kind == Term::Kind::Variable && seen.insert(term.slot).second) {
+		    if(uses[term.slot]++ == 0)
+			order.push_back(term.slot);
+		}
+	    }
+	}
+	std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+	    return uses[a] > uses[b];
+	});
+
+	Trie no_variables;
+	std::vector<const Trie*> tries(clause.body.size(), &no_variables);
+	// atoms_using[d] lists the tries containing order[d]
+	std::vector<std::vector<std::size_t>> atoms_using(order.size());
+	for(std::size_t i = 0; i < clause.body.size(); ++i) {
+	    const Atom &atom = clause.body[i];
+	    auto match = m_relations.find(atom.name);
+	    if(match == m_relations.end() || match->second.arity != atom.args.size())
+		return true;
+	    std::vector<std::size_t> variables;
+	    for(std::size_t d = 0; d < order.size(); ++d) {
+		bool used = std::any_of(atom.args.begin(), atom.args.end(), [&](const Term &term) {
+		    return term.kind == Term::Kind::Variable && term.slot == order[d];
+		});
+		if(used) {
+		    variables.push_back(order[d]);
+		    atoms_using[d].push_back(i);
+		}
+	    }
+	    const Relation &relation = match->second;
+	    std::size_t first = i == delta_position ? relation.stable : 0;
+	    if(variables.empty()) {
+		// No variables: the atom is just a condition on the relation
+		bool any = false;
+		for(std::size_t position = first; position < relation.limit && !any; ++position) {
+		    any = true;
+		    for(std::size_t j = 0; j < atom.args.size() && any; ++j)
+			any = atom.args[j].value->can_unify(*relation.row(position)[j]);
+		}
+		if(!any)
+		    return true;
+		continue;
+	    }
+	    auto &cached = m_tries[{&atom, i == delta_position}];
+	    if(!cached.is_built || cached.first != first || cached.last != relation.limit) {
+		cached.trie = Trie();
+		cached.is_ordered = build_trie(atom, relation, first, relation.limit, variables,
+					       cached.trie);
+		cached.first = first;
+		cached.last = relation.limit;
+		cached.is_built = true;
+	    }
+	    if(!cached.is_ordered)
+		return false;
+	    tries[i] = &cached.trie;
+	}
+
+	std::vector<TrieIterator> iterators;
+	for(const auto *trie : tries)
+	    iterators.emplace_back(*trie);
+	std::function<void(std::size_t)> bind = [&](std::size_t depth) {
+	    if(depth == order.size()) {
+		emit();
+		return;
+	    }
+	    const auto &atoms = atoms_using[depth];
+	    std::vector<TrieIterator*> active;
+	    for(std::size_t i : atoms) {
+		iterators[i].open();
+		active.push_back(&iterators[i]);
+	    }
+	    auto close = [&] {
+		for(auto *iterator : active)
+		    iterator->up();
+	    };
+	    if(std::any_of(active.begin(), active.end(), [](auto *it) { return it->at_end(); })) {
+		close();
+		return;
+	    }
+	    std::sort(active.begin(), active.end(), [](auto *a, auto *b) {
+		return a->key()->compare(*b->key()) < 0;
+	    });
+	    std::size_t p = 0, k = active.size();
+	    const IVariable *highest = active[k - 1]->key();
+	    while(true) {
+		TrieIterator &current = *active[p];
+		if(current.key()->compare(*highest) == 0) {
+		    // Every iterator agrees on this key
+		    slots[order[depth]] = highest;
+		    bind(depth + 1);
+		    current.next();
+		} else {
+		    current.seek(*highest);
+		}
+		if(current.at_end())
+		    break;
+		highest = current.key();
+		p = (p + 1) % k;
+	    }
+	    slots[order[depth]] = nullptr;
+	    close();
+	};
+	bind(0);
+	return true;
+    }
+
+    std::size_t apply(const Clause &clause, std::size_t delta_position)
+    {
+	Relation &head = m_relations[clause.head.name];
+	std::vector<const IVariable*> slots(clause.slot_count, nullptr);
+	std::vector<const IVariable*> tuple(clause.head.args.size());
+	std::size_t derived = 0;
+	auto emit = [&] {
+	    for(std::size_t i = 0; i < tuple.size(); ++i) {
+		const Term &term = clause.head.args[i];
+		tuple[i] = term.kind == Term::Kind::Variable ? slots[term.slot] : term.value;
+	    }
+	    derived += head.insert(tuple.data());
+	};
+	if(!uses_leapfrog(clause) || !leapfrog_join(clause, delta_position, slots, emit))
+	    join(clause, 0, delta_position, slots, emit);
+	return derived;
+    }
+
+    static std::string adorned(const std::string &name, const std::string &adornment)
+    {
+	return name + "^" + adornment;
+    }
+
+    static std::string magic(const std::string &name, const std::string &adornment)
+    {
+	return "magic^" + adorned(name, adornment);
+    }
+
+    static bool is_bound(const Term &term, const std::vector<bool> &bound_slots)
+    {
+	return term.kind == Term::Kind::Constant
+	    || (term.kind == Term::Kind::Variable && bound_slots[term.slot]);
+    }
+
+    // The first Seed for goal's name whose bound arguments goal binds to the
+    // same values, so that its adorned relation holds every answer to goal
+    const Seed* covering_seed(const RuleVariable &goal) const
+    {
+	for(const auto &seed : m_seeds) {
+	    if(seed.name != goal.name() || seed.adornment.size() != goal.arity())
+		continue;
+	    bool covers = true;
+	    for(std::size_t i = 0, k = 0; i < goal.arity() && covers; ++i) {
+		if(seed.adornment[i] == 'b')
+		    covers = goal[i]->is_unified() && goal[i]->equals(*seed.values[k++]);
+	    }
+	    if(covers)
+		return &seed;
+	}
+	return nullptr;
+    }
+
+    const FixpointEngine& full() const
+    {
+	if(m_full)
+	    return *m_full;
+	m_full = std::make_unique<FixpointEngine>();
+	m_full->m_join_strategy = m_join_strategy;
+	m_full->m_loaded = m_loaded;
+	m_full->m_clauses = m_loaded;
+	m_full->m_derived = m_derived;
+	// Relations no loaded clause derives hold the same rows here
+	for(const auto &clause : m_loaded) {
+	    m_full->relation(clause.head.name, clause.head.args.size());
+	    for(const auto &atom : clause.body) {
+		auto match = m_relations.find(atom.name);
+		if(m_derived.count(atom.name) || match == m_relations.end()
+		   || m_full->m_relations.count(atom.name))
+		    continue;
+		Relation &copy = m_full->relation(atom.name, match->second.arity);
+		for(std::size_t i = 0; i < match->second.row_count; ++i)
+		    copy.insert(match->second.row(i));
+	    }
+	}
+	m_full->evaluate();
+	return *m_full;
+    }
+
+    // The magic atom for atom under adornment: just its bound arguments
+    static Atom magic_atom(const Atom &atom, const std::string &adornment)
+    {
+	Atom result{magic(atom.name, adornment), {}};
+	for(std::size_t i = 0; i < atom.args.size(); ++i) {
+	    if(adornment[i] == 'b')
+		result.args.push_back(atom.args[i]);
+	}
+	return result;
+    }
+public:
+    // Copies db's ground facts into relations and its other clauses into
+    // rules. Returns false if some clause isn't Datalog (a non-ground fact,
+    // or a head variable the body never binds); such clauses are skipped
+    bool load(const Database &db)
+    {
+	bool supported = true;
+	std::vector<Clause> clauses;
+	std::set<std::string> derived;
+	db.for_each_rule([&](const Rule &rule) {
+	    Clause clause;
+	    clause.slot_count = 0;
+	    clause.head = to_atom(rule, clause.slot_count);
+	    for(const auto &goal : rule.predicates())
+		clause.body.push_back(to_atom(goal, clause.slot_count));
+	    bool too_wide = rule.arity() > 64
+		|| std::any_of(clause.body.begin(), clause.body.end(),
+			       [](const Atom &atom) { return atom.args.size() > 64; });
+	    if(too_wide) {
+		supported = false;
+		return;
+	    }
+
+	    std::vector<bool> bound_slots(clause.slot_count, false);
+	    for(const auto &atom : clause.body) {
+		for(const auto &term : atom.args) {
+		    if(term.kind == Term::Kind::Variable)
+			bound_slots[term.slot] = true;
+		}
+	    }
+	    for(const auto &term : clause.head.args) {
+		if(!is_bound(term, bound_slots)) {
+		    supported = false;
+		    return;
+		}
+	    }
+	    if(!clause.body.empty()) {
+		derived.insert(clause.head.name);
+	    } else {
+		// Facts may be temporaries (see Database::for_each_rule)
+		for(auto &term : clause.head.args) {
+		    if(term.value) {
+			m_owned_values.push_back(term.value->clone());
+			term.value = m_owned_values.back().get();
+		    }
+		}
+	    }
+	    clauses.push_back(std::move(clause));
+	});
+
+	m_full.reset();
+	m_derived.insert(derived.begin(), derived.end());
+	for(auto &clause : clauses) {
+	    relation(clause.head.name, clause.head.args.size());
+	    if(!clause.body.empty() || derived.count(clause.head.name)) {
+		m_loaded.push_back(clause);
+		m_clauses.push_back(std::move(clause));
+		continue;
+	    }
+	    std::vector<const IVariable*> tuple;
+	    for(const auto &term : clause.head.args)
+		tuple.push_back(term.value);
+	    m_relations[clause.head.name].insert(tuple.data());
+	}
+	return supported;
+    }
+
+    // Rewrites the loaded rules with magic sets for the binding pattern of
+    // conjecture (which of its arguments hold values), passing bindings from
+    // the head and from each predicate to the ones after it. evaluate() then
+    // only derives tuples that are relevant to conjecture. Each call adds
+    // its seed, and the adorned rules for binding patterns not seen before,
+    // to those of earlier calls; rules are always rewritten from the loaded
+    // ones
+    void rewrite_for(const RuleVariable &conjecture)
+    {
+	if(!m_derived.count(conjecture.name()) || covering_seed(conjecture))
+	    return;
+
+	Seed query{conjecture.name(), "", {}};
+	Atom seed{"", {}};
+	for(std::size_t i = 0; i < conjecture.arity(); ++i) {
+	    bool bound = conjecture[i]->is_unified();
+	    query.adornment += bound ? 'b' : 'f';
+	    if(bound) {
+		m_owned_values.push_back(conjecture[i]->clone());
+		query.values.push_back(m_owned_values.back().get());
+		seed.args.push_back({Term::Kind::Constant, 0, query.values.back()});
+	    }
+	}
+	seed.name = magic(conjecture.name(), query.adornment);
+	// The first call replaces the loaded rules
+	if(m_seeds.empty())
+	    m_clauses.clear();
+
+	std::vector<Clause> rewritten{{seed, {}, 0}};
+	std::vector<std::pair<std::string, std::string>> pending;
+	if(m_adorned.insert({conjecture.name(), query.adornment}).second)
+	    pending.push_back({conjecture.name(), query.adornment});
+	m_seeds.push_back(std::move(query));
+	while(!pending.empty()) {
+	    auto [name, adornment] = pending.back();
+	    pending.pop_back();
+	    for(const auto &clause : m_loaded) {
+		if(clause.head.name != name || clause.head.args.size() != adornment.size())
+		    continue;
+		std::vector<bool> bound_slots(clause.slot_count, false);
+		for(std::size_t i = 0; i < adornment.size(); ++i) {
+		    const Term &term = clause.head.args[i];
+		    if(adornment[i] == 'b' && term.kind == Term::Kind::Variable)
+			bound_slots[term.slot] = true;
+		}
+		Clause modified{{adorned(name, adornment), clause.head.args},
+				{magic_atom(clause.head, adornment)}, clause.slot_count};
+		for(const auto &goal : clause.body) {
+		    Atom next = goal;
+		    if(m_derived.count(goal.name)) {
+			std::string goal_adornment;
+			for(const auto &term : goal.args)
+			    goal_adornment += is_bound(term, bound_slots) ? 'b' : 'f';
+			// magic_goal(bound args) :- everything proven before goal
+			rewritten.push_back({magic_atom(goal, goal_adornment), modified.body,
+					     clause.slot_count});
+			if(m_adorned.insert({goal.name, goal_adornment}).second)
+			    pending.push_back({goal.name, goal_adornment});
+			next.name = adorned(goal.name, goal_adornment);
+		    }
+		    for(const auto &term : goal.args) {
+			if(term.kind == Term::Kind::Variable)
+			    bound_slots[term.slot] = true;
+		    }
+		    modified.body.push_back(std::move(next));
+		}
+		rewritten.push_back(std::move(modified));
+	    }
+	}
+	for(const auto &clause : rewritten) {
+	    relation(clause.head.name, clause.head.args.size());
+	    for(const auto &atom : clause.body)
+		relation(atom.name, atom.args.size());
+	}
+	m_clauses.insert(m_clauses.end(), std::make_move_iterator(rewritten.begin()),
+			 std::make_move_iterator(rewritten.end()));
+    }
+
+    // Applies the rules until no new tuples appear; returns how many were derived
+    std::size_t evaluate()
+    {
+	m_tries.clear();
+	std::size_t derived = 0;
+	bool first_round = true;
+	while(true) {
+	    for(auto &[name, relation] : m_relations)
+		relation.limit = relation.row_count;
+	    std::size_t round_derived = 0;
+	    for(const auto &clause : m_clauses) {
+		if(first_round) {
+		    round_derived += apply(clause, clause.body.size());
+		    continue;
+		}
+		for(std::size_t i = 0; i < clause.body.size(); ++i) {
+		    auto match = m_relations.find(clause.body[i].name);
+		    if(match != m_relations.end() && match->second.stable < match->second.limit)
+			round_derived += apply(clause, i);
+		}
+	    }
+	    for(auto &[name, relation] : m_relations)
+		relation.stable = relation.limit;
+	    ++m_round_count;
+	    derived += round_derived;
+	    first_round = false;
+	    if(round_derived == 0)
+		return derived;
+	}
+    }
+
+    // Whether some tuple derived for goal's predicate unifies with goal. Once
+    // the rules have been rewritten, a goal of a derived predicate is looked
+    // up in the adorned relation of a rewrite_for() call that covers it, or
+    // else answered by evaluating the loaded rules in full (once)
+    bool contains(const RuleVariable &goal) const
+    {
+	const FixpointEngine *engine = this;
+	std::string name = goal.name();
+	if(!m_seeds.empty() && m_derived.count(name)) {
+	    if(auto *seed = covering_seed(goal))
+		name = adorned(name, seed->adornment);
+	    else
+		engine = &full();
+	}
+	auto match = engine->m_relations.find(name);
+	if(match == engine->m_relations.end() || match->second.arity != goal.arity())
+	    return false;
+	const Relation &relation = match->second;
+	auto matches = [&](std::size_t position) {
+	    auto *row = relation.row(position);
+	    for(std::size_t j = 0; j < goal.arity(); ++j) {
+		if(!goal[j]->can_unify(*row[j]))
+		    return false;
+	    }
+	    return true;
+	};
+	// A ground goal is looked up in the index insert() keeps
+	std::vector<const IVariable*> values;
+	for(std::size_t j = 0; j < goal.arity() && goal[j]->is_unified(); ++j)
+	    values.push_back(goal[j]);
+	auto index = relation.indexes.find(relation.all_columns());
+	if(values.size() == goal.arity() && index != relation.indexes.end()) {
+	    auto rows = index->second.find(Relation::hash(values.data(), relation.all_columns(),
+							  relation.arity));
+	    return rows != index->second.end()
+		&& std::any_of(rows->second.begin(), rows->second.end(), matches);
+	}
+	for(std::size_t i = 0; i < relation.row_count; ++i) {
+	    if(matches(i))
+		return true;
+	}
+	return false;
+    }
+
+    // Number of tuples in a relation, including adorned and magic ones
+    std::size_t size(const std::string &name) const
+    {
+	auto match = m_relations.find(name);
+	return match != m_relations.end() ? match->second.row_count : 0;
+    }
+
+    std::size_t round_count() const { return m_round_count; }
+
+    void set_join_strategy(JoinStrategy strategy) { m_join_strategy = strategy; }
+
+    const std::vector<Clause>& clauses() const { return m_clauses; }
+};
+
+// A Database written by Database::save(), queried directly from a read-only
+// mapping of the file. Opening it costs one mmap call and one pass checking
+// that every record lies within the file; queries then never copy anything
+class MappedDatabase {
+private:
+    using Format = SnapshotFormat;
+    MappedFile m_file;
+    const Format::Header *m_header = nullptr;
+
+    template<typename T>
+    const T* at(std::uint64_t offset) const
+    {
+	return reinterpret_cast<const T*>(m_file.contents().data() + offset);
+    }
+
+    std::string_view string_at(std::uint64_t offset, std::uint64_t length) const
+    {
+	return {at<char>(offset), static_cast<std::size_t>(length)};
+    }
+
+    // Whether count Ts starting at offset lie within the file, aligned for T
+    template<typename T>
+    bool fits(std::uint64_t offset, std::uint64_t count = 1) const
+    {
+	std::uint64_t size = m_file.contents().size();
+	return offset % alignof(T) == 0 && offset <= size && count <= (size - offset) / sizeof(T);
+    }
+
+    // Whether every offset, count and index in the file stays within it, so
+    // that nothing a query follows can lead outside the mapping
+    bool is_well_formed(const Format::Header &header) const
+    {
+	if(!fits<Format::SymbolEntry>(header.symbols_offset, header.symbol_count)
+	   || !fits<std::uint32_t>(header.sorted_symbols_offset, header.symbol_count)
+	   || !fits<Format::PredicateEntry>(header.predicates_offset, header.predicate_count))
+	    return false;
+	auto *symbols = at<Format::SymbolEntry>(header.symbols_offset);
+	auto *sorted_symbols = at<std::uint32_t>(header.sorted_symbols_offset);
+	for(std::uint64_t i = 0; i < header.symbol_count; ++i) {
+	    if(!fits<char>(symbols[i].offset, symbols[i].length)
+	       || sorted_symbols[i] >= header.symbol_count)
+		return false;
+	}
+	auto *predicates = at<Format::PredicateEntry>(header.predicates_offset);
+	for(std::uint64_t i = 0; i < header.predicate_count; ++i) {
+	    const auto &predicate = predicates[i];
+	    if(!fits<char>(predicate.name_offset, predicate.name_length)
+	       || !fits<std::uint64_t>(predicate.clauses_offset, predicate.clause_count)
+	       || !fits<Format::IndexEntry>(predicate.indexed_offset, predicate.indexed_count)
+	       || !fits<std::uint64_t>(predicate.unindexed_offset, predicate.unindexed_count))
+		return false;
+	    auto *clauses = at<std::uint64_t>(predicate.clauses_offset);
+	    for(std::uint64_t j = 0; j < predicate.clause_count; ++j) {
+		if(!fits<Format::ClauseRecord>(clauses[j]))
+		    return false;
+		auto *clause = at<Format::ClauseRecord>(clauses[j]);
+		if(!fits<Format::Cell>(clauses[j] + sizeof(Format::ClauseRecord), clause->arity)
+		   || !fits<Format::GoalRecord>(clause->goals_offset, clause->goal_count))
+		    return false;
+		auto *goals = at<Format::GoalRecord>(clause->goals_offset);
+		for(std::uint32_t k = 0; k < clause->goal_count; ++k) {
+		    if((goals[k].predicate != Format::no_predicate
+			&& goals[k].predicate >= header.predicate_count)
+		       || !fits<Format::Cell>(goals[k].cells_offset, goals[k].arity))
+			return false;
+		}
+	    }
+	    auto *indexed = at<Format::IndexEntry>(predicate.indexed_offset);
+	    for(std::uint64_t j = 0; j < predicate.indexed_count; ++j) {
+		if(indexed[j].position >= predicate.clause_count)
+		    return false;
+	    }
+	    auto *unindexed = at<std::uint64_t>(predicate.unindexed_offset);
+	    for(std::uint64_t j = 0; j < predicate.unindexed_count; ++j) {
+		if(unindexed[j] >= predicate.clause_count)
+		    return false;
+	    }
+	}
+	return true;
+    }
+
+    const Format::PredicateEntry* find_predicate(std::string_view name) const
+    {
+	auto *first = at<Format::PredicateEntry>(m_header->predicates_offset);
+	auto *last = first + m_header->predicate_count;
+	auto *match = std::lower_bound(first, last, name,
+				       [this](const Format::PredicateEntry &entry, std::string_view key) {
+					   return string_at(entry.name_offset, entry.name_length) < key;
+				       });
+	if(match == last || string_at(match->name_offset, match->name_length) != name)
+	    return nullptr;
+	return match;
+    }
+
+    bool query(const Format::PredicateEntry &predicate, const Format::Cell *args,
+	       std::uint32_t arity) const
+    {
+	auto *clauses = at<std::uint64_t>(predicate.clauses_offset);
+	// Same first-matching-clause rule as Database::query
+	auto try_clause = [&](std::uint64_t position, bool &result) {
+	    auto *clause = at<Format::ClauseRecord>(clauses[position]);
+	    if(clause->arity != arity)
+		return false;
+	    auto *params = reinterpret_cast<const Format::Cell*>(clause + 1);
+	    for(std::uint32_t i = 0; i < arity; ++i) {
+		if(!Format::can_unify(args[i], params[i]))
+		    return false;
+	    }
+	    result = true;
+	    auto *goals = at<Format::GoalRecord>(clause->goals_offset);
+	    for(std::uint32_t i = 0; i < clause->goal_count && result; ++i) {
+		result = goals[i].predicate != Format::no_predicate
+		    && query(at<Format::PredicateEntry>(m_header->predicates_offset)[goals[i].predicate],
+			     at<Format::Cell>(goals[i].cells_offset), goals[i].arity);
+	    }
+	    return true;
+	};
+
+	bool result = false;
+	if(arity == 0 || !Format::is_indexable(args[0])) {
+	    for(std::uint64_t i = 0; i < predicate.clause_count; ++i) {
+		if(try_clause(i, result))
+		    return result;
+	    }
+	    return false;
+	}
+	auto *first = at<Format::IndexEntry>(predicate.indexed_offset);
+	auto *last = first + predicate.indexed_count;
+	std::uint64_t key = Format::hash(args[0]);
+	auto *indexed = std::lower_bound(first, last, key,
+					 [](const Format::IndexEntry &entry, std::uint64_t hash) {
+					     return entry.hash < hash;
+					 });
+	auto *unindexed = at<std::uint64_t>(predicate.unindexed_offset);
+	auto *unindexed_end = unindexed + predicate.unindexed_count;
+	while((indexed != last && indexed->hash == key) || unindexed != unindexed_end) {
+	    std::uint64_t position;
+	    if(unindexed == unindexed_end
+	       || (indexed != last && indexed->hash == key && indexed->position < *unindexed))
+		position = (indexed++)->position;
+	    else
+		position = *unindexed++;
+	    if(try_clause(position, result))
+		return result;
+	}
+	return false;
+    }
+public:
+    explicit MappedDatabase(const std::string &path) : m_file(path, false)
+    {
+	auto contents = m_file.contents();
+	if(!m_file.is_open() || contents.size() < sizeof(Format::Header))
+	    return;
+	auto *header = at<Format::Header>(0);
+	if(std::memcmp(header->magic, Format::magic, sizeof(Format::magic)) != 0
+	   || header->version != Format::version
+	   || header->byte_order_mark != Format::byte_order_mark
+	   || !is_well_formed(*header))
+	    return;
+	m_header = header;
+    }
+
+    // False if the file is missing, not a snapshot of this version or has
+    // records that don't fit in it (e.g. because it was cut short)
+    bool is_open() const { return m_header != nullptr; }
+
+    bool query(const RuleVariable &conjecture) const
+    {
+	if(!m_header)
+	    return false;
+	auto *predicate = find_predicate(conjecture.name());
+	if(!predicate)
+	    return false;
+	std::vector<Format::Cell> args(conjecture.arity());
+	for(std::size_t i = 0; i < args.size(); ++i)
+	    Format::to_cell(*conjecture[i], args[i]);
+	return query(*predicate, args.data(), static_cast<std::uint32_t>(args.size()));
+    }
+
+    template<typename ...Args>
+    bool query(std::string name, Args... args) const
+    {
+	return query(RuleVariable{name, args...});
+    }
+
+    // The Symbol the saved Database interned for name, if any
+    bool find_symbol(std::string_view name, Symbol &symbol) const
+    {
+	if(!m_header)
+	    return false;
+	auto *symbols = at<Format::SymbolEntry>(m_header->symbols_offset);
+	auto *first = at<std::uint32_t>(m_header->sorted_symbols_offset);
+	auto *last = first + m_header->symbol_count;
+	auto *match = std::lower_bound(first, last, name,
+				       [&](std::uint32_t id, std::string_view key) {
+					   return string_at(symbols[id].offset, symbols[id].length) < key;
+				       });
+	if(match == last || string_at(symbols[*match].offset, symbols[*match].length) != name)
+	    return false;
+	symbol = Symbol{*match};
+	return true;
+    }
+
+    std::string_view name(Symbol symbol) const
+    {
+	const auto &entry = at<Format::SymbolEntry>(m_header->symbols_offset)[symbol.id];
+	return string_at(entry.offset, entry.length);
+    }
+};
+
+
+// Runs Prolog programs on a Warren abstract machine. Unlike a Database's
+// clauses, its programs can use compound terms, lists ([H|T]), arithmetic
+// (is, <, =:=, ...), = and \=, and cut, and bindings flow between goals as
+// in Prolog. Each clause is compiled once into get/put/unify instructions
+// that the run() loop executes on a heap of Cells; there are no virtual calls
+// and no IVariables at run time. A call picks its candidate clauses by the
+// first argument (switch on term), so only a call that could match several
+// clauses pushes a choice point. Environments hold a clause's variables
+// across calls; its permanent variables always live on the heap, so nothing
+// ever points into an environment
+class AbstractMachine {
+public:
+    enum class Tag : std::uint8_t { Ref, Struct, Functor, Atom, Int, BigInt, Real };
+
+    // A word of the heap or of a register: a tag in the low three bits and
+    // a value above it. A Ref to itself is unbound; a Struct points at the
+    // Functor cell its arguments follow. Ints of up to 61 bits are held in
+    // the word; other integers and all doubles are boxed, as a BigInt or
+    // Real that points at a heap cell holding the raw 64 bits
+    class Cell {
+    private:
+	std::uint64_t m_word;
+
+	Cell(Tag tag, std::uint64_t value) : m_word(value << 3 | static_cast<std::uint64_t>(tag)) {}
+    public:
+	static constexpr long long max_int = (1LL << 60) - 1;
+	static constexpr long long min_int = -(1LL << 60);
+
+	Cell() : m_word(0) {}
+
+	static Cell ref(std::size_t address) { return Cell{Tag::Ref, address}; }
+
+	static Cell structure(std::size_t address) { return Cell{Tag::Struct, address}; }
+
+	static Cell functor(std::uint32_t id) { return Cell{Tag::Functor, id}; }
+
+	static Cell atom(Symbol symbol) { return Cell{Tag::Atom, symbol.id}; }
+
+	// value must be within [min_int, max_int]
+	static Cell number(long long value) { return Cell{Tag::Int, static_cast<std::uint64_t>(value)}; }
+
+	static Cell boxed(Tag tag, std::size_t address) { return Cell{tag, address}; }
+
+	// A word holding bits as they are, with no tag
+	static Cell raw(std::uint64_t bits) { Cell c; c.m_word = bits; return c; }
+
+	Tag tag() const { return static_cast<Tag>(m_word & 7); }
+
+	std::size_t address() const { return static_cast<std::size_t>(m_word >> 3); }
+
+	std::uint32_t id() const { return static_cast<std::uint32_t>(m_word >> 3); }
+
+	// Shifts the sign back in
+	long long integer() const { return static_cast<long long>(m_word) >> 3; }
+
+	std::uint64_t bits() const { return m_word; }
+
+	bool operator==(const Cell &other) const { return m_word == other.m_word; }
+    };
+    // Variable names and the text of their values, for each solution
+    using Answer = std::vector<std::pair<std::string, std::string>>;
+private:
+    enum class Op : std::uint8_t {
+	GetVariableX, GetVariableY, GetValueX, GetValueY, GetConstant, GetStructure,
+	UnifyVariableX, UnifyVariableY, UnifyValueX, UnifyValueY, UnifyConstant, UnifyVoid,
+	PutVariableX, PutVariableY, PutValueX, PutValueY, PutConstant, PutStructure,
+	SetVariableX, SetVariableY, SetValueX, SetValueY, SetConstant,
+	Allocate, Deallocate, Call, Proceed, Builtin, Cut, Halt
+    };
+
+    // a is a register or variable slot; b an argument register, functor,
+    // predicate or builtin
+    struct Instruction {
+	Op op;
+	std::uint32_t a = 0;
+	std::uint32_t b = 0;
+	Cell constant = Cell();
+    };
+
+    enum class Builtin : std::uint32_t {
+	True, Fail, Unify, NotUnify, Is, Less, Greater, LessOrEqual, GreaterOrEqual,
+	Equal, NotEqual
+    };
+
+    // A parsed term; variables are numbered within their clause
+    struct Term {
+	enum class Kind { Variable, Constant, Compound } kind;
+	std::uint32_t id = 0;
+	Cell constant = Cell();
+	std::vector<Term> args;
+    };
+
+    // The clauses of a predicate, as code addresses. A call whose first
+    // argument is bound only tries the clauses in by_key[key], which also
+    // holds the clauses whose first argument is a variable
+    struct Predicate {
+	std::uint32_t arity;
+	std::vector<std::uint32_t> clauses;
+	std::vector<std::uint32_t> variable_first;
+	std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> by_key;
+    };
+
+    struct ChoicePoint {
+	std::size_t env, continuation, cut_barrier;
+	std::size_t trail_top, heap_top, stack_top, args_offset;
+	const std::vector<std::uint32_t> *alternatives;
+	std::uint32_t next, arity;
+    };
+
+    // An environment's header, before its variable slots
+    static constexpr std::size_t frame_header = 4;
+    static constexpr std::size_t no_frame = std::numeric_limits<std::size_t>::max();
+
+    SymbolTable m_symbols;
+    std::vector<std::pair<Symbol, std::uint32_t>> m_functors;
+    std::unordered_map<std::uint64_t, std::uint32_t> m_functor_ids;
+    std::deque<Predicate> m_predicates;
+    // By functor; no_predicate if it names none
+    std::vector<std::uint32_t> m_predicate_of;
+    std::unordered_map<std::uint32_t, Builtin> m_builtins;
+    enum class Arithmetic : std::uint8_t { Add, Subtract, Multiply, Divide, IntDivide, Mod, Negate };
+    std::unordered_map<std::uint32_t, Arithmetic> m_arithmetic;
+    std::uint32_t m_cut;
+    std::vector<Instruction> m_code;
+
+    // Machine state
+    std::vector<Cell> m_heap;
+    std::vector<Cell> m_registers;
+    std::vector<Cell> m_stack;
+    std::vector<ChoicePoint> m_choices;
+    std::vector<Cell> m_saved_args;
+    // Each cell changed since a choice point, and its old value
+    std::vector<std::pair<std::size_t, Cell>> m_trail;
+    std::vector<std::pair<Cell, Cell>> m_unify_stack;
+    std::size_t m_env = no_frame;
+    std::size_t m_continuation = 0;
+    std::size_t m_cut_barrier = 0;
+    std::size_t m_inference_count = 0;
+    // Bindings of cells below this are trailed even without a choice point
+    std::size_t m_trail_all_below = 0;
+    // The boxed numbers of clauses lie below this
+    std::size_t m_constant_top = 0;
+
+    static constexpr std::uint32_t no_predicate = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t functor(Symbol name, std::uint32_t arity)
+    {
+	std::uint64_t key = std::uint64_t{name.id} << 32 | arity;
+	auto match = m_functor_ids.find(key);
+	if(match != m_functor_ids.end())
+	    return match->second;
+	auto id = static_cast<std::uint32_t>(m_functors.size());
+	m_functors.emplace_back(name, arity);
+	m_functor_ids.emplace(key, id);
+	m_predicate_of.push_back(no_predicate);
+	return id;
+    }
+
+    std::uint32_t functor(std::string_view name, std::uint32_t arity)
+    {
+	return functor(m_symbols.intern(name), arity);
+    }
+
+    std::uint32_t predicate(std::uint32_t functor_id)
+    {
+	auto &index = m_predicate_of[functor_id];
+	if(index == no_predicate) {
+	    index = static_cast<std::uint32_t>(m_predicates.size());
+	    m_predicates.push_back(Predicate{m_functors[functor_id].second, {}, {}, {}});
+	}
+	return index;
+    }
+
+    Cell box(Tag tag, std::uint64_t bits)
+    {
+	m_heap.push_back(Cell::raw(bits));
+	return Cell::boxed(tag, m_heap.size() - 1);
+    }
+
+    // An Int, or a BigInt boxed on the heap
+    Cell make_integer(long long value)
+    {
+	if(value >= Cell::min_int && value <= Cell::max_int)
+	    return Cell::number(value);
+	return box(Tag::BigInt, static_cast<std::uint64_t>(value));
+    }
+
+    Cell make_real(double value)
+    {
+	std::uint64_t bits;
+	std::memcpy(&bits, &value, sizeof bits);
+	return box(Tag::Real, bits);
+    }
+
+    long long integer_of(const Cell &cell) const
+    {
+	if(cell.tag() == Tag::Int)
+	    return cell.integer();
+	return static_cast<long long>(m_heap[cell.address()].bits());
+    }
+
+    double real_of(const Cell &cell) const
+    {
+	std::uint64_t bits = m_heap[cell.address()].bits();
+	double value;
+	std::memcpy(&value, &bits, sizeof value);
+	return value;
+    }
+
+    // A number in a clause or query. Its box, if any, goes below
+    // m_constant_top, which reset() keeps; the heap must be empty above it
+    template<typename T>
+    Cell constant(T value)
+    {
+	Cell cell;
+	if constexpr(std::is_floating_point_v<T>)
+	    cell = make_real(value);
+	else
+	    cell = make_integer(value);
+	m_constant_top = m_heap.size();
+	return cell;
+    }
+
+    // Whether two bound cells other than Structs are the same constant
+    bool same_constant(const Cell &a, const Cell &b) const
+    {
+	if(a == b)
+	    return true;
+	return a.tag() == b.tag() && (a.tag() == Tag::BigInt || a.tag() == Tag::Real)
+	    && m_heap[a.address()] == m_heap[b.address()];
+    }
+
+    // The first-argument key of a bound cell
+    std::uint64_t key_of(const Cell &cell) const
+    {
+	switch(cell.tag()) {
+	case Tag::Struct:
+	    return std::uint64_t{m_heap[cell.address()].id()} * 8 + static_cast<std::uint64_t>(Tag::Struct);
+	case Tag::BigInt:
+	case Tag::Real:
+	    return m_heap[cell.address()].bits() * 8 + static_cast<std::uint64_t>(cell.tag());
+	default:
+	    return cell.bits();
+	}
+    }
+
+    std::uint64_t key_of(const Term &term) const
+    {
+	if(term.kind == Term::Kind::Compound)
+	    return std::uint64_t{term.id} * 8 + static_cast<std::uint64_t>(Tag::Struct);
+	return key_of(term.constant);
+    }
+
+    void add_clause(std::uint32_t head_functor, const Term *first_arg, std::uint32_t address)
+    {
+	auto &target = m_predicates[predicate(head_functor)];
+	target.clauses.push_back(address);
+	if(!first_arg || first_arg->kind == Term::Kind::Variable) {
+	    target.variable_first.push_back(address);
+	    for(auto &entry : target.by_key)
+		entry.second.push_back(address);
+	} else {
+	    auto key = key_of(*first_arg);
+	    auto match = target.by_key.find(key);
+	    if(match == target.by_key.end())
+		match = target.by_key.emplace(key, target.variable_first).first;
+	    match->second.push_back(address);
+	}
+    }
+
+    // Parses Prolog text: clauses of terms with the usual operators for
+    // arithmetic and comparison, lists and quoted atoms
+    class Parser {
+    private:
+	AbstractMachine &m_machine;
+	std::string_view m_text;
+	std::size_t m_pos = 0;
+	std::size_t m_line = 1;
+	std::string m_error;
+	std::vector<std::string> m_variables;
+
+	static bool is_symbol_char(char c)
+	{
+	    return std::strchr("+-*/\\^<>=~:.?@#&$", c) != nullptr && c != '\0';
+	}
+
+	static bool is_alnum(char c)
+	{
+	    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+
+	char peek(std::size_t offset = 0) const
+	{
+	    return m_pos + offset < m_text.size() ? m_text[m_pos + offset] : '\0';
+	}
+
+	bool fail(const char *message)
+	{
+	    if(m_error.empty())
+		m_error = message;
+	    return false;
+	}
+
+	void skip_space()
+	{
+	    while(m_pos < m_text.size()) {
+		char c = m_text[m_pos];
+		if(c == '\n') {
+		    ++m_line;
+		    ++m_pos;
+		} else if(c == ' ' || c == '\t' || c == '\r') {
+		    ++m_pos;
+		} else if(c == '%') {
+		    while(m_pos < m_text.size() && m_text[m_pos] != '\n')
+			++m_pos;
+		} else if(c == '/' && peek(1) == '*') {
+		    auto end = m_text.find("*/", m_pos + 2);
+		    end = end == std::string_view::npos ? m_text.size() : end + 2;
+		    m_line += std::count(m_text.begin() + m_pos, m_text.begin() + end, '\n');
+		    m_pos = end;
+		} else {
+		    break;
+		}
+	    }
+	}
+
+	// The '.' ending a clause: one followed by space or the end
+	bool at_end_of_clause()
+	{
+	    skip_space();
+	    char next = peek(1);
+	    return peek() == '.' && (next == '\0' || next == ' ' || next == '\n' || next == '\t'
+				     || next == '\r' || next == '%');
+	}
+
+	// The infix operator at m_pos, if any, without consuming it
+	std::string_view peek_operator()
+	{
+	    skip_space();
+	    if(at_end_of_clause())
+		return {};
+	    std::size_t end = m_pos;
+	    if(peek() == ',' || peek() == '|')
+		return m_text.substr(m_pos, 1);
+	    while(end < m_text.size() && is_symbol_char(m_text[end]))
+		++end;
+	    if(end > m_pos)
+		return m_text.substr(m_pos, end - m_pos);
+	    while(end < m_text.size() && is_alnum(m_text[end]))
+		++end;
+	    auto word = m_text.substr(m_pos, end - m_pos);
+	    return word == "is" || word == "mod" ? word : std::string_view{};
+	}
+
+	static int priority(std::string_view op)
+	{
+	    if(op == ":-")
+		return 1200;
+	    if(op == ",")
+		return 1000;
+	    if(op == "=" || op == "\\=" || op == "is" || op == "<" || op == ">" || op == "=<"
+	       || op == ">=" || op == "=:=" || op == "=\\=")
+		return 700;
+	    if(op == "+" || op == "-")
+		return 500;
+	    if(op == "*" || op == "/" || op == "//" || op == "mod")
+		return 400;
+	    return 0;
+	}
+
+	Term compound(std::string_view name, std::vector<Term> args)
+	{
+	    Term term{Term::Kind::Compound, m_machine.functor(name, static_cast<std::uint32_t>(args.size())),
+		      Cell(), std::move(args)};
+	    return term;
+	}
+
+	Term atom(std::string_view name)
+	{
+	    return Term{Term::Kind::Constant, 0, Cell::atom(m_machine.m_symbols.intern(name)), {}};
+	}
+
+	Term variable(std::string_view name)
+	{
+	    std::uint32_t id = 0;
+	    if(name != "_") {
+		auto match = std::find(m_variables.begin(), m_variables.end(), name);
+		if(match != m_variables.end())
+		    return Term{Term::Kind::Variable, static_cast<std::uint32_t>(match - m_variables.begin()),
+				Cell(), {}};
+	    }
+	    id = static_cast<std::uint32_t>(m_variables.size());
+	    m_variables.emplace_back(name);
+	    return Term{Term::Kind::Variable, id, Cell(), {}};
+	}
+
+	// A number, with its sign if any; false if it doesn't fit a long long
+	// or double
+	bool parse_number(Term &term)
+	{
+	    std::size_t start = m_pos;
+	    if(peek() == '-')
+		++m_pos;
+	    while(peek() >= '0' && peek() <= '9')
+		++m_pos;
+	    bool is_real = peek() == '.' && peek(1) >= '0' && peek(1) <= '9';
+	    if(is_real) {
+		++m_pos;
+		while(peek() >= '0' && peek() <= '9')
+		    ++m_pos;
+	    }
+	    const char *first = m_text.data() + start, *last = m_text.data() + m_pos;
+	    term.kind = Term::Kind::Constant;
+	    double real = 0;
+	    long long integer = 0;
+	    auto result = is_real ? std::from_chars(first, last, real) : std::from_chars(first, last, integer);
+	    if(result.ec == std::errc::result_out_of_range)
+		return fail("number out of range");
+	    if(result.ec != std::errc() || result.ptr != last)
+		return fail("malformed number");
+	    term.constant = is_real ? m_machine.constant(real) : m_machine.constant(integer);
+	    return true;
+	}
+
+	bool parse_list(Term &term)
+	{
+	    ++m_pos;
+	    skip_space();
+	    if(peek() == ']') {
+		++m_pos;
+		term = atom("[]");
+		return true;
+	    }
+	    std::vector<Term> items;
+	    Term tail = atom("[]");
+	    while(true) {
+		items.emplace_back();
+		if(!parse(999, items.back()))
+		    return false;
+		skip_space();
+		if(peek() == ',') {
+		    ++m_pos;
+		    continue;
+		}
+		if(peek() == '|') {
+		    ++m_pos;
+		    if(!parse(999, tail))
+			return false;
+		    skip_space();
+		}
+		if(peek() != ']')
+		    return fail("expected ',', '|' or ']'");
+		++m_pos;
+		break;
+	    }
+	    term = std::move(tail);
+	    for(auto item = items.rbegin(); item != items.rend(); ++item) {
+		std::vector<Term> pair;
+		pair.push_back(std::move(*item));
+		pair.push_back(std::move(term));
+		term = compound(".", std::move(pair));
+	    }
+	    return true;
+	}
+
+	bool parse_primary(Term &term)
+	{
+	    skip_space();
+	    char c = peek();
+	    if((c >= '0' && c <= '9') || (c == '-' && peek(1) >= '0' && peek(1) <= '9'))
+		return parse_number(term);
+	    if(c == '(') {
+		++m_pos;
+		if(!parse(1200, term))
+		    return false;
+		skip_space();
+		if(peek() != ')')
+		    return fail("expected ')'");
+		++m_pos;
+		return true;
+	    }
+	    if(c == '[')
+		return parse_list(term);
+	    if(c == '!') {
+		++m_pos;
+		term = atom("!");
+		return true;
+	    }
+	    if(c == '-') {
+		++m_pos;
+		std::vector<Term> args(1);
+		if(!parse(200, args[0]))
+		    return false;
+		term = compound("-", std::move(args));
+		return true;
+	    }
+	    std::string name;
+	    if(c == '\'') {
+		auto end = m_text.find('\'', m_pos + 1);
+		if(end == std::string_view::npos)
+		    return fail("unterminated quoted atom");
+		name = m_text.substr(m_pos + 1, end - m_pos - 1);
+		m_pos = end + 1;
+	    } else if(is_alnum(c)) {
+		std::size_t start = m_pos;
+		while(is_alnum(peek()))
+		    ++m_pos;
+		name = m_text.substr(start, m_pos - start);
+		if((c >= 'A' && c <= 'Z') || c == '_') {
+		    term = variable(name);
+		    return true;
+		}
+	    } else {
+		return fail("expected a term");
+	    }
+	    if(peek() != '(') {
+		term = atom(name);
+		return true;
+	    }
+	    std::vector<Term> args;
+	    do {
+		++m_pos;
+		args.emplace_back();
+		if(!parse(999, args.back()))
+		    return false;
+		skip_space();
+	    } while(peek() == ',');
+	    if(peek() != ')')
+		return fail("expected ',' or ')'");
+	    ++m_pos;
+	    term = compound(name, std::move(args));
+	    return true;
+	}
+
+	// Operators are xfx at 1200 and 700, xfy at 1000 and yfx below
+	bool parse(int max_priority, Term &term)
+	{
+	    if(!parse_primary(term))
+		return false;
+	    int left_priority = 0;
+	    while(true) {
+		auto op = peek_operator();
+		int op_priority = priority(op);
+		if(op_priority == 0 || op_priority > max_priority
+		   || ((op_priority == 1200 || op_priority == 700) && left_priority >= op_priority))
+		    return true;
+		m_pos += op.size();
+		int right_priority = op_priority == 1000 ? 1000 : op_priority - 1;
+		std::vector<Term> args(2);
+		args[0] = std::move(term);
+		if(!parse(right_priority, args[1]))
+		    return false;
+		term = compound(op, std::move(args));
+		left_priority = op_priority;
+	    }
+	}
+
+	void flatten(Term &&goals, std::vector<Term> &body)
+	{
+	    if(goals.kind == Term::Kind::Compound && goals.id == m_machine.functor(",", 2)) {
+		flatten(std::move(goals.args[0]), body);
+		flatten(std::move(goals.args[1]), body);
+	    } else {
+		body.push_back(std::move(goals));
+	    }
+	}
+    public:
+	Parser(AbstractMachine &machine, std::string_view text) : m_machine(machine), m_text(text) {}
+
+	bool at_end()
+	{
+	    skip_space();
+	    return m_pos >= m_text.size();
+	}
+
+	// Parses one clause (or, if is_query, a conjunction of goals) ending in
+	// '.', or at the end of the text for queries
+	bool parse_clause(Term &head, std::vector<Term> &body, bool is_query)
+	{
+	    m_variables.clear();
+	    body.clear();
+	    Term term;
+	    if(!parse(1200, term))
+		return false;
+	    if(is_query) {
+		flatten(std::move(term), body);
+	    } else if(term.kind == Term::Kind::Compound && term.id == m_machine.functor(":-", 2)) {
+		head = std::move(term.args[0]);
+		flatten(std::move(term.args[1]), body);
+	    } else {
+		head = std::move(term);
+	    }
+	    if(!is_query && head.kind == Term::Kind::Variable)
+		return fail("a clause's head must be an atom or compound term");
+	    if(!is_query && head.kind == Term::Kind::Constant && head.constant.tag() != Tag::Atom)
+		return fail("a clause's head must be an atom or compound term");
+	    skip_space();
+	    if(at_end_of_clause()) {
+		++m_pos;
+		return true;
+	    }
+	    return is_query && m_pos >= m_text.size() ? true : fail("expected an operator or '.'");
+	}
+
+	const std::vector<std::string>& variables() const { return m_variables; }
+
+	const std::string& error() const { return m_error; }
+
+	std::size_t line() const { return m_line; }
+    };
+
+    // How a clause's variables are kept: in X registers if they are only
+    // used between two calls, else in Y slots of its environment
+    struct VariableInfo {
+	std::size_t occurrences = 0;
+	std::size_t first_chunk = 0, last_chunk = 0;
+	bool is_permanent = false;
+	bool is_seen = false;
+	std::uint32_t index = 0;
+    };
+
+    class ClauseCompiler {
+    private:
+	AbstractMachine &m_machine;
+	std::vector<VariableInfo> m_variables;
+	std::uint32_t m_next_register = 0;
+
+	std::vector<Instruction>& code() { return m_machine.m_code; }
+
+	void emit(Op op, std::uint32_t a, std::uint32_t b = 0, Cell constant = Cell())
+	{
+	    code().push_back(Instruction{op, a, b, constant});
+	}
+
+	std::uint32_t fresh_register()
+	{
+	    std::uint32_t result = m_next_register++;
+	    if(m_machine.m_registers.size() <= result)
+		m_machine.m_registers.resize(result + 1);
+	    return result;
+	}
+
+	void count(const Term &term, std::size_t chunk)
+	{
+	    if(term.kind == Term::Kind::Variable) {
+		auto &info = m_variables[term.id];
+		if(info.occurrences++ == 0)
+		    info.first_chunk = chunk;
+		info.last_chunk = chunk;
+	    }
+	    for(const auto &arg : term.args)
+		count(arg, chunk);
+	}
+
+	// Picks the X or Y form of an instruction, and marks the variable seen
+	Op variable_op(const Term &term, Op x_first, Op y_first, Op x_later, Op y_later)
+	{
+	    auto &info = m_variables[term.id];
+	    bool first = !info.is_seen;
+	    info.is_seen = true;
+	    if(info.is_permanent)
+		return first ? y_first : y_later;
+	    return first ? x_first : x_later;
+	}
+
+	bool is_void(const Term &term) const
+	{
+	    return term.kind == Term::Kind::Variable && m_variables[term.id].occurrences == 1;
+	}
+
+	// Unify instructions for a structure's arguments in the head; nested
+	// structures are matched afterwards through registers
+	void head_structure(const Term &term, std::uint32_t reg)
+	{
+	    emit(Op::GetStructure, reg, term.id);
+	    std::vector<std::pair<std::uint32_t, const Term*>> nested;
+	    for(const auto &arg : term.args) {
+		if(arg.kind == Term::Kind::Constant) {
+		    emit(Op::UnifyConstant, 0, 0, arg.constant);
+		} else if(arg.kind == Term::Kind::Compound) {
+		    std::uint32_t inner = fresh_register();
+		    emit(Op::UnifyVariableX, inner);
+		    nested.emplace_back(inner, &arg);
+		} else if(is_void(arg)) {
+		    emit(Op::UnifyVoid, 0);
+		} else {
+		    Op op = variable_op(arg, Op::UnifyVariableX, Op::UnifyVariableY,
+					Op::UnifyValueX, Op::UnifyValueY);
+		    emit(op, m_variables[arg.id].index);
+		}
+	    }
+	    for(const auto &[inner, nested_term] : nested)
+		head_structure(*nested_term, inner);
+	}
+
+	// Builds a structure bottom-up into register reg
+	void body_structure(const Term &term, std::uint32_t reg)
+	{
+	    std::vector<std::uint32_t> inner(term.args.size());
+	    for(std::size_t i = 0; i < term.args.size(); ++i) {
+		if(term.args[i].kind == Term::Kind::Compound) {
+		    inner[i] = fresh_register();
+		    body_structure(term.args[i], inner[i]);
+		}
+	    }
+	    emit(Op::PutStructure, reg, term.id);
+	    for(std::size_t i = 0; i < term.args.size(); ++i) {
+		const auto &arg = term.args[i];
+		if(arg.kind == Term::Kind::Constant) {
+		    emit(Op::SetConstant, 0, 0, arg.constant);
+		} else if(arg.kind == Term::Kind::Compound) {
+		    emit(Op::SetValueX, inner[i]);
+		} else {
+		    Op op = variable_op(arg, Op::SetVariableX, Op::SetVariableY, Op::SetValueX, Op::SetValueY);
+		    emit(op, m_variables[arg.id].index);
+		}
+	    }
+	}
+
+	void put_args(const Term &goal)
+	{
+	    for(std::uint32_t i = 0; i < goal.args.size(); ++i) {
+		const auto &arg = goal.args[i];
+		if(arg.kind == Term::Kind::Constant) {
+		    emit(Op::PutConstant, 0, i, arg.constant);
+		} else if(arg.kind == Term::Kind::Compound) {
+		    body_structure(arg, i);
+		} else {
+		    Op op = variable_op(arg, Op::PutVariableX, Op::PutVariableY, Op::PutValueX, Op::PutValueY);
+		    emit(op, m_variables[arg.id].index, i);
+		}
+	    }
+	}
+
+	std::uint32_t functor_of(const Term &goal)
+	{
+	    return goal.kind == Term::Kind::Compound ? goal.id : m_machine.functor(Symbol{goal.constant.id()}, 0);
+	}
+
+	std::optional<Builtin> builtin_of(const Term &goal)
+	{
+	    auto match = m_machine.m_builtins.find(functor_of(goal));
+	    if(match == m_machine.m_builtins.end())
+		return std::nullopt;
+	    return match->second;
+	}
+    public:
+	ClauseCompiler(AbstractMachine &machine) : m_machine(machine) {}
+
+	// Appends the code for head :- body (or, for a query, body followed
+	// by Halt with every variable kept in the environment) and returns its
+	// address, or false if a goal isn't callable
+	bool compile(const Term *head, const std::vector<Term> &body, std::size_t variable_count,
+		     std::uint32_t &address)
+	{
+	    m_variables.assign(variable_count, VariableInfo{});
+	    bool is_query = head == nullptr;
+	    std::uint32_t max_arity = head ? static_cast<std::uint32_t>(head->args.size()) : 0;
+	    std::size_t chunk = 0;
+	    if(head)
+		count(*head, 0);
+	    std::size_t call_count = 0;
+	    for(const auto &goal : body) {
+		if(goal.kind == Term::Kind::Variable)
+		    return false;
+		if(goal.kind == Term::Kind::Constant && goal.constant.tag() != Tag::Atom)
+		    return false;
+		count(goal, chunk);
+		max_arity = std::max(max_arity, static_cast<std::uint32_t>(goal.args.size()));
+		if(!builtin_of(goal) && functor_of(goal) != m_machine.m_cut) {
+		    ++chunk;
+		    ++call_count;
+		}
+	    }
+	    std::uint32_t permanent_count = 0;
+	    m_next_register = max_arity;
+	    if(m_machine.m_registers.size() < max_arity)
+		m_machine.m_registers.resize(max_arity);
+	    for(auto &info : m_variables) {
+		info.is_permanent = is_query || info.first_chunk != info.last_chunk;
+		info.index = info.is_permanent ? permanent_count++ : fresh_register();
+	    }
+	    bool has_frame = is_query || call_count > 0;
+	    address = static_cast<std::uint32_t>(code().size());
+	    if(has_frame)
+		emit(Op::Allocate, permanent_count);
+	    if(head) {
+		for(std::uint32_t i = 0; i < head->args.size(); ++i) {
+		    const auto &arg = head->args[i];
+		    if(arg.kind == Term::Kind::Constant) {
+			emit(Op::GetConstant, 0, i, arg.constant);
+		    } else if(arg.kind == Term::Kind::Compound) {
+			head_structure(arg, i);
+		    } else if(!is_void(arg)) {
+			Op op = variable_op(arg, Op::GetVariableX, Op::GetVariableY,
+					    Op::GetValueX, Op::GetValueY);
+			emit(op, m_variables[arg.id].index, i);
+		    }
+		}
+	    }
+	    for(const auto &goal : body) {
+		if(functor_of(goal) == m_machine.m_cut) {
+		    emit(Op::Cut, has_frame);
+		    continue;
+		}
+		put_args(goal);
+		if(auto builtin = builtin_of(goal)) {
+		    emit(Op::Builtin, 0, static_cast<std::uint32_t>(*builtin));
+		} else {
+		    emit(Op::Call, 0, m_machine.predicate(functor_of(goal)));
+		}
+	    }
+	    if(is_query) {
+		emit(Op::Halt, 0);
+	    } else {
+		if(has_frame)
+		    emit(Op::Deallocate, 0);
+		emit(Op::Proceed, 0);
+	    }
+	    return true;
+	}
+    };
+
+    Cell deref(Cell cell) const
+    {
+	while(cell.tag() == Tag::Ref) {
+	    const Cell &next = m_heap[cell.address()];
+	    if(next.tag() == Tag::Ref && next.address() == cell.address())
+		break;
+	    cell = next;
+	}
+	return cell;
+    }
+
+    // Sets a heap cell, trailing its old value if backtracking must
+    // restore it: if it is older than the newest choice point
+    void set(std::size_t address, const Cell &value)
+    {
+	std::size_t boundary = m_choices.empty() ? 0 : m_choices.back().heap_top;
+	if(address < std::max(boundary, m_trail_all_below))
+	    m_trail.emplace_back(address, m_heap[address]);
+	m_heap[address] = value;
+    }
+
+    // Also points the cells passed on the way straight at the end (path
+    // compression), so a long chain of aliased variables is walked once
+    Cell deref(Cell cell)
+    {
+	Cell end = std::as_const(*this).deref(cell);
+	while(cell.tag() == Tag::Ref) {
+	    Cell next = m_heap[cell.address()];
+	    if(next == end || next.tag() != Tag::Ref || next.address() == cell.address())
+		break;
+	    set(cell.address(), end);
+	    cell = next;
+	}
+	return end;
+    }
+
+    void bind(std::size_t address, const Cell &value) { set(address, value); }
+
+    std::size_t new_variable()
+    {
+	std::size_t address = m_heap.size();
+	m_heap.push_back(Cell::ref(address));
+	return address;
+    }
+
+    bool unify(Cell a, Cell b)
+    {
+	auto &pending = m_unify_stack;
+	pending.clear();
+	pending.emplace_back(a, b);
+	while(!pending.empty()) {
+	    auto [left, right] = pending.back();
+	    pending.pop_back();
+	    left = deref(left);
+	    right = deref(right);
+	    if(left.tag() == Tag::Ref && right.tag() == Tag::Ref) {
+		// Younger variables point at older ones
+		if(left.address() < right.address())
+		    bind(right.address(), left);
+		else if(right.address() < left.address())
+		    bind(left.address(), right);
+	    } else if(left.tag() == Tag::Ref) {
+		bind(left.address(), right);
+	    } else if(right.tag() == Tag::Ref) {
+		bind(right.address(), left);
+	    } else if(left.tag() == Tag::Struct && right.tag() == Tag::Struct) {
+		if(left.address() == right.address())
+		    continue;
+		const Cell &functor = m_heap[left.address()];
+		if(functor.id() != m_heap[right.address()].id())
+		    return false;
+		for(std::size_t i = 1; i <= m_functors[functor.id()].second; ++i)
+		    pending.emplace_back(m_heap[left.address() + i], m_heap[right.address() + i]);
+	    } else if(!same_constant(left, right)) {
+		return false;
+	    }
+	}
+	return true;
+    }
+
+    Cell& permanent(std::uint32_t slot) { return m_stack[m_env + frame_header + slot]; }
+
+    std::size_t stack_top() const
+    {
+	std::size_t top = m_env == no_frame ? 0
+	    : m_env + frame_header + static_cast<std::size_t>(m_stack[m_env + 3].bits());
+	if(!m_choices.empty())
+	    top = std::max(top, m_choices.back().stack_top);
+	return top;
+    }
+
+    // Jumps to the clauses of predicate that the first argument allows,
+    // leaving a choice point if there is more than one
+    bool dispatch(std::uint32_t predicate_index, std::size_t &pc)
+    {
+	const Predicate &target = m_predicates[predicate_index];
+	const std::vector<std::uint32_t> *candidates = &target.clauses;
+	if(target.arity > 0 && !target.by_key.empty()) {
+	    Cell first = deref(m_registers[0]);
+	    if(first.tag() != Tag::Ref) {
+		auto match = target.by_key.find(key_of(first));
+		candidates = match != target.by_key.end() ? &match->second : &target.variable_first;
+	    }
+	}
+	if(candidates->empty())
+	    return false;
+	if(candidates->size() > 1) {
+	    ChoicePoint choice{m_env, m_continuation, m_cut_barrier, m_trail.size(), m_heap.size(),
+			       stack_top(), m_saved_args.size(), candidates, 1, target.arity};
+	    m_saved_args.insert(m_saved_args.end(), m_registers.begin(), m_registers.begin() + target.arity);
+	    m_choices.push_back(choice);
+	}
+	pc = (*candidates)[0];
+	return true;
+    }
+
+    void unwind_trail(std::size_t top)
+    {
+	while(m_trail.size() > top) {
+	    m_heap[m_trail.back().first] = m_trail.back().second;
+	    m_trail.pop_back();
+	}
+    }
+
+    // Resumes at the next alternative of the newest choice point
+    bool backtrack(std::size_t &pc)
+    {
+	if(m_choices.empty())
+	    return false;
+	ChoicePoint &choice = m_choices.back();
+	std::copy(m_saved_args.begin() + choice.args_offset,
+		  m_saved_args.begin() + choice.args_offset + choice.arity, m_registers.begin());
+	m_env = choice.env;
+	m_continuation = choice.continuation;
+	m_cut_barrier = choice.cut_barrier;
+	unwind_trail(choice.trail_top);
+	m_heap.resize(choice.heap_top);
+	pc = (*choice.alternatives)[choice.next];
+	if(++choice.next == choice.alternatives->size()) {
+	    m_saved_args.resize(choice.args_offset);
+	    m_choices.pop_back();
+	}
+	return true;
+    }
+
+    void cut(std::size_t barrier)
+    {
+	if(barrier < m_choices.size()) {
+	    m_saved_args.resize(m_choices[barrier].args_offset);
+	    m_choices.resize(barrier);
+	}
+    }
+
+    struct Number {
+	bool is_real;
+	long long integer;
+	double real;
+
+	double as_real() const { return is_real ? real : static_cast<double>(integer); }
+    };
+
+    bool evaluate(Cell cell, Number &result) const
+    {
+	cell = deref(cell);
+	if(cell.tag() == Tag::Int || cell.tag() == Tag::BigInt) {
+	    result = {false, integer_of(cell), 0};
+	    return true;
+	}
+	if(cell.tag() == Tag::Real) {
+	    result = {true, 0, real_of(cell)};
+	    return true;
+	}
+	if(cell.tag() != Tag::Struct)
+	    return false;
+	auto op = m_arithmetic.find(m_heap[cell.address()].id());
+	if(op == m_arithmetic.end())
+	    return false;
+	Number left, right{false, 0, 0};
+	if(!evaluate(m_heap[cell.address() + 1], left))
+	    return false;
+	// Integer results that overflow fail the goal
+	if(op->second == Arithmetic::Negate) {
+	    if(left.is_real) {
+		result = {true, 0, -left.real};
+		return true;
+	    }
+	    result = {false, 0, 0};
+	    return !__builtin_sub_overflow(0LL, left.integer, &result.integer);
+	}
+	if(!evaluate(m_heap[cell.address() + 2], right))
+	    return false;
+	bool is_real = left.is_real || right.is_real;
+	double a = left.as_real(), b = right.as_real();
+	long long i = left.integer, j = right.integer;
+	switch(op->second) {
+	case Arithmetic::Add:
+	    result = {is_real, 0, a + b};
+	    return is_real || !__builtin_add_overflow(i, j, &result.integer);
+	case Arithmetic::Subtract:
+	    result = {is_real, 0, a - b};
+	    return is_real || !__builtin_sub_overflow(i, j, &result.integer);
+	case Arithmetic::Multiply:
+	    result = {is_real, 0, a * b};
+	    return is_real || !__builtin_mul_overflow(i, j, &result.integer);
+	case Arithmetic::Divide:
+	    result = {true, 0, a / b};
+	    return b != 0;
+	default: {
+	    if(is_real || j == 0)
+		return false;
+	    if(j == -1) {
+		// i / -1 overflows for the smallest i, and i % -1 is 0
+		result = {false, 0, 0};
+		return op->second != Arithmetic::IntDivide
+		    || !__builtin_sub_overflow(0LL, i, &result.integer);
+	    }
+	    long long remainder = i % j;
+	    if(op->second == Arithmetic::Mod && remainder != 0 && (remainder < 0) != (j < 0))
+		remainder += j;
+	    result = {false, op->second == Arithmetic::IntDivide ? i / j : remainder, 0};
+	    return true;
+	}
+	}
+    }
+
+    bool compare(Builtin builtin)
+    {
+	Number left, right;
+	if(!evaluate(m_registers[0], left) || !evaluate(m_registers[1], right))
+	    return false;
+	int order;
+	if(left.is_real || right.is_real)
+	    order = left.as_real() < right.as_real() ? -1 : left.as_real() > right.as_real();
+	else
+	    order = left.integer < right.integer ? -1 : left.integer > right.integer;
+	switch(builtin) {
+	case Builtin::Less: return order < 0;
+	case Builtin::Greater: return order > 0;
+	case Builtin::LessOrEqual: return order <= 0;
+	case Builtin::GreaterOrEqual: return order >= 0;
+	case Builtin::Equal: return order == 0;
+	default: return order != 0;
+	}
+    }
+
+    bool call_builtin(Builtin builtin)
+    {
+	switch(builtin) {
+	case Builtin::True:
+	    return true;
+	case Builtin::Fail:
+	    return false;
+	case Builtin::Unify:
+	    return unify(m_registers[0], m_registers[1]);
+	case Builtin::NotUnify: {
+	    // Unifies, then undoes every binding
+	    std::size_t trail_top = m_trail.size(), heap_top = m_heap.size();
+	    auto saved = m_trail_all_below;
+	    m_trail_all_below = heap_top;
+	    bool unifies = unify(m_registers[0], m_registers[1]);
+	    m_trail_all_below = saved;
+	    unwind_trail(trail_top);
+	    m_heap.resize(heap_top);
+	    return !unifies;
+	}
+	case Builtin::Is: {
+	    Number value;
+	    if(!evaluate(m_registers[1], value))
+		return false;
+	    return unify(m_registers[0], value.is_real ? make_real(value.real) : make_integer(value.integer));
+	}
+	default:
+	    return compare(builtin);
+	}
+    }
+
+    // Executes from pc until Halt (true) or until every alternative failed
+    bool run(std::size_t pc)
+    {
+	bool is_writing = false;
+	std::size_t next_arg = 0;
+	while(true) {
+	    const Instruction &op = m_code[pc++];
+	    bool ok = true;
+	    switch(op.op) {
+	    case Op::GetVariableX:
+		m_registers[op.a] = m_registers[op.b];
+		break;
+	    case Op::GetVariableY:
+		permanent(op.a) = m_registers[op.b];
+		break;
+	    case Op::GetValueX:
+		ok = unify(m_registers[op.a], m_registers[op.b]);
+		break;
+	    case Op::GetValueY:
+		ok = unify(permanent(op.a), m_registers[op.b]);
+		break;
+	    case Op::GetConstant: {
+		Cell cell = deref(m_registers[op.b]);
+		if(cell.tag() == Tag::Ref)
+		    bind(cell.address(), op.constant);
+		else
+		    ok = same_constant(cell, op.constant);
+		break;
+	    }
+	    case Op::GetStructure: {
+		Cell cell = deref(m_registers[op.a]);
+		if(cell.tag() == Tag::Ref) {
+		    std::size_t address = m_heap.size();
+		    m_heap.push_back(Cell::functor(op.b));
+		    bind(cell.address(), Cell::structure(address));
+		    is_writing = true;
+		} else if(cell.tag() == Tag::Struct && m_heap[cell.address()].id() == op.b) {
+		    next_arg = cell.address() + 1;
+		    is_writing = false;
+		} else {
+		    ok = false;
+		}
+		break;
+	    }
+	    case Op::UnifyVariableX:
+	    case Op::UnifyVariableY: {
+		Cell &target = op.op == Op::UnifyVariableX ? m_registers[op.a] : permanent(op.a);
+		target = is_writing ? Cell::ref(new_variable()) : m_heap[next_arg++];
+		break;
+	    }
+	    case Op::UnifyValueX:
+	    case Op::UnifyValueY: {
+		Cell value = op.op == Op::UnifyValueX ? m_registers[op.a] : permanent(op.a);
+		if(is_writing)
+		    m_heap.push_back(value);
+		else
+		    ok = unify(value, m_heap[next_arg++]);
+		break;
+	    }
+	    case Op::UnifyConstant:
+		if(is_writing) {
+		    m_heap.push_back(op.constant);
+		} else {
+		    Cell cell = deref(m_heap[next_arg++]);
+		    if(cell.tag() == Tag::Ref)
+			bind(cell.address(), op.constant);
+		    else
+			ok = same_constant(cell, op.constant);
+		}
+		break;
+	    case Op::UnifyVoid:
+		if(is_writing)
+		    new_variable();
+		else
+		    ++next_arg;
+		break;
+	    case Op::PutVariableX:
+		m_registers[op.a] = m_registers[op.b] = Cell::ref(new_variable());
+		break;
+	    case Op::PutVariableY:
+		permanent(op.a) = m_registers[op.b] = Cell::ref(new_variable());
+		break;
+	    case Op::PutValueX:
+		m_registers[op.b] = m_registers[op.a];
+		break;
+	    case Op::PutValueY:
+		m_registers[op.b] = permanent(op.a);
+		break;
+	    case Op::PutConstant:
+		m_registers[op.b] = op.constant;
+		break;
+	    case Op::PutStructure:
+		m_registers[op.a] = Cell::structure(m_heap.size());
+		m_heap.push_back(Cell::functor(op.b));
+		break;
+	    case Op::SetVariableX:
+		m_registers[op.a] = Cell::ref(new_variable());
+		break;
+	    case Op::SetVariableY:
+		permanent(op.a) = Cell::ref(new_variable());
+		break;
+	    case Op::SetValueX:
+		m_heap.push_back(m_registers[op.a]);
+		break;
+	    case Op::SetValueY:
+		m_heap.push_back(permanent(op.a));
+		break;
+	    case Op::SetConstant:
+		m_heap.push_back(op.constant);
+		break;
+	    case Op::Allocate: {
+		std::size_t frame = stack_top();
+		if(m_stack.size() < frame + frame_header + op.a)
+		    m_stack.resize(std::max(frame + frame_header + op.a, m_stack.size() * 2));
+		m_stack[frame] = Cell::raw(m_env);
+		m_stack[frame + 1] = Cell::raw(m_continuation);
+		m_stack[frame + 2] = Cell::raw(m_cut_barrier);
+		m_stack[frame + 3] = Cell::raw(op.a);
+		m_env = frame;
+		break;
+	    }
+	    case Op::Deallocate:
+		m_continuation = static_cast<std::size_t>(m_stack[m_env + 1].bits());
+		m_env = static_cast<std::size_t>(m_stack[m_env].bits());
+		break;
+	    case Op::Call:
+		++m_inference_count;
+		m_continuation = pc;
+		m_cut_barrier = m_choices.size();
+		ok = dispatch(op.b, pc);
+		break;
+	    case Op::Proceed:
+		pc = m_continuation;
+		break;
+	    case Op::Builtin:
+		++m_inference_count;
+		ok = call_builtin(static_cast<Builtin>(op.b));
+		break;
+	    case Op::Cut:
+		cut(op.a ? static_cast<std::size_t>(m_stack[m_env + 2].bits()) : m_cut_barrier);
+		break;
+	    case Op::Halt:
+		return true;
+	    }
+	    if(!ok && !backtrack(pc))
+		return false;
+	}
+    }
+
+    void reset()
+    {
+	m_heap.resize(m_constant_top);
+	m_stack.clear();
+	m_choices.clear();
+	m_saved_args.clear();
+	m_trail.clear();
+	m_env = no_frame;
+	m_continuation = 0;
+	m_cut_barrier = 0;
+    }
+
+    void write(Cell cell, std::string &out) const
+    {
+	cell = deref(cell);
+	switch(cell.tag()) {
+	case Tag::Ref:
+	    out += "_G" + std::to_string(cell.address());
+	    break;
+	case Tag::Atom:
+	    out += m_symbols.name(Symbol{cell.id()});
+	    break;
+	case Tag::Int:
+	case Tag::BigInt:
+	    out += std::to_string(integer_of(cell));
+	    break;
+	case Tag::Real: {
+	    std::ostringstream text;
+	    text << real_of(cell);
+	    out += text.str();
+	    break;
+	}
+	case Tag::Struct: {
+	    auto [name, arity] = m_functors[m_heap[cell.address()].id()];
+	    if(m_symbols.name(name) == "." && arity == 2) {
+		out += '[';
+		while(true) {
+		    write(m_heap[cell.address() + 1], out);
+		    Cell tail = deref(m_heap[cell.address() + 2]);
+		    if(tail.tag() == Tag::Struct && m_heap[tail.address()].id() == m_heap[cell.address()].id()) {
+			out += ", ";
+			cell = tail;
+			continue;
+		    }
+		    if(!(tail.tag() == Tag::Atom && m_symbols.name(Symbol{tail.id()}) == "[]")) {
+			out += '|';
+			write(tail, out);
+		    }
+		    break;
+		}
+		out += ']';
+		break;
+	    }
+	    out += m_symbols.name(name);
+	    out += '(';
+	    for(std::size_t i = 1; i <= arity; ++i) {
+		if(i > 1)
+		    out += ", ";
+		write(m_heap[cell.address() + i], out);
+	    }
+	    out += ')';
+	    break;
+	}
+	case Tag::Functor:
+	    break;
+	}
+    }
+
+    // A Database param as a term; false for types the machine can't hold
+    bool to_term(const IVariable &param, const SymbolTable &symbols, std::uint32_t &variable_count,
+		 Term &term)
+    {
+	if(auto *variable = dynamic_cast<const LogicVariable*>(&param)) {
+	    term = Term{Term::Kind::Variable, static_cast<std::uint32_t>(variable->slot()), Cell(), {}};
+	    variable_count = std::max(variable_count, term.id + 1);
+	    return true;
+	}
+	if(param.is_constrained())
+	    return false;
+	if(!param.is_unified()) {
+	    // Type<T>: any value
+	    term = Term{Term::Kind::Variable, variable_count++, Cell(), {}};
+	    return true;
+	}
+	term = Term{Term::Kind::Constant, 0, Cell(), {}};
+	if(auto *integer = dynamic_cast<const Variable<int>*>(&param))
+	    term.constant = constant(integer->value());
+	else if(auto *big = dynamic_cast<const Variable<long long>*>(&param))
+	    term.constant = constant(big->value());
+	else if(auto *real = dynamic_cast<const Variable<double>*>(&param))
+	    term.constant = constant(real->value());
+	else if(auto *symbol = dynamic_cast<const Variable<Symbol>*>(&param)) {
+	    // A Symbol that symbols never interned names nothing
+	    if(symbol->value().id >= symbols.size())
+		return false;
+	    term.constant = Cell::atom(m_symbols.intern(symbols.name(symbol->value())));
+	}
+	else if(auto *text = dynamic_cast<const Variable<std::string>*>(&param))
+	    term.constant = Cell::atom(m_symbols.intern(text->value()));
+	else
+	    return false;
+	return true;
+    }
+
+    bool to_goal(const RuleVariable &source, const SymbolTable &symbols, std::uint32_t &variable_count,
+		 Term &goal)
+    {
+	if(source.arity() == 0) {
+	    goal = Term{Term::Kind::Constant, 0, Cell::atom(m_symbols.intern(source.name())), {}};
+	    functor(source.name(), 0);
+	    return true;
+	}
+	goal = Term{Term::Kind::Compound, functor(source.name(), static_cast<std::uint32_t>(source.arity())),
+		    Cell(), std::vector<Term>(source.arity())};
+	for(std::size_t i = 0; i < source.arity(); ++i) {
+	    if(!to_term(*source[i], symbols, variable_count, goal.args[i]))
+		return false;
+	}
+	return true;
+    }
+
+    bool add(const Term &head, const std::vector<Term> &body, std::size_t variable_count)
+    {
+	std::uint32_t address;
+	if(!ClauseCompiler{*this}.compile(&head, body, variable_count, address))
+	    return false;
+	std::uint32_t id = head.kind == Term::Kind::Compound ? head.id : functor(Symbol{head.constant.id()}, 0);
+	add_clause(id, head.args.empty() ? nullptr : &head.args[0], address);
+	return true;
+    }
+
+    // Runs body as a query, calling visit() after each solution until it
+    // returns true; returns whether there was a solution. Afterwards drops
+    // the query's code and the numbers boxed above constant_top
+    template<typename Visitor>
+    bool solve(const std::vector<Term> &body, std::size_t variable_count, std::size_t constant_top,
+	       Visitor visit)
+    {
+	std::size_t code_size = m_code.size();
+	std::uint32_t address;
+	bool found = false;
+	if(ClauseCompiler{*this}.compile(nullptr, body, variable_count, address)) {
+	    reset();
+	    std::size_t pc = address;
+	    while(run(pc)) {
+		found = true;
+		if(visit() || !backtrack(pc))
+		    break;
+	    }
+	}
+	m_code.resize(code_size);
+	m_constant_top = constant_top;
+	reset();
+	return found;
+    }
+
+    // Runs conjecture as a query, calling visit(goal) with its term after
+    // each solution until it returns true
+    template<typename Visitor>
+    bool solve(const RuleVariable &conjecture, const SymbolTable &symbols, Visitor visit)
+    {
+	std::size_t constant_top = m_constant_top;
+	std::uint32_t variable_count = 0;
+	for(std::size_t i = 0; i < conjecture.arity(); ++i) {
+	    if(auto *variable = dynamic_cast<const LogicVariable*>(conjecture[i]))
+		variable_count = std::max(variable_count, static_cast<std::uint32_t>(variable->slot() + 1));
+	}
+	std::vector<Term> body(1);
+	if(!to_goal(conjecture, symbols, variable_count, body[0])) {
+	    m_constant_top = constant_top;
+	    reset();
+	    return false;
+	}
+	return solve(body, variable_count, constant_top, [&] { return visit(static_cast<const Term&>(body[0])); });
+    }
+
+    // A cell's value as a Variable of param's type (T for a Type<T>), or of
+    // the narrowest type that holds it if param is a Var. Null if cell is
+    // unbound, compound or of another type
+    std::unique_ptr<IVariable> to_variable(const IVariable &param, Cell cell, SymbolTable &symbols) const
+    {
+	cell = deref(cell);
+	bool untyped = typeid(param) == typeid(LogicVariable);
+	if(cell.tag() == Tag::Int || cell.tag() == Tag::BigInt) {
+	    long long value = integer_of(cell);
+	    if((untyped || typeid(param) == typeid(Variable<int>))
+	       && value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max())
+		return std::make_unique<Variable<int>>(static_cast<int>(value));
+	    if(untyped || typeid(param) == typeid(Variable<long long>))
+		return std::make_unique<Variable<long long>>(value);
+	} else if(cell.tag() == Tag::Real) {
+	    if(untyped || typeid(param) == typeid(Variable<double>))
+		return std::make_unique<Variable<double>>(real_of(cell));
+	} else if(cell.tag() == Tag::Atom) {
+	    auto name = m_symbols.name(Symbol{cell.id()});
+	    if(untyped || typeid(param) == typeid(Variable<Symbol>))
+		return std::make_unique<Variable<Symbol>>(symbols.intern(name));
+	    if(typeid(param) == typeid(Variable<std::string>))
+		return std::make_unique<Variable<std::string>>(std::string(name));
+	}
+	return nullptr;
+    }
+public:
+    AbstractMachine()
+    {
+	const std::pair<const char*, std::pair<std::uint32_t, Builtin>> builtins[] = {
+	    {"true", {0, Builtin::True}}, {"fail", {0, Builtin::Fail}}, {"=", {2, Builtin::Unify}},
+	    {"\\=", {2, Builtin::NotUnify}}, {"is", {2, Builtin::Is}}, {"<", {2, Builtin::Less}},
+	    {">", {2, Builtin::Greater}}, {"=<", {2, Builtin::LessOrEqual}},
+	    {">=", {2, Builtin::GreaterOrEqual}}, {"=:=", {2, Builtin::Equal}},
+	    {"=\\=", {2, Builtin::NotEqual}}
+	};
+	for(const auto &[name, builtin] : builtins)
+	    m_builtins.emplace(functor(name, builtin.first), builtin.second);
+	m_cut = functor("!", 0);
+	const char *operators[] = {"+", "-", "*", "/", "//", "mod"};
+	for(std::size_t i = 0; i < 6; ++i)
+	    m_arithmetic.emplace(functor(operators[i], 2), static_cast<Arithmetic>(i));
+	m_arithmetic.emplace(functor("-", 1), Arithmetic::Negate);
+	m_registers.resize(8);
+    }
+
+    // Compiles the clauses in text, written in Prolog syntax: unlike in
+    // Database::load(), variables start with an uppercase letter or _
+    LoadResult consult(std::string_view text)
+    {
+	LoadResult result;
+	result.byte_count = text.size();
+	Parser parser{*this, text};
+	Term head;
+	std::vector<Term> body;
+	while(!parser.at_end()) {
+	    if(!parser.parse_clause(head, body, false)) {
+		result.error = parser.error();
+		result.error_line = parser.line();
+		return result;
+	    }
+	    if(!add(head, body, parser.variables().size())) {
+		result.error = "a goal must be an atom or compound term";
+		result.error_line = parser.line();
+		return result;
+	    }
+	    ++result.clause_count;
+	}
+	return result;
+    }
+
+    // Compiles every clause of db. Returns false if some clause has a param
+    // the machine can't hold (a constrained Variable, or a type other than
+    // int, long long, double, Symbol and std::string); such clauses are
+    // skipped. db's clauses then get Prolog's semantics: a variable bound by
+    // one goal is bound in the goals after it
+    bool load(const Database &db)
+    {
+	bool supported = true;
+	db.for_each_rule([&](const Rule &rule) {
+	    std::uint32_t variable_count = 0;
+	    for(std::size_t i = 0; i < rule.arity(); ++i) {
+		if(auto *variable = dynamic_cast<const LogicVariable*>(rule[i]))
+		    variable_count = std::max(variable_count, static_cast<std::uint32_t>(variable->slot() + 1));
+	    }
+	    for(const auto &goal : rule.predicates()) {
+		for(std::size_t i = 0; i < goal.arity(); ++i) {
+		    if(auto *variable = dynamic_cast<const LogicVariable*>(goal[i]))
+			variable_count = std::max(variable_count,
+						  static_cast<std::uint32_t>(variable->slot() + 1));
+		}
+	    }
+	    Term head;
+	    std::vector<Term> body(rule.predicates().size());
+	    bool converted = to_goal(rule, db.symbols(), variable_count, head);
+	    for(std::size_t i = 0; i < body.size() && converted; ++i)
+		converted = to_goal(rule.predicates()[i], db.symbols(), variable_count, body[i]);
+	    if(!converted || !add(head, body, variable_count))
+		supported = false;
+	});
+	return supported;
+    }
+
+    // Calls visit(answer) for each solution of goals (e.g. "app(X, Y, [1])"),
+    // until visit returns true. Returns false if goals don't parse
+    template<typename Visitor>
+    bool for_each_solution(std::string_view goals, Visitor visit)
+    {
+	std::size_t constant_top = m_constant_top;
+	Parser parser{*this, goals};
+	Term unused;
+	std::vector<Term> body;
+	if(!parser.parse_clause(unused, body, true)) {
+	    m_constant_top = constant_top;
+	    reset();
+	    return false;
+	}
+	auto names = parser.variables();
+	solve(body, names.size(), constant_top, [&] {
+	    Answer answer;
+	    for(std::uint32_t i = 0; i < names.size(); ++i) {
+		if(names[i] == "_")
+		    continue;
+		answer.emplace_back(names[i], std::string());
+		write(permanent(i), answer.back().second);
+	    }
+	    return visit(static_cast<const Answer&>(answer));
+	});
+	return true;
+    }
+
+    bool query(std::string_view goals)
+    {
+	bool found = false;
+	for_each_solution(goals, [&](const Answer&) { return found = true; });
+	return found;
+    }
+
+    // Proves conjecture with Prolog's semantics; Vars and Type<>s are
+    // variables that may be bound to anything, and Symbols are names in
+    // symbols
+    bool query(const RuleVariable &conjecture, const SymbolTable &symbols)
+    {
+	return solve(conjecture, symbols, [](const Term&) { return true; });
+    }
+
+    // Calls visit(solution) for each solution of conjecture until it returns
+    // true, and returns whether there was one. solution is conjecture with
+    // each Var and Type<> it could give a Variable replaced by that Variable
+    // (see to_variable()); atoms become Symbols of symbols
+    template<typename Visitor>
+    bool for_each_solution(const RuleVariable &conjecture, SymbolTable &symbols, Visitor visit)
+    {
+	return solve(conjecture, symbols, [&](const Term &goal) {
+	    RuleVariable solution{conjecture.name()};
+	    for(std::size_t i = 0; i < conjecture.arity(); ++i) {
+		std::unique_ptr<IVariable> value;
+		if(goal.args[i].kind == Term::Kind::Variable)
+		    value = to_variable(*conjecture[i], permanent(goal.args[i].id), symbols);
+		solution.add_param(value ? std::move(value) : conjecture[i]->clone());
+	    }
+	    return visit(static_cast<const RuleVariable&>(solution));
+	});
+    }
+
+    SymbolTable& symbols() { return m_symbols; }
+
+    // Calls and builtins executed so far, for measuring LIPS
+    std::size_t inference_count() const { return m_inference_count; }
+
+    std::size_t code_size() const { return m_code.size(); }
+
+    // Cells on the heap, including the boxes of the loaded clauses' numbers;
+    // during a solution, this measures the memory its terms take
+    std::size_t heap_size() const { return m_heap.size(); }
 };
 #endif
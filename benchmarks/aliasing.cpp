@@ -0,0 +1,93 @@
+/*
+  Measures chains of aliased variables: n unbound variables are unified
+  pairwise, last pair first (so that each link points further down the
+  chain), then one of them is bound and every one is read back. Bindings
+  (union-find with path compression) is compared with a store that only
+  follows parent links, and the AbstractMachine runs the same chain as a
+  Prolog program. Times are per variable, so they stay flat as n grows if
+  aliasing is near O(1).
+  Usage: aliasing [largest n] (default 100000).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+    const char *program = R"(
+alias([_]).
+alias([X, Y|T]) :- alias([Y|T]), X = Y.
+all([], _).
+all([X|T], X) :- all(T, X).
+chain(N) :- length(N, L), alias(L), L = [V|_], V = 1, all(L, 1).
+length(0, []) :- !.
+length(N, [_|T]) :- M is N - 1, length(M, T).
+)";
+
+    using Clock = std::chrono::steady_clock;
+
+    // Variables that point at what they were unified with, and nothing else
+    struct Links {
+	std::vector<std::size_t> parent;
+	std::vector<int> value;
+
+	std::size_t root(std::size_t slot) const
+	{
+	    while(parent[slot] != slot)
+		slot = parent[slot];
+	    return slot;
+	}
+    };
+
+    template<typename Body>
+    double ns_per(std::size_t n, Body body)
+    {
+	auto start = Clock::now();
+	body();
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(n);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    AbstractMachine machine;
+    if(!machine.consult(program))
+	return 1;
+    Variable<int> one{1};
+    for(std::size_t n = 1000; n <= largest; n *= 10) {
+	std::cout << "n = " << n << ":\n";
+	long checksum = 0;
+	double bindings_time = ns_per(n, [&] {
+	    Bindings bindings;
+	    bindings.add(n);
+	    for(std::size_t i = n - 1; i > 0; --i)
+		bindings.unify(i, i - 1);
+	    bindings.bind(n - 1, one);
+	    for(std::size_t i = 0; i < n; ++i)
+		checksum += bindings.is_bound(i);
+	});
+	std::cout << "  Bindings:    " << bindings_time << " ns per variable\n";
+
+	double links_time = ns_per(n, [&] {
+	    Links links{std::vector<std::size_t>(n), std::vector<int>(n, 0)};
+	    for(std::size_t i = 0; i < n; ++i)
+		links.parent[i] = i;
+	    for(std::size_t i = n - 1; i > 0; --i)
+		links.parent[links.root(i)] = links.root(i - 1);
+	    links.value[links.root(n - 1)] = 1;
+	    for(std::size_t i = 0; i < n; ++i)
+		checksum += links.value[links.root(i)];
+	});
+	std::cout << "  plain links: " << links_time << " ns per variable\n";
+
+	double machine_time = ns_per(n, [&] {
+	    std::string goal = "chain(" + std::to_string(n) + ")";
+	    checksum += machine.query(std::string_view(goal));
+	});
+	std::cout << "  machine:     " << machine_time << " ns per variable\n";
+	if(checksum != static_cast<long>(2 * n + 1))
+	    return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef BACKTRACK_ALLOC_COUNTER_H
+#define BACKTRACK_ALLOC_COUNTER_H
+/* Counts heap bytes so the benchmarks can report memory without needing
+   platform-specific tools. Include in exactly one translation unit. */
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+inline std::size_t g_allocated_bytes = 0;
+inline std::size_t g_allocation_count = 0;
+
+[[gnu::noinline]] void* operator new(std::size_t size)
+{
+    g_allocated_bytes += size;
+    ++g_allocation_count;
+    // Store the size in front of the block so delete can subtract it
+    auto *block = static_cast<std::size_t*>(std::malloc(size + sizeof(std::max_align_t)));
+    if(!block)
+	throw std::bad_alloc();
+    *block = size;
+    return reinterpret_cast<char*>(block) + sizeof(std::max_align_t);
+}
+
+[[gnu::noinline]] void operator delete(void *ptr) noexcept
+{
+    if(!ptr)
+	return;
+    auto *block = reinterpret_cast<std::size_t*>(static_cast<char*>(ptr) - sizeof(std::max_align_t));
+    g_allocated_bytes -= *block;
+    std::free(block);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept { operator delete(ptr); }
+#endif
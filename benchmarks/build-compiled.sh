@@ -0,0 +1,10 @@
+#!/usr/bin/env sh
+# Builds compile-rules (see ../build-compile-rules.sh), compiles the rules in
+# rules/ with it and builds the benchmarks that use the generated code
+set -e
+../build-compile-rules.sh
+mkdir -p generated
+for rules in rules/*.dl; do
+    ../compile-rules "$rules" "generated/$(basename "$rules" .dl).hpp"
+done
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -I.. -o aot-rules aot-rules.cpp
@@ -0,0 +1,25 @@
+#!/usr/bin/env sh
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o snapshot snapshot.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o bulk-load bulk-load.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o load load.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -pthread -o parallel-load parallel-load.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o cold-start cold-start.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o join-order join-order.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o magic-sets magic-sets.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o triangles triangles.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o columnar-facts columnar-facts.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o scan-kernels scan-kernels.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o negative-lookups negative-lookups.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o ground-lookups ground-lookups.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o range-probes range-probes.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o head-index head-index.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o frozen frozen.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o enum-names enum-names.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o relations relations.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o compiled-rules compiled-rules.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o lips lips.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o cells cells.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o aliasing aliasing.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -pthread -o concurrent-queries concurrent-queries.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o resolution-steps resolution-steps.cpp
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -o tail-calls tail-calls.cpp
@@ -0,0 +1,46 @@
+/*
+  Compares loading ground facts one add_rule() at a time with loading them
+  through a single Database::Batch. Usage: bulk-load [fact count]
+  (default 10^7).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    std::size_t fact_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    constexpr int predicate_count = 100;
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<Rule> facts;
+    facts.reserve(fact_count);
+    for(std::size_t i = 0; i < fact_count; ++i) {
+	int value = static_cast<int>(i);
+	facts.emplace_back("p" + std::to_string(i % predicate_count), value, value / 2);
+    }
+
+    auto start = Clock::now();
+    {
+	Database db;
+	for(auto &fact : facts)
+	    db.add_rule(fact);
+    }
+    double one_at_a_time = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    Database db;
+    auto batch = db.begin_batch();
+    for(auto &fact : facts)
+	batch.add_rule(fact);
+    std::size_t added = batch.commit();
+    double batched = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << "facts:           " << fact_count << '\n'
+	      << "add_rule():      " << fact_count / one_at_a_time << " facts/s\n"
+	      << "Batch::commit(): " << fact_count / batched << " facts/s ("
+	      << added << " added after deduplication)\n"
+	      << "sanity query:    " << db.query("p3", 3, 1) << '\n';
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+  Measures the AbstractMachine's tagged 64-bit cells against the Variable<T>
+  params a Database holds: bytes per term, and how fast each unifies. The
+  machine builds two lists of n integers and unifies them 20 times (timed
+  as the difference from unifying them once), where the Database side
+  checks can_unify() on n pairs of Variable<int>s.
+  Usage: cells [n] (default 1000000).
+*/
+#include "../backtrack.hpp"
+#include "alloc-counter.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+    const char *program = R"(
+numbers(0, []) :- !.
+numbers(N, [N|T]) :- M is N - 1, numbers(M, T).
+build(N, K) :- numbers(N, A), numbers(N, B), unify(K, A, B).
+unify(0, _, _) :- !.
+unify(K, A, B) :- A = B, J is K - 1, unify(J, A, B).
+)";
+
+    using Clock = std::chrono::steady_clock;
+
+    double time_query(AbstractMachine &machine, std::string_view goals)
+    {
+	auto start = Clock::now();
+	if(!machine.query(goals))
+	    std::exit(1);
+	return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? std::atol(argv[1]) : 1000000;
+    AbstractMachine machine;
+    if(!machine.consult(program))
+	return 1;
+
+    // Memory per term
+    std::cout << "sizeof(AbstractMachine::Cell):  " << sizeof(AbstractMachine::Cell) << " bytes\n";
+    std::size_t list_cells = 0, base = machine.heap_size();
+    machine.for_each_solution("numbers(" + std::to_string(n) + ", L)", [&](const AbstractMachine::Answer&) {
+	list_cells = machine.heap_size() - base;
+	return true;
+    });
+    std::cout << "machine list element:           "
+	      << static_cast<double>(list_cells * sizeof(AbstractMachine::Cell)) / static_cast<double>(n)
+	      << " bytes (24 for the list cell, the rest for M is N - 1)\n";
+    // Ints and atoms fit in their cell; the others add a box
+    base = machine.heap_size();
+    machine.consult("big(4611686018427387904). real(0.5). small(7). atom(a).\n");
+    std::cout << "machine int, atom:              8 bytes\n"
+	      << "machine big int, double:        "
+	      << 8 + (machine.heap_size() - base) * sizeof(AbstractMachine::Cell) / 2 << " bytes\n";
+
+    std::size_t before = g_allocated_bytes;
+    {
+	RuleVariable ints{"p"}, symbols{"p"};
+	for(long i = 0; i < 1000; ++i) {
+	    ints.add_param(static_cast<int>(i));
+	    symbols.add_param(Symbol{static_cast<std::uint32_t>(i)});
+	}
+	std::size_t after = g_allocated_bytes;
+	// Each param also takes a unique_ptr in the params vector
+	std::cout << "Variable<int>, Variable<Symbol>: "
+		  << static_cast<double>(after - before) / 2000 << " bytes ("
+		  << sizeof(Variable<int>) << " + " << sizeof(std::unique_ptr<IVariable>)
+		  << " + allocator overhead)\n";
+    }
+
+    // Unification throughput
+    std::string count = std::to_string(n);
+    // The first run also grows the heap
+    time_query(machine, "build(" + count + ", 1)");
+    double once = time_query(machine, "build(" + count + ", 1)");
+    double twenty = time_query(machine, "build(" + count + ", 20)");
+    std::cout << "machine:  " << static_cast<double>(n) * 19 / (twenty - once) / 1e6
+	      << "M list elements unified/s\n";
+
+    std::vector<std::unique_ptr<IVariable>> left, right;
+    for(long i = 0; i < n; ++i) {
+	left.emplace_back(new Variable<int>(static_cast<int>(i)));
+	right.emplace_back(i % 2 ? new Variable<int>(static_cast<int>(i)) : new Variable<int>());
+    }
+    auto start = Clock::now();
+    long unified = 0;
+    for(long i = 0; i < n; ++i)
+	unified += left[i]->can_unify(*right[i]);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "Variable: " << static_cast<double>(n) / seconds / 1e6
+	      << "M can_unify()/s (" << unified << " of " << n << " unify)\n";
+    return 0;
+}
@@ -0,0 +1,51 @@
+/*
+  Compares starting up from a MappedDatabase snapshot (open + first query)
+  with rebuilding the Database from a Prolog-syntax fact file (load + first
+  query). Usage: cold-start [fact count] (default 10^7). Writes facts.pl
+  and facts.snapshot in the working directory.
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    std::size_t fact_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    using Clock = std::chrono::steady_clock;
+    auto seconds_since = [](Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    {
+	std::ofstream out("facts.pl");
+	for(std::size_t i = 0; i < fact_count; ++i)
+	    out << "edge(" << i << ", node" << i % 1000 << ").\n";
+    }
+    int probe = static_cast<int>(fact_count / 2);
+
+    auto start = Clock::now();
+    double rebuild;
+    {
+	Database db;
+	db.load_file("facts.pl");
+	bool found = db.query("edge", probe, Type<Symbol>());
+	rebuild = seconds_since(start);
+	std::cout << "rebuild from source + first query: " << rebuild << " s (" << found << ")\n";
+
+	start = Clock::now();
+	if(!db.save("facts.snapshot")) {
+	    std::cerr << "could not write facts.snapshot\n";
+	    return 1;
+	}
+	std::cout << "save:                              " << seconds_since(start) << " s\n";
+    }
+
+    start = Clock::now();
+    MappedDatabase mapped{"facts.snapshot"};
+    bool found = mapped.query("edge", probe, Type<Symbol>());
+    double cold = seconds_since(start);
+    std::cout << "mmap open + first query:           " << cold << " s (" << found << ")\n"
+	      << "speedup:                           " << rebuild / cold << "x\n";
+    return 0;
+}
@@ -0,0 +1,46 @@
+/*
+  Measures the heap bytes per ground fact and the speed of queries that have
+  to scan every fact (the first param is unbound), for facts stored in
+  columns and for facts kept as Rules. unsigned isn't a column type, so
+  facts of unsigned values stand in for the Rule form. Usage:
+  columnar-facts [fact count] (default 10^6).
+*/
+#include "alloc-counter.hpp"
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+template<typename T>
+void measure(const char *label, std::size_t fact_count)
+{
+    using Clock = std::chrono::steady_clock;
+    std::size_t bytes_before = g_allocated_bytes;
+    Database db;
+    {
+	auto batch = db.begin_batch();
+	for(std::size_t i = 0; i < fact_count; ++i)
+	    batch.add_rule(Rule{"U", static_cast<T>(i), static_cast<T>(i % 1000)});
+	batch.commit();
+    }
+    double bytes = static_cast<double>(g_allocated_bytes - bytes_before);
+
+    // No fact has 1000 as its second param, so every query scans them all
+    constexpr int query_count = 20;
+    std::size_t found = 0;
+    auto start = Clock::now();
+    for(int i = 0; i < query_count; ++i)
+	found += db.query("U", Type<T>(), static_cast<T>(1000));
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << label << bytes / static_cast<double>(fact_count) << " bytes/fact, "
+	      << static_cast<double>(fact_count) * query_count / seconds / 1e6
+	      << "M facts/s scanned (" << found << " found)\n";
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t fact_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    measure<int>("columns: ", fact_count);
+    measure<unsigned>("Rules:   ", fact_count);
+    return 0;
+}
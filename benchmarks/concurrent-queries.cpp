@@ -0,0 +1,69 @@
+/*
+  Measures Database::for_each_solution() from several threads at once on
+  one Database: each query enumerates the descendants of a random node of
+  a binary tree of 2^14 nodes through a recursive Path rule, with its
+  bindings in its own Bindings, so the threads share every Rule and copy
+  none. Prints queries per second for 1, 2, 4, ... threads up to the
+  given count, and the speedup over one thread.
+  Usage: concurrent-queries [max threads] [seconds per run] (defaults:
+  2 x hardware threads, 1).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1]))
+	: 2 * std::max(1u, std::thread::hardware_concurrency());
+    double seconds = argc > 2 ? std::atof(argv[2]) : 1.0;
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int node_count = 1 << 14;
+    Database db;
+    std::string source = "Path(x, y) :- Edge(x, y).\nPath(x, z) :- Edge(x, Y), Path(Y, z).\n";
+    for(int i = 1; i < node_count / 2; ++i)
+	source += "Edge(" + std::to_string(i) + ", " + std::to_string(2 * i) + "). Edge("
+	    + std::to_string(i) + ", " + std::to_string(2 * i + 1) + ").\n";
+    if(!db.load(source))
+	return 1;
+
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << '\n';
+    double single = 0;
+    for(unsigned thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+	std::atomic<std::size_t> queries{0}, solutions{0};
+	std::atomic<bool> stop{false};
+	std::vector<std::thread> workers;
+	auto start = Clock::now();
+	for(unsigned t = 0; t < thread_count; ++t) {
+	    workers.emplace_back([&, t] {
+		std::mt19937 random{t};
+		// Nodes 2^8 and up have at most 62 descendants
+		std::uniform_int_distribution<int> node{1 << 8, node_count / 2 - 1};
+		std::size_t local_queries = 0, local_solutions = 0;
+		while(!stop.load(std::memory_order_relaxed)) {
+		    db.for_each_solution(RuleVariable{"Path", node(random), Var{0}}, [&](const RuleVariable&) {
+			++local_solutions;
+			return false;
+		    });
+		    ++local_queries;
+		}
+		queries += local_queries;
+		solutions += local_solutions;
+	    });
+	}
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	stop = true;
+	for(auto &worker : workers)
+	    worker.join();
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	double rate = static_cast<double>(queries) / elapsed;
+	if(thread_count == 1)
+	    single = rate;
+	std::cout << thread_count << " threads: " << rate << " queries/s, speedup " << rate / single << " ("
+		  << static_cast<double>(solutions) / static_cast<double>(queries) << " solutions per query)\n";
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+  Times ground queries spread over many predicates, in a Database named by
+  strings (a std::map, or a perfect hash once frozen) and in one named by an
+  enum (an array). The conjectures are built beforehand, so the times are
+  mostly predicate dispatch plus a small fact lookup. Usage: enum-names.
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+enum class Name : std::uint32_t { Count = 1000 };
+
+template<typename Names, typename Make>
+void measure(const char *label, Make make_name)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr std::uint32_t predicate_count = static_cast<std::uint32_t>(Name::Count);
+    BasicDatabase<Names> db;
+    for(std::uint32_t p = 0; p < predicate_count; ++p) {
+	for(int i = 0; i < 4; ++i)
+	    db.add_rule(Rule{make_name(p), i});
+    }
+    std::mt19937 random(6);
+    std::uniform_int_distribution<std::uint32_t> any_predicate(0, predicate_count - 1);
+    std::uniform_int_distribution<int> any_value(0, 7);
+    std::vector<RuleVariable> conjectures;
+    for(int i = 0; i < 4096; ++i)
+	conjectures.emplace_back(make_name(any_predicate(random)), any_value(random));
+
+    for(int frozen = 0; frozen < 2; ++frozen) {
+	if(frozen)
+	    db.freeze();
+	constexpr int query_count = 4'000'000;
+	std::size_t found = 0;
+	auto start = Clock::now();
+	for(int i = 0; i < query_count; ++i)
+	    found += db.query(conjectures[i % conjectures.size()]);
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << label << (frozen ? " frozen:  " : " mutable: ") << seconds / query_count * 1e9
+		  << " ns/query (" << found << " found)\n";
+    }
+}
+
+int main()
+{
+    measure<std::string>("string", [](std::uint32_t p) { return "predicate_" + std::to_string(p); });
+    measure<Name>("enum  ", [](std::uint32_t p) { return static_cast<Name>(p); });
+    return 0;
+}
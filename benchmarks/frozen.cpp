@@ -0,0 +1,73 @@
+/*
+  Compares a Database before and after freeze(): heap bytes, and the
+  latency of a mix of ground fact lookups and rule queries whose goals call
+  other predicates. Usage: frozen [predicate count] [facts per predicate]
+  (default 2000 and 500).
+*/
+#include "alloc-counter.hpp"
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+int main(int argc, char **argv)
+{
+    int predicate_count = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int fact_count = argc > 2 ? std::atoi(argv[2]) : 500;
+    using Clock = std::chrono::steady_clock;
+
+    std::size_t bytes_before = g_allocated_bytes;
+    Database db;
+    {
+	auto batch = db.begin_batch();
+	for(int p = 0; p < predicate_count; ++p) {
+	    std::string name = "fact" + std::to_string(p);
+	    for(int i = 0; i < fact_count; ++i)
+		batch.add_rule(Rule{name, i, i * 7 % 1000});
+	    // check<p>(_) :- fact<p>(3, 21), fact<p + 1>(4, 28)
+	    Rule check{"check" + std::to_string(p), Type<int>()};
+	    check << RuleVariable{name, 3, 21}
+		  << RuleVariable{"fact" + std::to_string((p + 1) % predicate_count), 4, 28};
+	    batch.add_rule(std::move(check));
+	}
+	batch.commit();
+    }
+
+    std::vector<std::string> facts, checks;
+    for(int p = 0; p < predicate_count; ++p) {
+	facts.push_back("fact" + std::to_string(p));
+	checks.push_back("check" + std::to_string(p));
+    }
+    auto run = [&](const char *label) {
+	constexpr int query_count = 1'000'000;
+	std::mt19937 random(4);
+	std::uniform_int_distribution<int> any_predicate(0, predicate_count - 1), any_value(0, fact_count * 2);
+	std::size_t found = 0;
+	auto start = Clock::now();
+	for(int i = 0; i < query_count; ++i) {
+	    int p = any_predicate(random);
+	    if(i % 2) {
+		found += db.query(checks[p], i);
+	    } else {
+		int value = any_value(random);
+		found += db.query(facts[p], value, value * 7 % 1000);
+	    }
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	if(label) {
+	    std::cout << label << seconds / query_count * 1e9 << " ns/query, "
+		      << static_cast<double>(g_allocated_bytes - bytes_before) / 1e6 << " MB ("
+		      << found << " found)\n";
+	}
+    };
+    // The first pass also pays for touching every page once
+    run(nullptr);
+    run("mutable: ");
+    auto start = Clock::now();
+    db.freeze();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    run("frozen:  ");
+    std::cout << "freeze(): " << seconds * 1e3 << " ms\n";
+    return 0;
+}
@@ -0,0 +1,47 @@
+/*
+  Looks up fully ground goals in a fact-only predicate whose first param
+  takes few values (E(i % 1000, i)), so the first-param index alone leaves
+  long runs of candidates to check. Usage: ground-lookups [fact count]
+  (default 10^7).
+*/
+#include "alloc-counter.hpp"
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+int main(int argc, char **argv)
+{
+    std::size_t fact_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    using Clock = std::chrono::steady_clock;
+    int count = static_cast<int>(fact_count);
+
+    std::size_t bytes_before = g_allocated_bytes;
+    Database db;
+    {
+	auto batch = db.begin_batch();
+	for(int i = 0; i < count; ++i)
+	    batch.add_rule(Rule{"E", i % 1000, i});
+	batch.commit();
+    }
+    std::cout << "facts:   " << fact_count << ", "
+	      << static_cast<double>(g_allocated_bytes - bytes_before) / static_cast<double>(fact_count)
+	      << " bytes/fact\n";
+
+    constexpr int lookup_count = 1'000'000;
+    std::mt19937 random(11);
+    std::uniform_int_distribution<int> any_fact(0, count - 1);
+    for(bool present : {true, false}) {
+	std::size_t found = 0;
+	auto start = Clock::now();
+	for(int i = 0; i < lookup_count; ++i) {
+	    int second = any_fact(random);
+	    found += db.query("E", (second + !present) % 1000, second);
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << (present ? "present: " : "absent:  ") << seconds / lookup_count * 1e9
+		  << " ns/lookup (" << found << " found)\n";
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+  Queries price(Region, Tier, Product, Amount), whose clauses are all
+  partially ground heads: each leaves some params as placeholders, and few
+  regions exist, so the first param alone hardly narrows them down. Queries
+  name a known product, no product or a product no head names. Usage:
+  head-index [head count] (default 5000).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+int main(int argc, char **argv)
+{
+    std::size_t head_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000;
+    using Clock = std::chrono::steady_clock;
+    auto count = static_cast<std::uint32_t>(head_count);
+
+    // Regions are Symbols 0-3, products Symbols from 100. Most heads are
+    // ground but for the price; the rest leave one more param open
+    Database db;
+    std::mt19937 random(3);
+    std::uniform_int_distribution<std::uint32_t> any_region(0, 3), any_product(0, count - 1);
+    std::uniform_int_distribution<int> any_tier(0, 999), one_in(0, 99);
+    std::vector<std::pair<Symbol, int>> products;
+    {
+	auto batch = db.begin_batch();
+	for(std::uint32_t i = 0; i < count; ++i) {
+	    products.emplace_back(Symbol{any_region(random)}, any_tier(random));
+	    int open = one_in(random);
+	    Rule head{"price"};
+	    if(open < 5)
+		head.add_param(Var{0});
+	    else
+		head.add_param(products.back().first);
+	    if(open >= 5 && open < 15)
+		head.add_param(Type<int>());
+	    else
+		head.add_param(products.back().second);
+	    if(open >= 15 && open < 17)
+		head.add_param(Type<Symbol>());
+	    else
+		head.add_param(Symbol{100 + i});
+	    head.add_param(Type<double>());
+	    batch.add_rule(std::move(head));
+	}
+	batch.commit();
+    }
+
+    constexpr int query_count = 20000;
+    const char *names[] = {"all bound:        ", "product unknown:  ", "absent product:   "};
+    for(int shape = 0; shape < 3; ++shape) {
+	random.seed(8);
+	std::size_t found = 0;
+	auto start = Clock::now();
+	for(int i = 0; i < query_count; ++i) {
+	    std::uint32_t product = any_product(random);
+	    auto [region, tier] = products[product];
+	    RuleVariable conjecture{"price", region, tier};
+	    if(shape == 0)
+		conjecture.add_param(Symbol{100 + product});
+	    else if(shape == 1)
+		conjecture.add_param(Type<Symbol>());
+	    else
+		conjecture.add_param(Symbol{100 + count + product});
+	    conjecture.add_param(9.5);
+	    found += db.query(conjecture);
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << names[shape] << ' ' << seconds / query_count * 1e6 << " us/query ("
+		  << found << " found)\n";
+    }
+    return 0;
+}
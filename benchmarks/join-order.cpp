@@ -0,0 +1,45 @@
+/*
+  Times multi-goal rules whose written order starts with an expensive goal,
+  with the planner's order versus the written order (Rule::keep_order()).
+  Usage: join-order [facts in the large relation] (default 10^5).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    int big_count = argc > 1 ? std::atoi(argv[1]) : 100'000;
+    Database db;
+    std::string source;
+    for(int i = 0; i < big_count; ++i)
+	source += "Big(" + std::to_string(i) + ", " + std::to_string(i % 1000) + ").\n";
+    for(int i = 0; i < 1000; ++i)
+	source += "Mid(" + std::to_string(i) + ", " + std::to_string(i % 100) + ").\n";
+    for(int i = 0; i < 10; ++i)
+	source += "Small(" + std::to_string(i) + ", " + std::to_string(i) + ").\n";
+    // The last goal fails, but only after a full scan of Big
+    source += "Planned(x) :- Big(Y, 5000), Mid(Z, 7), Small(x, 99).\n";
+    if(!db.load(source))
+	return 1;
+
+    // Written gets the same body but keeps its order
+    Rule written{"Written", Var{0}};
+    written << RuleVariable{"Big", Var{1}, 5000} << RuleVariable{"Mid", Var{2}, 7}
+	    << RuleVariable{"Small", Var{0}, 99};
+    written.keep_order();
+    db.add_rule(written);
+
+    std::cout << db.explain(RuleVariable{"Planned", 42});
+    for(const char *name : {"Written", "Planned"}) {
+	constexpr int query_count = 200;
+	int found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < query_count; ++i)
+	    found += db.query(name, 1000 + i);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << name << ": " << query_count / seconds << " queries/s (" << found << " true)\n";
+    }
+    return 0;
+}
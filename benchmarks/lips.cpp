@@ -0,0 +1,98 @@
+/*
+  Measures the AbstractMachine's speed in logical inferences per second
+  (calls, including arithmetic and comparisons) on standard Prolog
+  benchmarks: naive reverse of a 30-element list (496 inferences each), the
+  Takeuchi function and all solutions of 8 queens. Then times B(k) :- F(k),
+  G(k) over a Database's facts with Database::query and with the same
+  Database loaded into the machine.
+  Usage: lips [seconds per benchmark] (default 1).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+    const char *program = R"(
+app([], L, L).
+app([H|T], L, [H|R]) :- app(T, L, R).
+nrev([], []).
+nrev([H|T], R) :- nrev(T, RT), app(RT, [H], R).
+bench(0) :- !.
+bench(N) :- nrev([1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,
+		  21,22,23,24,25,26,27,28,29,30], _), M is N - 1, bench(M).
+
+tak(X, Y, Z, A) :- X =< Y, !, Z = A.
+tak(X, Y, Z, A) :- X1 is X - 1, Y1 is Y - 1, Z1 is Z - 1,
+    tak(X1, Y, Z, A1), tak(Y1, Z, X, A2), tak(Z1, X, Y, A3), tak(A1, A2, A3, A).
+
+queens(N, Qs) :- range(1, N, Ns), queens(Ns, [], Qs).
+queens([], Qs, Qs).
+queens(Unplaced, Safe, Qs) :-
+    select(Unplaced, Rest, Q), not_attack(Safe, Q, 1), queens(Rest, [Q|Safe], Qs).
+not_attack([], _, _).
+not_attack([Y|Ys], X, N) :- X =\= Y + N, X =\= Y - N, N1 is N + 1, not_attack(Ys, X, N1).
+select([X|Xs], Xs, X).
+select([Y|Ys], [Y|Zs], X) :- select(Ys, Zs, X).
+range(N, N, [N]) :- !.
+range(M, N, [M|Ns]) :- M < N, M1 is M + 1, range(M1, N, Ns).
+)";
+}
+
+int main(int argc, char **argv)
+{
+    double budget = argc > 1 ? std::atof(argv[1]) : 1.0;
+    using Clock = std::chrono::steady_clock;
+    AbstractMachine machine;
+    if(!machine.consult(program))
+	return 1;
+
+    const char *names[] = {"nrev30:   ", "tak:      ", "8 queens: "};
+    const char *goals[] = {"bench(1000)", "tak(18, 12, 6, _)", "queens(8, _), fail"};
+    for(int i = 0; i < 3; ++i) {
+	std::size_t runs = 0, inferences = machine.inference_count();
+	auto start = Clock::now();
+	double seconds = 0;
+	while(seconds < budget) {
+	    machine.query(goals[i]);
+	    ++runs;
+	    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+	inferences = machine.inference_count() - inferences;
+	std::cout << names[i] << inferences / seconds / 1e6 << " million LIPS (" << inferences / runs
+		  << " inferences per run)\n";
+    }
+
+    Database db;
+    {
+	auto batch = db.begin_batch();
+	for(int i = 0; i < 100'000; ++i) {
+	    batch.add_rule(Rule{"F", i});
+	    if(i % 3 == 0)
+		batch.add_rule(Rule{"G", i});
+	}
+	batch.commit();
+    }
+    Rule rule{"B", Var{0}};
+    rule << RuleVariable{"F", Var{0}} << RuleVariable{"G", Var{0}};
+    db.add_rule(rule);
+    AbstractMachine loaded;
+    if(!loaded.load(db))
+	return 1;
+    constexpr int query_count = 100'000;
+    std::vector<RuleVariable> conjectures;
+    for(int i = 0; i < 1024; ++i)
+	conjectures.emplace_back("B", i * 97 % 100'000);
+    for(bool use_machine : {false, true}) {
+	std::size_t found = 0;
+	auto start = Clock::now();
+	for(int i = 0; i < query_count; ++i) {
+	    const auto &conjecture = conjectures[i % conjectures.size()];
+	    found += use_machine ? loaded.query(conjecture, db.symbols()) : db.query(conjecture);
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << (use_machine ? "B(k) on the machine: " : "B(k) on the Database: ")
+		  << seconds / query_count * 1e9 << " ns per query (" << found << " true)\n";
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+/*
+  Writes a Prolog-syntax fact file and times Database::load_file() on it.
+  Usage: load [fact count] [path] (defaults: 10^6, facts.pl). An existing
+  file at path is loaded as-is instead of being regenerated.
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    std::size_t fact_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::string path = argc > 2 ? argv[2] : "facts.pl";
+
+    if(!std::ifstream(path)) {
+	std::ofstream out(path);
+	for(std::size_t i = 0; i < fact_count; ++i) {
+	    switch(i % 3) {
+	    case 0:
+		out << "edge(" << i << ", " << (i * 7919) % fact_count << ").\n";
+		break;
+	    case 1:
+		out << "label(" << i << ", node" << i % 1000 << ").\n";
+		break;
+	    default:
+		out << "weight(" << i << ", " << i * 0.25 << ").\n";
+	    }
+	}
+    }
+
+    Database db;
+    auto start = std::chrono::steady_clock::now();
+    auto result = db.load_file(path);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(!result) {
+	std::cerr << path << ':' << result.error_line << ": " << result.error << '\n';
+	return 1;
+    }
+    std::cout << "clauses:   " << result.clause_count << '\n'
+	      << "bytes:     " << result.byte_count << '\n'
+	      << "time:      " << seconds << " s\n"
+	      << "MB/s:      " << result.byte_count / seconds / 1e6 << '\n'
+	      << "clauses/s: " << result.clause_count / seconds << '\n';
+    return 0;
+}
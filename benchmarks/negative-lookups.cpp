@@ -0,0 +1,47 @@
+/*
+  Measures the latency of ground lookups of absent facts, which the Bloom
+  filter over each predicate's facts answers without reading the facts,
+  next to lookups of present facts. Usage: negative-lookups [fact count]
+  (default 10^7).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+int main(int argc, char **argv)
+{
+    std::size_t fact_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    using Clock = std::chrono::steady_clock;
+    int count = static_cast<int>(fact_count);
+
+    Database db;
+    {
+	auto batch = db.begin_batch();
+	for(int i = 0; i < count; ++i)
+	    batch.add_rule(Rule{"U", i, i % 1000});
+	batch.commit();
+    }
+
+    constexpr int lookup_count = 1'000'000;
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> any_fact(0, count - 1);
+    for(bool present : {false, true}) {
+	std::size_t found = 0;
+	auto start = Clock::now();
+	for(int i = 0; i < lookup_count; ++i) {
+	    int first = any_fact(random);
+	    // Absent facts share their first param with a present one
+	    found += db.query("U", first, present ? first % 1000 : first % 1000 + 1);
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << (present ? "present: " : "absent:  ") << seconds / lookup_count * 1e9
+		  << " ns/lookup (" << found << " found)\n";
+    }
+    auto stats = db.filter_stats("U");
+    std::cout << "filter:  " << stats.bit_count / 8 / 1024 << " KiB for " << stats.fact_count
+	      << " facts, expected false positive rate " << stats.expected_rate
+	      << ", observed " << stats.observed_rate() << '\n';
+    return 0;
+}
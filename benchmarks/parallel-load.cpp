@@ -0,0 +1,44 @@
+/*
+  Times Database::load_file() on the same fact file with 1, 2, 4, ... threads
+  up to the number of cores. Usage: parallel-load [fact count] [path]
+  (defaults: 10^6, facts.pl; the file is generated if missing).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    std::size_t fact_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::string path = argc > 2 ? argv[2] : "facts.pl";
+
+    if(!std::ifstream(path)) {
+	std::ofstream out(path);
+	for(std::size_t i = 0; i < fact_count; ++i)
+	    out << "edge(" << i << ", node" << i % 1000 << ").\n";
+    }
+
+    unsigned core_count = std::max(1u, std::thread::hardware_concurrency());
+    double single_thread = 0;
+    for(unsigned threads = 1; ; threads *= 2) {
+	threads = std::min(threads, core_count);
+	Database db;
+	auto start = std::chrono::steady_clock::now();
+	auto result = db.load_file(path, threads);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if(!result) {
+	    std::cerr << path << ':' << result.error_line << ": " << result.error << '\n';
+	    return 1;
+	}
+	if(threads == 1)
+	    single_thread = seconds;
+	std::cout << threads << " thread(s): " << seconds << " s, "
+		  << result.byte_count / seconds / 1e6 << " MB/s, speedup "
+		  << single_thread / seconds << '\n';
+	if(threads == core_count)
+	    break;
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+  Probes age(P, A) for A in a narrow range of values, written three ways:
+  as a Predicate (which only a scan can check), as comparison constraints
+  without an index (a ScanKernels range scan) and as comparison constraints
+  with a B-tree on A. Usage: range-probes [fact count] (default 10^6).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+static int g_low, g_high;
+
+int main(int argc, char **argv)
+{
+    std::size_t fact_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    using Clock = std::chrono::steady_clock;
+    int count = static_cast<int>(fact_count);
+
+    Database scanned, sorted;
+    sorted.add_index("age", 1);
+    std::mt19937 random(5);
+    std::uniform_int_distribution<int> any_age(0, count);
+    for(auto *db : {&scanned, &sorted}) {
+	random.seed(5);
+	auto batch = db->begin_batch();
+	for(int i = 0; i < count; ++i)
+	    batch.add_rule(Rule{"age", Symbol{static_cast<std::uint32_t>(i)}, any_age(random)});
+	batch.commit();
+    }
+
+    // About 5 facts fall in each range, so most probes have some answer
+    constexpr int probe_count = 2000;
+    for(int way = 0; way < 3; ++way) {
+	std::uniform_int_distribution<int> any_low(0, count - 5);
+	random.seed(9);
+	std::size_t found = 0;
+	auto start = Clock::now();
+	for(int i = 0; i < probe_count; ++i) {
+	    g_low = any_low(random);
+	    g_high = g_low + 4;
+	    Variable<int> age;
+	    if(way == 0) {
+		age.constrain([](const int &value) { return value >= g_low && value <= g_high; });
+	    } else {
+		age.constrain_greater(g_low, true);
+		age.constrain_less(g_high, true);
+	    }
+	    found += (way == 2 ? sorted : scanned).query(RuleVariable{"age", Type<Symbol>(), age});
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	const char *names[] = {"Predicate:          ", "comparisons, scan:  ", "comparisons, B-tree:"};
+	std::cout << names[way] << ' ' << seconds / probe_count * 1e6 << " us/probe (" << found
+		  << " found)\n";
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+  Times the same queries on U(int, int) facts held by a Database (dynamic
+  RuleVariables and virtual unification) and by a Relation<int, int>
+  (compile-time types): ground lookups, lookups by the first param and
+  scans by the second. The Database's conjectures are built beforehand.
+  Usage: relations [fact count] (default 10^6).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+int main(int argc, char **argv)
+{
+    std::size_t fact_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    using Clock = std::chrono::steady_clock;
+    int count = static_cast<int>(fact_count);
+
+    Database db;
+    Relation<int, int> relation;
+    {
+	auto batch = db.begin_batch();
+	for(int i = 0; i < count; ++i) {
+	    batch.add_rule(Rule{"U", i / 4, i % 1000});
+	    relation.add(i / 4, i % 1000);
+	}
+	batch.commit();
+    }
+
+    std::mt19937 random(2);
+    std::uniform_int_distribution<int> any_first(0, count / 2), any_second(0, 1999);
+    const char *names[] = {"ground:       ", "first bound:  ", "second bound: "};
+    for(int shape = 0; shape < 3; ++shape) {
+	// Scans read every fact, so there are fewer of them
+	int query_count = shape == 2 ? 20 : 1'000'000;
+	std::vector<std::pair<int, int>> args;
+	std::vector<RuleVariable> conjectures;
+	for(int i = 0; i < std::min(query_count, 4096); ++i) {
+	    args.emplace_back(any_first(random), any_second(random));
+	    if(shape == 0)
+		conjectures.emplace_back("U", args.back().first, args.back().second);
+	    else if(shape == 1)
+		conjectures.emplace_back("U", args.back().first, Type<int>());
+	    else
+		conjectures.emplace_back("U", Type<int>(), args.back().second);
+	}
+	std::size_t found = 0;
+	auto start = Clock::now();
+	for(int i = 0; i < query_count; ++i)
+	    found += db.query(conjectures[i % conjectures.size()]);
+	double dynamic = std::chrono::duration<double>(Clock::now() - start).count();
+	std::size_t relation_found = 0;
+	start = Clock::now();
+	for(int i = 0; i < query_count; ++i) {
+	    auto [first, second] = args[i % args.size()];
+	    if(shape == 0)
+		relation_found += relation.query(first, second);
+	    else if(shape == 1)
+		relation_found += relation.query(first, Type<int>());
+	    else
+		relation_found += relation.query(Type<int>(), second);
+	}
+	double typed = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << names[shape] << "Database " << dynamic / query_count * 1e9 << " ns, Relation "
+		  << typed / query_count * 1e9 << " ns per query (" << found << '/' << relation_found
+		  << " found)\n";
+    }
+    return 0;
+}
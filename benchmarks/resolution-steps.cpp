@@ -0,0 +1,61 @@
+/*
+  Measures Database::for_each_solution() per resolution step on recursive
+  programs: a Path rule over a chain of n edges (one deep proof) and over a
+  binary tree of n nodes (many shallow ones, so mostly backtracking). Each
+  solution takes three calls, Path and two Edges, so the time and the heap
+  allocations per solution are reported per call as well.
+  Usage: resolution-steps [n] [repetitions] (defaults: 10000, 20).
+*/
+#include "../backtrack.hpp"
+#include "alloc-counter.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+    const char *rules = "Path(x, y) :- Edge(x, y).\nPath(x, z) :- Edge(x, Y), Path(Y, z).\n";
+
+    using Clock = std::chrono::steady_clock;
+
+    void run(const char *label, const Database &db, int from, int repetitions)
+    {
+	std::size_t solutions = 0;
+	std::size_t allocations = g_allocation_count;
+	auto start = Clock::now();
+	for(int i = 0; i < repetitions; ++i) {
+	    db.for_each_solution(RuleVariable{"Path", from, Var{0}}, [&](const RuleVariable&) {
+		++solutions;
+		return false;
+	    });
+	}
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	auto calls = static_cast<double>(3 * solutions);
+	std::cout << label << ": " << solutions / static_cast<std::size_t>(repetitions) << " solutions, "
+		  << ns / calls << " ns and "
+		  << static_cast<double>(g_allocation_count - allocations) / calls << " allocations per call\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 10000;
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    Database chain;
+    std::string source = rules;
+    for(int i = 0; i < n; ++i)
+	source += "Edge(" + std::to_string(i) + ", " + std::to_string(i + 1) + ").\n";
+    if(!chain.load(source))
+	return 1;
+    run("chain", chain, 0, repetitions);
+
+    Database tree;
+    source = rules;
+    for(int i = 1; 2 * i + 1 < n; ++i)
+	source += "Edge(" + std::to_string(i) + ", " + std::to_string(2 * i) + "). Edge("
+	    + std::to_string(i) + ", " + std::to_string(2 * i + 1) + ").\n";
+    if(!tree.load(source))
+	return 1;
+    run("tree", tree, 1, repetitions);
+    return 0;
+}
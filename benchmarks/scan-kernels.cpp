@@ -0,0 +1,76 @@
+/*
+  Measures the ScanKernels equality and range filters in rows/second for
+  int, double and Symbol columns at each kernel level this CPU supports,
+  then a Database query that has to scan its facts. Usage:
+  scan-kernels [row count] (default 10^7).
+*/
+#include "../backtrack.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+template<typename Scan>
+double rows_per_second(std::size_t row_count, Scan scan)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr int repeat_count = 10;
+    auto start = Clock::now();
+    for(int i = 0; i < repeat_count; ++i)
+	scan();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return static_cast<double>(row_count) * repeat_count / seconds;
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t row_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    std::vector<int> ints(row_count);
+    std::vector<double> reals(row_count);
+    std::vector<Symbol> symbols(row_count);
+    for(std::size_t i = 0; i < row_count; ++i) {
+	ints[i] = static_cast<int>(i % 1000);
+	reals[i] = static_cast<double>(i % 1000) / 8;
+	symbols[i] = Symbol{static_cast<std::uint32_t>(i % 1000)};
+    }
+    std::vector<std::uint64_t> bits((row_count + 63) / 64);
+    const char *names[] = {"scalar", "SSE2  ", "AVX2  "};
+
+    for(auto level : {ScanKernels::Level::Scalar, ScanKernels::Level::SSE2, ScanKernels::Level::AVX2}) {
+	if(level > ScanKernels::supported())
+	    break;
+	ScanKernels::use(level);
+	std::cout << names[static_cast<int>(level)] << " (10^6 rows/s)  int ==: "
+		  << rows_per_second(row_count, [&] {
+			 ScanKernels::equal(ints.data(), row_count, 500, bits.data());
+		     }) / 1e6
+		  << "  int range: "
+		  << rows_per_second(row_count, [&] {
+			 ScanKernels::between(ints.data(), row_count, 100, 200, bits.data());
+		     }) / 1e6
+		  << "  double range: "
+		  << rows_per_second(row_count, [&] {
+			 ScanKernels::between(reals.data(), row_count, 12.5, 25.0, bits.data());
+		     }) / 1e6
+		  << "  Symbol ==: "
+		  << rows_per_second(row_count, [&] {
+			 ScanKernels::equal(symbols.data(), row_count, Symbol{500}, bits.data());
+		     }) / 1e6
+		  << '\n';
+    }
+
+    // U(X, 1000) matches nothing, so every query scans the second column
+    Database db;
+    {
+	auto batch = db.begin_batch();
+	for(std::size_t i = 0; i < row_count; ++i)
+	    batch.add_rule(Rule{"U", static_cast<int>(i), static_cast<int>(i % 1000)});
+	batch.commit();
+    }
+    for(auto level : {ScanKernels::Level::Scalar, ScanKernels::supported()}) {
+	ScanKernels::use(level);
+	std::cout << "query U(X, 1000), " << names[static_cast<int>(level)] << ": "
+		  << rows_per_second(row_count, [&] { db.query("U", Type<int>(), 1000); }) / 1e6
+		  << " 10^6 facts/s\n";
+    }
+    return 0;
+}
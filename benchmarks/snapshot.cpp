@@ -0,0 +1,49 @@
+/*
+  Measures the cost of Database::snapshot() and of the first insert into a
+  snapshot (which copies the table of buckets plus the one touched bucket)
+  for a database of 10^6 clauses spread over 1000 predicates.
+*/
+#include "alloc-counter.hpp"
+#include "../backtrack.hpp"
+#include <chrono>
+#include <iostream>
+
+int main()
+{
+    constexpr int predicate_count = 1000;
+    constexpr int clauses_per_predicate = 1000;
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<Rule> clauses;
+    clauses.reserve(predicate_count * clauses_per_predicate + 1);
+    Database db;
+    for(int p = 0; p < predicate_count; ++p) {
+	std::string name = "p" + std::to_string(p);
+	for(int i = 0; i < clauses_per_predicate; ++i) {
+	    clauses.emplace_back(name, i, i + 1);
+	    db.add_rule(clauses.back());
+	}
+    }
+    std::size_t base_bytes = g_allocated_bytes;
+
+    auto start = Clock::now();
+    Database what_if = db.snapshot();
+    auto fork_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    std::size_t fork_bytes = g_allocated_bytes - base_bytes;
+
+    clauses.emplace_back("p7", -1, -1);
+    std::size_t before_insert = g_allocated_bytes;
+    start = Clock::now();
+    what_if.add_rule(clauses.back());
+    auto insert_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    std::size_t insert_bytes = g_allocated_bytes - before_insert;
+
+    std::cout << "clauses:                " << predicate_count * clauses_per_predicate << '\n'
+	      << "database heap bytes:    " << base_bytes << '\n'
+	      << "snapshot() latency:     " << fork_ns << " ns, " << fork_bytes << " bytes\n"
+	      << "first insert latency:   " << insert_us << " us, " << insert_bytes << " bytes ("
+	      << 100.0 * insert_bytes / base_bytes << "% of database)\n"
+	      << "queries agree:          " << (what_if.query("p7", -1, -1) && !db.query("p7", -1, -1))
+	      << '\n';
+    return 0;
+}
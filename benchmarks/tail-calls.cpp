@@ -0,0 +1,57 @@
+/*
+  Measures memory on deterministic tail recursion through
+  Database::for_each_solution(): Loop counts a two-digit counter (a high
+  digit below 1000, a low one below 10^4) down to zero through Dec facts,
+  and each of its iterations ends in a tail call. Prints the heap bytes in
+  use when the one solution is found, which stay the same whatever the
+  number of iterations, and the time per iteration.
+  Usage: tail-calls [iterations] (default 10^7, a multiple of 10^4).
+*/
+#include "../backtrack.hpp"
+#include "alloc-counter.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+    // Next, Borrow and Stop each have one clause per value of their first
+    // param, so no call leaves a choice point
+    const char *rules = "Loop(h, l) :- Dec(l, M, B), Next(B, h, M).\n"
+	"Next(0, h, m) :- Loop(h, m).\n"
+	"Next(1, h, m) :- Borrow(h, m).\n"
+	"Borrow(h, m) :- Dec(h, G, B), Stop(B, G, m).\n"
+	"Stop(0, g, m) :- Loop(g, m).\n"
+	"Stop(1, G, M).\n";
+
+    using Clock = std::chrono::steady_clock;
+}
+
+int main(int argc, char **argv)
+{
+    long largest = argc > 1 ? std::atol(argv[1]) : 10000000;
+    constexpr int digit = 10000;
+    Database db;
+    std::string source = rules;
+    source += "Dec(0, " + std::to_string(digit - 1) + ", 1).\n";
+    for(int i = 1; i < digit; ++i)
+	source += "Dec(" + std::to_string(i) + ", " + std::to_string(i - 1) + ", 0).\n";
+    if(!db.load(source))
+	return 1;
+
+    std::size_t before = g_allocated_bytes;
+    for(long n = digit; n <= largest; n *= 10) {
+	std::size_t in_use = 0;
+	auto start = Clock::now();
+	bool found = db.for_each_solution(RuleVariable{"Loop", static_cast<int>(n / digit - 1), digit - 1},
+					  [&](const RuleVariable&) {
+					      in_use = g_allocated_bytes - before;
+					      return true;
+					  });
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	if(!found)
+	    return 1;
+	std::cout << n << " iterations: " << in_use << " bytes in use at the end, "
+		  << ns / static_cast<double>(n) << " ns per iteration\n";
+    }
+    return 0;
+}
@@ -0,0 +1,5 @@
+#!/usr/bin/env bash
+# Builds compile-rules, which turns a Datalog rules file into a C++ header
+# (see compile-rules.cpp)
+cd "$(dirname "$0")" || exit 1
+clang++ -std=c++17 -O2 -Wall -Wextra -pedantic-errors -Wfloat-conversion -Wconversion -Wno-sign-conversion -o compile-rules compile-rules.cpp
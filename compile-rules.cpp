@@ -0,0 +1,653 @@
+/*
+  Compiles a file of Datalog rules ahead of time into a C++ header, in the
+  way Souffle's compiled mode does. Each predicate becomes a Table (rows kept
+  in a Relation, plus a hash set of them so derived rows are only added
+  once), and each rule becomes nested loops evaluated semi-naively: one
+  version per body goal, which reads only the rows the last round derived
+  for that goal and looks the other goals up in hash indexes on exactly the
+  params bound at that point. The rules are checked and their types inferred here, so
+  the generated code does no unification and no type tests.
+
+  The rules file uses the syntax Database::load() reads. Facts in it are
+  added when a Program is constructed. A predicate's param types are taken
+  from the constants and variables it shares with other predicates; ones
+  that only get facts at run time need a declaration such as
+      .decl Edge(int, int)
+  where each type is int, long, double or symbol.
+
+  The header defines namespace <name>, with a class Program that has one
+  public Table per predicate, named like it, and evaluate(), which derives
+  everything the rules imply and returns the number of rows it added.
+  Build with build-compile-rules.sh.
+  Usage: compile-rules <rules file> <output header> [namespace name]
+  (default: the rules file's name)
+*/
+#include "backtrack.hpp"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    enum class ColumnType { Unknown, Int, Long, Double, Symbol };
+
+    const char* type_name(ColumnType type)
+    {
+	switch(type) {
+	case ColumnType::Int: return "int";
+	case ColumnType::Long: return "long long";
+	case ColumnType::Double: return "double";
+	case ColumnType::Symbol: return "Symbol";
+	default: return "?";
+	}
+    }
+
+    // One param of a fact or goal: a variable's slot or a constant
+    struct Arg {
+	bool is_variable = false;
+	std::size_t slot = 0;
+	ColumnType type = ColumnType::Unknown;
+	long long integer = 0;
+	double real = 0;
+	Symbol symbol{0};
+    };
+
+    struct Atom {
+	std::string name;
+	std::vector<Arg> args;
+    };
+
+    struct Clause {
+	Atom head;
+	std::vector<Atom> body;
+	std::size_t slot_count = 0;
+	std::size_t line;
+    };
+
+    struct Predicate {
+	std::vector<ColumnType> types;
+	// Types given by a .decl, which inference must agree with
+	std::vector<ColumnType> declared;
+    };
+
+    class Compiler {
+    private:
+	SymbolTable m_symbols;
+	std::map<std::string, Predicate> m_predicates;
+	std::vector<Clause> m_facts, m_rules;
+	// Indexes the rules look goals up in, by predicate and bound params
+	std::set<std::pair<std::string, std::vector<std::size_t>>> m_indexes;
+	std::string m_error;
+
+	bool fail(const std::string &message)
+	{
+	    if(m_error.empty())
+		m_error = message;
+	    return false;
+	}
+
+	static bool is_name_char(char c)
+	{
+	    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+		|| c == '_';
+	}
+
+	// Reads and blanks out the .decl lines, which ClauseParser doesn't know
+	bool read_declarations(std::string &text)
+	{
+	    std::size_t line_start = 0;
+	    for(std::size_t line = 1; line_start < text.size(); ++line) {
+		std::size_t line_end = std::min(text.find('\n', line_start), text.size());
+		std::size_t pos = text.find_first_not_of(" \t", line_start);
+		if(pos < line_end && text.compare(pos, 5, ".decl") == 0) {
+		    std::string decl = text.substr(pos + 5, line_end - pos - 5);
+		    std::fill(text.begin() + pos, text.begin() + line_end, ' ');
+		    std::string where = "line " + std::to_string(line) + ": ";
+		    auto open = decl.find('('), close = decl.rfind(')');
+		    if(open == std::string::npos || close == std::string::npos || close < open)
+			return fail(where + "expected .decl Name(type, ...)");
+		    std::string name = decl.substr(0, open);
+		    name.erase(0, name.find_first_not_of(" \t"));
+		    name.erase(name.find_last_not_of(" \t\r") + 1);
+		    if(name.empty() || !std::all_of(name.begin(), name.end(), is_name_char))
+			return fail(where + "expected a predicate name after .decl");
+		    std::vector<ColumnType> types;
+		    std::istringstream params(decl.substr(open + 1, close - open - 1));
+		    for(std::string param; std::getline(params, param, ',');) {
+			param.erase(0, param.find_first_not_of(" \t"));
+			param.erase(param.find_last_not_of(" \t") + 1);
+			if(param == "int")
+			    types.push_back(ColumnType::Int);
+			else if(param == "long")
+			    types.push_back(ColumnType::Long);
+			else if(param == "double")
+			    types.push_back(ColumnType::Double);
+			else if(param == "symbol")
+			    types.push_back(ColumnType::Symbol);
+			else
+			    return fail(where + "unknown type '" + param + "'");
+		    }
+		    if(types.empty() || m_predicates.count(name) != 0)
+			return fail(where + "bad or repeated .decl of " + name);
+		    m_predicates[name] = {types, types};
+		}
+		line_start = line_end + 1;
+	    }
+	    return true;
+	}
+
+	static Arg to_arg(const IVariable &param)
+	{
+	    Arg arg;
+	    if(auto *variable = dynamic_cast<const LogicVariable*>(&param)) {
+		arg.is_variable = true;
+		arg.slot = variable->slot();
+	    } else if(auto *integer = dynamic_cast<const Variable<int>*>(&param)) {
+		arg.type = ColumnType::Int;
+		arg.integer = integer->value();
+	    } else if(auto *big = dynamic_cast<const Variable<long long>*>(&param)) {
+		arg.type = ColumnType::Long;
+		arg.integer = big->value();
+	    } else if(auto *real = dynamic_cast<const Variable<double>*>(&param)) {
+		arg.type = ColumnType::Double;
+		arg.real = real->value();
+	    } else {
+		arg.type = ColumnType::Symbol;
+		arg.symbol = static_cast<const Variable<Symbol>&>(param).value();
+	    }
+	    return arg;
+	}
+
+	static Atom to_atom(const RuleVariable &source, std::size_t &slot_count)
+	{
+	    Atom atom{source.name(), {}};
+	    for(std::size_t i = 0; i < source.arity(); ++i) {
+		atom.args.push_back(to_arg(*source[i]));
+		if(atom.args.back().is_variable)
+		    slot_count = std::max(slot_count, atom.args.back().slot + 1);
+	    }
+	    return atom;
+	}
+
+	// int widens to long; any other pair of different types is an error
+	static bool join(ColumnType &type, ColumnType other)
+	{
+	    if(other == ColumnType::Unknown || other == type)
+		return true;
+	    if(type == ColumnType::Unknown
+	       || (type == ColumnType::Int && other == ColumnType::Long)) {
+		type = other;
+		return true;
+	    }
+	    return type == ColumnType::Long && other == ColumnType::Int;
+	}
+
+	bool check_arity(const Atom &atom, std::size_t line)
+	{
+	    std::string where = "line " + std::to_string(line) + ": ";
+	    if(atom.args.empty())
+		return fail(where + atom.name + " has no params");
+	    auto &predicate = m_predicates[atom.name];
+	    if(predicate.types.empty())
+		predicate.types.resize(atom.args.size());
+	    if(predicate.types.size() != atom.args.size())
+		return fail(where + atom.name + " is used with different numbers of params");
+	    return true;
+	}
+
+	static std::vector<const Atom*> atoms_of(const Clause &clause)
+	{
+	    std::vector<const Atom*> atoms{&clause.head};
+	    for(const auto &goal : clause.body)
+		atoms.push_back(&goal);
+	    return atoms;
+	}
+
+	// Repeats until no param's type changes: constants give their column a
+	// type, and a variable's columns all get the join of their types
+	bool infer_types()
+	{
+	    for(bool changed = true; changed;) {
+		changed = false;
+		for(auto *clauses : {&m_facts, &m_rules}) {
+		    for(const auto &clause : *clauses) {
+			std::vector<ColumnType> slots(clause.slot_count);
+			auto atoms = atoms_of(clause);
+			// The variables' types from their columns, then back
+			for(int pass = 0; pass < 2; ++pass) {
+			    for(const auto *atom : atoms) {
+				auto &types = m_predicates[atom->name].types;
+				for(std::size_t i = 0; i < atom->args.size(); ++i) {
+				    const auto &arg = atom->args[i];
+				    ColumnType before = types[i];
+				    bool agrees = !arg.is_variable ? join(types[i], arg.type)
+					: pass == 0 ? join(slots[arg.slot], types[i])
+					: join(types[i], slots[arg.slot]);
+				    if(!agrees)
+					return fail("line " + std::to_string(clause.line) + ": param "
+						    + std::to_string(i + 1) + " of " + atom->name
+						    + " is used with conflicting types");
+				    changed |= types[i] != before;
+				}
+			    }
+			}
+		    }
+		}
+	    }
+	    for(const auto &[name, predicate] : m_predicates) {
+		for(std::size_t i = 0; i < predicate.types.size(); ++i) {
+		    std::string param = "param " + std::to_string(i + 1) + " of " + name;
+		    if(predicate.types[i] == ColumnType::Unknown)
+			return fail("the type of " + param + " is unknown; declare it with .decl");
+		    if(!predicate.declared.empty() && predicate.declared[i] != predicate.types[i])
+			return fail(param + " is used as " + type_name(predicate.types[i])
+				    + ", but declared " + type_name(predicate.declared[i]));
+		}
+	    }
+	    return true;
+	}
+
+	std::string literal(const Arg &arg, ColumnType type) const
+	{
+	    switch(type) {
+	    case ColumnType::Int:
+		return std::to_string(arg.integer);
+	    case ColumnType::Long:
+		return std::to_string(arg.integer) + "LL";
+	    case ColumnType::Double: {
+		std::ostringstream out;
+		out.precision(17);
+		out << arg.real;
+		std::string text = out.str();
+		if(text.find_first_of(".e") == std::string::npos)
+		    text += ".0";
+		return text;
+	    }
+	    default:
+		return "symbol_" + std::to_string(arg.symbol.id);
+	    }
+	}
+
+	static std::string variable(std::size_t slot) { return "v" + std::to_string(slot); }
+
+	static std::string describe(const Atom &atom)
+	{
+	    std::string text = atom.name + "(";
+	    for(std::size_t i = 0; i < atom.args.size(); ++i) {
+		if(i > 0)
+		    text += ", ";
+		text += atom.args[i].is_variable ? variable(atom.args[i].slot) : "c";
+	    }
+	    return text + ")";
+	}
+
+	// The loops of one version of a rule: goal `delta` reads the rows
+	// derived last round and is joined first; goals written before it read
+	// the rows from earlier rounds, and goals after it every row up to
+	// this round's. That way each derivation is made in only one version.
+	// Indexes are brought up to date only before a version that uses them
+	// runs, so one that only serves a goal's first round isn't kept up after
+	void emit_version(std::ostream &code, const Clause &rule, std::size_t delta)
+	{
+	    std::ostringstream out;
+	    std::set<std::string> updates;
+	    std::vector<bool> bound(rule.slot_count);
+	    // Variables used once are never read, so they aren't bound
+	    std::vector<std::size_t> uses(rule.slot_count);
+	    for(const auto *atom : atoms_of(rule)) {
+		for(const auto &arg : atom->args)
+		    uses[arg.slot] += arg.is_variable;
+	    }
+	    std::vector<std::size_t> order{delta};
+	    for(std::size_t i = 0; i < rule.body.size(); ++i) {
+		if(i != delta)
+		    order.push_back(i);
+	    }
+	    std::string indent = "            ";
+	    std::size_t close_count = 0;
+	    for(std::size_t step = 0; step < order.size(); ++step) {
+		const Atom &goal = rule.body[order[step]];
+		const auto &types = m_predicates[goal.name].types;
+		std::string row = "r" + std::to_string(step);
+		// Params whose value is known before the goal is matched
+		std::vector<std::size_t> keys;
+		std::vector<std::string> key_values;
+		for(std::size_t i = 0; i < goal.args.size(); ++i) {
+		    const auto &arg = goal.args[i];
+		    if(!arg.is_variable) {
+			keys.push_back(i);
+			key_values.push_back(literal(arg, types[i]));
+		    } else if(bound[arg.slot]) {
+			keys.push_back(i);
+			key_values.push_back(variable(arg.slot));
+		    }
+		}
+		std::string limit = goal.name + (order[step] < delta ? ".delta_begin" : ".delta_end");
+		std::vector<std::string> checks;
+		if(step == 0) {
+		    out << indent << "for(std::size_t " << row << " = " << goal.name << ".delta_begin; "
+			<< row << " < " << goal.name << ".delta_end; ++" << row << ") {\n";
+		    for(std::size_t k = 0; k < keys.size(); ++k) {
+			checks.push_back("std::get<" + std::to_string(keys[k]) + ">(" + goal.name + "["
+					 + row + "]) == " + key_values[k]);
+		    }
+		} else if(keys.size() == goal.args.size()) {
+		    std::string values;
+		    for(const auto &value : key_values)
+			values += (values.empty() ? "" : ", ") + value;
+		    out << indent << "if(" << goal.name << ".contains(" << values << ")) {\n";
+		} else if(keys.empty()) {
+		    out << indent << "for(std::size_t " << row << " = 0; " << row << " < " << limit
+			<< "; ++" << row << ") {\n";
+		} else {
+		    std::string index = goal.name + "_by";
+		    std::string values;
+		    for(std::size_t k = 0; k < keys.size(); ++k) {
+			index += "_" + std::to_string(keys[k]);
+			values += (k == 0 ? "" : ", ") + key_values[k];
+		    }
+		    m_indexes.emplace(goal.name, keys);
+		    updates.insert(index + ".update(" + goal.name + ");");
+		    out << indent << "for(std::uint32_t " << row << " : " << index << ".find(" << values
+			<< ")) {\n";
+		    out << indent << "    if(" << row << " >= " << limit << ")\n"
+			<< indent << "        break;\n";
+		}
+		indent += "    ";
+		++close_count;
+		// Bind the goal's new variables, comparing repeats within it
+		bool reads_row = keys.size() != goal.args.size() || step == 0;
+		for(std::size_t i = 0; i < goal.args.size() && reads_row; ++i) {
+		    const auto &arg = goal.args[i];
+		    if(!arg.is_variable || uses[arg.slot] == 1
+		       || std::find(keys.begin(), keys.end(), i) != keys.end())
+			continue;
+		    std::string value = "std::get<" + std::to_string(i) + ">(" + goal.name + "[" + row + "])";
+		    if(bound[arg.slot]) {
+			checks.push_back(value + " == " + variable(arg.slot));
+		    } else {
+			out << indent << "const " << type_name(types[i]) << ' ' << variable(arg.slot)
+			    << " = " << value << ";\n";
+			bound[arg.slot] = true;
+		    }
+		}
+		if(!checks.empty()) {
+		    out << indent << "if(";
+		    for(std::size_t c = 0; c < checks.size(); ++c)
+			out << (c == 0 ? "" : " && ") << checks[c];
+		    out << ") {\n";
+		    indent += "    ";
+		    ++close_count;
+		}
+	    }
+	    const auto &head_types = m_predicates[rule.head.name].types;
+	    out << indent << "derived += " << rule.head.name << ".insert(";
+	    for(std::size_t i = 0; i < rule.head.args.size(); ++i) {
+		const auto &arg = rule.head.args[i];
+		out << (i == 0 ? "" : ", ")
+		    << (arg.is_variable ? variable(arg.slot) : literal(arg, head_types[i]));
+	    }
+	    out << ");\n";
+	    while(close_count-- > 0) {
+		indent.resize(indent.size() - 4);
+		out << indent << "}\n";
+	    }
+	    const auto &source = rule.body[delta].name;
+	    code << "        if(" << source << ".delta_begin != " << source << ".delta_end) {\n";
+	    for(const auto &update : updates)
+		code << "            " << update << "\n";
+	    code << out.str() << "        }\n";
+	}
+    public:
+	bool read(std::string text)
+	{
+	    if(!read_declarations(text))
+		return false;
+	    ClauseParser parser{text, m_symbols};
+	    std::vector<std::pair<Rule, std::size_t>> clauses;
+	    if(!parser.parse([&](Rule &&rule) { clauses.emplace_back(std::move(rule), parser.line()); }))
+		return fail("line " + std::to_string(parser.line()) + ": " + parser.error());
+	    for(const auto &[source, line] : clauses) {
+		Clause clause;
+		clause.line = line;
+		clause.head = to_atom(source, clause.slot_count);
+		for(const auto &goal : source.predicates())
+		    clause.body.push_back(to_atom(goal, clause.slot_count));
+		std::vector<bool> in_body(clause.slot_count);
+		for(const auto &goal : clause.body) {
+		    if(!check_arity(goal, line))
+			return false;
+		    for(const auto &arg : goal.args) {
+			if(arg.is_variable)
+			    in_body[arg.slot] = true;
+		    }
+		}
+		if(!check_arity(clause.head, line))
+		    return false;
+		for(const auto &arg : clause.head.args) {
+		    if(arg.is_variable && !in_body[arg.slot]) {
+			return fail("line " + std::to_string(line) + ": every variable in "
+				    + clause.head.name + " must appear in a goal of its body");
+		    }
+		}
+		(clause.body.empty() ? m_facts : m_rules).push_back(std::move(clause));
+	    }
+	    return infer_types();
+	}
+
+	void write(std::ostream &out, const std::string &source_name, const std::string &space)
+	{
+	    std::ostringstream rules;
+	    for(const auto &rule : m_rules) {
+		rules << "        // " << describe(rule.head) << " :- ";
+		for(std::size_t i = 0; i < rule.body.size(); ++i)
+		    rules << (i == 0 ? "" : ", ") << describe(rule.body[i]);
+		rules << "\n";
+		for(std::size_t delta = 0; delta < rule.body.size(); ++delta)
+		    emit_version(rules, rule, delta);
+	    }
+
+	    out << "// Generated by compile-rules from " << source_name << "; do not edit\n"
+		<< "#pragma once\n#include \"backtrack.hpp\"\n\n"
+		<< "#ifndef COMPILED_RULES_TABLE\n#define COMPILED_RULES_TABLE\n"
+		<< "namespace compiled_rules {\n"
+		<< "    struct TupleHash {\n"
+		<< "        template<typename ...Ts>\n"
+		<< "        std::size_t operator()(const std::tuple<Ts...> &values) const\n"
+		<< "        {\n"
+		<< "            std::uint64_t hash = 0;\n"
+		<< "            std::apply([&](const auto &...value) {\n"
+		<< "                ((hash = (hash ^ std::hash<std::decay_t<decltype(value)>>{}(value))\n"
+		<< "                  * 0x9e3779b97f4a7c15ull, hash ^= hash >> 29), ...);\n"
+		<< "            }, values);\n"
+		<< "            return static_cast<std::size_t>(hash);\n"
+		<< "        }\n"
+		<< "    };\n\n"
+		<< "    // A predicate's rows, each added once. Rows before delta_begin were\n"
+		<< "    // joined in earlier rounds; the ones up to delta_end are this round's\n"
+		<< "    template<typename ...Ts>\n"
+		<< "    class Table {\n"
+		<< "    public:\n"
+		<< "        using Tuple = std::tuple<Ts...>;\n"
+		<< "    private:\n"
+		<< "        Relation<Ts...> m_rows;\n"
+		<< "        // Open addressing on the rows' hashes: row + 1, or 0 if empty\n"
+		<< "        std::vector<std::uint32_t> m_slots = std::vector<std::uint32_t>(16);\n\n"
+		<< "        // The slot holding tuple, or the empty one it would go in\n"
+		<< "        std::uint32_t& slot(const Tuple &tuple)\n"
+		<< "        {\n"
+		<< "            std::size_t mask = m_slots.size() - 1;\n"
+		<< "            for(std::size_t i = TupleHash{}(tuple) & mask;; i = (i + 1) & mask) {\n"
+		<< "                if(m_slots[i] == 0 || m_rows[m_slots[i] - 1] == tuple)\n"
+		<< "                    return m_slots[i];\n"
+		<< "            }\n"
+		<< "        }\n\n"
+		<< "        void grow()\n"
+		<< "        {\n"
+		<< "            m_slots.assign(m_slots.size() * 2, 0);\n"
+		<< "            for(std::size_t row = 0; row < m_rows.size(); ++row)\n"
+		<< "                slot(m_rows[row]) = static_cast<std::uint32_t>(row + 1);\n"
+		<< "        }\n"
+		<< "    public:\n"
+		<< "        std::size_t delta_begin = 0, delta_end = 0;\n\n"
+		<< "        bool insert(Ts... values)\n"
+		<< "        {\n"
+		<< "            if(2 * (m_rows.size() + 1) > m_slots.size())\n"
+		<< "                grow();\n"
+		<< "            auto &match = slot(Tuple{values...});\n"
+		<< "            if(match != 0)\n"
+		<< "                return false;\n"
+		<< "            m_rows.add(values...);\n"
+		<< "            match = static_cast<std::uint32_t>(m_rows.size());\n"
+		<< "            return true;\n"
+		<< "        }\n\n"
+		<< "        bool contains(const Ts &...values) const\n"
+		<< "        {\n"
+		<< "            return const_cast<Table*>(this)->slot(Tuple{values...}) != 0;\n"
+		<< "        }\n\n"
+		<< "        std::size_t size() const { return m_rows.size(); }\n\n"
+		<< "        const Tuple& operator[](std::size_t row) const { return m_rows[row]; }\n\n"
+		<< "        // For queries; see Relation\n"
+		<< "        const Relation<Ts...>& relation() const { return m_rows; }\n\n"
+		<< "        // Starts a round; false if nothing was added since the last one\n"
+		<< "        bool advance()\n"
+		<< "        {\n"
+		<< "            delta_begin = delta_end;\n"
+		<< "            delta_end = m_rows.size();\n"
+		<< "            return delta_begin != delta_end;\n"
+		<< "        }\n"
+		<< "    };\n\n"
+		<< "    // The rows of a Table by the values of some of their params, in row order\n"
+		<< "    template<typename Table, std::size_t ...Columns>\n"
+		<< "    class Index {\n"
+		<< "    private:\n"
+		<< "        using Key = std::tuple<std::tuple_element_t<Columns, typename Table::Tuple>...>;\n"
+		<< "        std::unordered_map<Key, std::vector<std::uint32_t>, TupleHash> m_rows;\n"
+		<< "        std::size_t m_indexed = 0;\n"
+		<< "        inline static const std::vector<std::uint32_t> none;\n"
+		<< "    public:\n"
+		<< "        void update(const Table &table)\n"
+		<< "        {\n"
+		<< "            for(; m_indexed < table.size(); ++m_indexed) {\n"
+		<< "                const auto &row = table[m_indexed];\n"
+		<< "                m_rows[Key{std::get<Columns>(row)...}].push_back(static_cast<std::uint32_t>(m_indexed));\n"
+		<< "            }\n"
+		<< "        }\n\n"
+		<< "        template<typename ...Values>\n"
+		<< "        const std::vector<std::uint32_t>& find(const Values &...values) const\n"
+		<< "        {\n"
+		<< "            auto match = m_rows.find(Key{values...});\n"
+		<< "            return match != m_rows.end() ? match->second : none;\n"
+		<< "        }\n"
+		<< "    };\n"
+		<< "}\n#endif\n\n";
+
+	    out << "namespace " << space << " {\n"
+		<< "class Program {\n"
+		<< "public:\n"
+		<< "    SymbolTable symbols;\n";
+	    for(const auto &[name, predicate] : m_predicates) {
+		out << "    compiled_rules::Table<";
+		for(std::size_t i = 0; i < predicate.types.size(); ++i)
+		    out << (i == 0 ? "" : ", ") << type_name(predicate.types[i]);
+		out << "> " << name << ";\n";
+	    }
+	    out << "private:\n";
+	    for(const auto &[name, columns] : m_indexes) {
+		out << "    compiled_rules::Index<decltype(" << name << ")";
+		std::string index = name + "_by";
+		for(auto column : columns) {
+		    out << ", " << column;
+		    index += "_" + std::to_string(column);
+		}
+		out << "> " << index << ";\n";
+	    }
+	    std::set<std::uint32_t> symbols;
+	    for(auto *clauses : {&m_facts, &m_rules}) {
+		for(const auto &clause : *clauses) {
+		    for(const auto *atom : atoms_of(clause)) {
+			for(const auto &arg : atom->args) {
+			    if(!arg.is_variable && arg.type == ColumnType::Symbol)
+				symbols.insert(arg.symbol.id);
+			}
+		    }
+		}
+	    }
+	    for(auto id : symbols)
+		out << "    Symbol symbol_" << id << ";\n";
+	    out << "public:\n"
+		<< "    Program()\n"
+		<< "    {\n";
+	    for(auto id : symbols) {
+		std::string name{m_symbols.name(Symbol{id})};
+		out << "        symbol_" << id << " = symbols.intern(\"";
+		for(char c : name)
+		    out << (c == '"' || c == '\\' ? "\\" : "") << c;
+		out << "\");\n";
+	    }
+	    for(const auto &fact : m_facts) {
+		const auto &types = m_predicates[fact.head.name].types;
+		out << "        " << fact.head.name << ".insert(";
+		for(std::size_t i = 0; i < fact.head.args.size(); ++i)
+		    out << (i == 0 ? "" : ", ") << literal(fact.head.args[i], types[i]);
+		out << ");\n";
+	    }
+	    out << "    }\n\n"
+		<< "    // Applies the rules until nothing new is derived; returns the number\n"
+		<< "    // of rows added. Rows inserted since the last call are taken into account\n"
+		<< "    std::size_t evaluate()\n"
+		<< "    {\n"
+		<< "        std::size_t derived = 0;\n"
+		<< "        while(true) {\n"
+		<< "            bool changed = false;\n";
+	    for(const auto &[name, predicate] : m_predicates)
+		out << "            changed |= " << name << ".advance();\n";
+	    out << "            if(!changed)\n"
+		<< "                return derived;\n";
+	    std::string body = rules.str(), line;
+	    std::istringstream lines(body);
+	    while(std::getline(lines, line))
+		out << "    " << line << "\n";
+	    out << "        }\n"
+		<< "    }\n"
+		<< "};\n"
+		<< "}\n";
+	}
+
+	const std::string& error() const { return m_error; }
+    };
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3) {
+	std::cerr << "Usage: compile-rules <rules file> <output header> [namespace name]\n";
+	return 2;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    if(!input) {
+	std::cerr << "compile-rules: can't read " << argv[1] << "\n";
+	return 1;
+    }
+    std::ostringstream text;
+    text << input.rdbuf();
+    std::string source_name = argv[1];
+    source_name = source_name.substr(source_name.find_last_of("/\\") + 1);
+    std::string space = argc > 3 ? argv[3] : source_name.substr(0, source_name.find('.'));
+    for(auto &c : space) {
+	if(!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')))
+	    c = '_';
+    }
+
+    Compiler compiler;
+    if(!compiler.read(text.str())) {
+	std::cerr << argv[1] << ": " << compiler.error() << "\n";
+	return 1;
+    }
+    std::ofstream output(argv[2]);
+    compiler.write(output, source_name, space);
+    if(!output) {
+	std::cerr << "compile-rules: can't write " << argv[2] << "\n";
+	return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "backtrack.hpp"
 #include <iostream>
 #include <cassert>
+#include <cstdio>
 
 int main()
 {
@@ -49,5 +50,938 @@ int main()
         std::cout << db.query("a", 45453, -890, "oiii") << '\n';
         std::cout << db.query("a", 45453) << '\n';
     }
+
+    {
+	Database db;
+	Rule f3{"F", 3};
+	Rule g3{"G", 3};
+	db.add_rule(f3);
+	db.add_rule(g3);
+
+	Database what_if = db.snapshot();
+	Rule g78{"G", 78};
+	what_if.add_rule(g78);
+	assert(what_if.query("G", 78) && !db.query("G", 78));
+	assert(what_if.query("F", 3) && db.query("G", 3));
+
+	Rule f5{"F", 5};
+	db.add_rule(f5);
+	assert(db.query("F", 5) && !what_if.query("F", 5));
+    }
+
+    {
+	// Symbols a snapshot interns stay out of the Database it came from,
+	// and the other way around
+	Database db;
+	assert(db.load("Color(red)."));
+	Database snap = db.snapshot();
+	assert(snap.load("Color(green)."));
+	assert(db.symbols().size() == 1 && snap.symbols().size() == 2);
+	assert(snap.query("Color", snap.symbols().intern("green")));
+	Symbol blue = db.symbols().intern("blue");
+	assert(blue.id == 1 && snap.symbols().name(blue) == "green");
+	assert(db.save("backtrack-test.snapshot"));
+	MappedDatabase saved{"backtrack-test.snapshot"};
+	Symbol symbol;
+	assert(saved.is_open() && saved.find_symbol("blue", symbol) && !saved.find_symbol("green", symbol));
+	std::remove("backtrack-test.snapshot");
+    }
+
+    {
+	// A Rule added by value lives as long as some version holding it does,
+	// not as long as every snapshot of the Database it was added to
+	auto token = std::make_shared<int>(0);
+	Database db;
+	Rule first{"R", token};
+	first << RuleVariable{"S", 1};
+	db.add_rule(std::move(first));
+	auto old = db.snapshot();
+	long before = token.use_count();
+	Rule second{"R", token, 2};
+	second << RuleVariable{"S", 2};
+	db.add_rule(std::move(second));
+	assert(token.use_count() > before);
+	db = Database();
+	assert(token.use_count() == before);
+	old = Database();
+	assert(token.use_count() == 1);
+    }
+
+    {
+	Database db;
+	Rule f3{"F", 3};
+	db.add_rule(f3);
+
+	Rule facts[] = {{"F", 78}, {"G", 3}, {"F", 78}, {"F", 3}, {"U", 8, 6}};
+	auto batch = db.begin_batch();
+	for(auto &fact : facts)
+	    batch.add_rule(fact);
+	assert(!db.query("G", 3));
+	// Both copies of F(78) collapse into one; F(3) is already present
+	assert(batch.commit() == 3);
+	assert(db.query("F", 78) && db.query("G", 3) && db.query("U", 8, 6));
+	assert(!db.query("F", 5) && !db.query("U", 8, 7));
+
+	// Only batches drop duplicates: add_rule() keeps every copy, and a
+	// batch doesn't remove copies already in the Database
+	auto count_f = [&] {
+	    std::size_t count = 0;
+	    db.for_each_rule([&](const Rule &rule) { count += rule.name() == "F"; });
+	    return count;
+	};
+	Rule again{"F", 78};
+	assert(count_f() == 2 && db.add_rule(again) && count_f() == 3);
+	Rule once_more{"F", 78};
+	batch.add_rule(once_more);
+	assert(batch.commit() == 0 && count_f() == 3);
+    }
+
+    {
+	// Examples 1-4 of horne-clause-examples.txt
+	Database db;
+	auto result = db.load(R"(
+	    F(3).
+	    F(78).
+	    G(3).
+	    U(8,6).
+	    Y(7,6).
+
+	    B(x) :- F(x), G(x).
+	    W(x) :- F(x), B(x).
+	    Z(x) :- U(8,x), Y(7,x).
+	    % Prolog-style names: parent is an atom, X is a variable
+	    parent(tom, "bob").
+	    ancestor(X, Y) :- parent(X, Y).
+
+	    ?- B(3).
+	)");
+	assert(result && result.clause_count == 10);
+	assert(db.query("F", 78) && db.query("U", 8, 6) && !db.query("G", 78));
+	assert(db.query("B", 3) && db.query("Z", 6));
+	Symbol tom = db.symbols().intern("tom");
+	assert(db.query("parent", tom, Type<Symbol>()));
+	assert(!db.query("parent", db.symbols().intern("bob"), Type<Symbol>()));
+
+	auto broken = db.load("F(3).\nG(4,.\n");
+	assert(!broken && broken.error_line == 2 && !db.query("F", 3.5));
+    }
+
+    {
+	std::string source;
+	for(int i = 0; i < 1000; ++i)
+	    source += "edge(" + std::to_string(i) + ", node" + std::to_string(i % 10) + ").\n";
+	Database db;
+	auto result = db.load(source, 4);
+	assert(result && result.clause_count == 1000);
+	assert(db.query("edge", 999, db.symbols().intern("node9")));
+	assert(!db.query("edge", 999, db.symbols().intern("node8")));
+
+	auto broken = db.load(source + "edge(1000 node0).\n" + source, 4);
+	assert(!broken && broken.error_line == 1001);
+    }
+    {
+	// Lines ending in '.' inside a comment or quoted atom don't end clauses,
+	// and symbols are numbered as if the source were parsed in one piece
+	std::string source;
+	for(int i = 0; i < 100; ++i) {
+	    std::string n = std::to_string(i);
+	    source += "edge(" + n + ", node" + n + ").\n/* not a clause:\nedge(" + n + ", " + n + ").\n*/\n"
+		"label(" + n + ", 'quoted.\nname" + n + "').\n";
+	}
+	Database one;
+	assert(one.load(source) && one.symbols().size() == 200);
+	for(unsigned threads : {2u, 4u, 8u}) {
+	    Database db;
+	    auto result = db.load(source, threads);
+	    assert(result && result.clause_count == 200);
+	    assert(!db.query("edge", 7, 7));
+	    for(std::uint32_t id = 0; id < 200; ++id)
+		assert(db.symbols().name(Symbol{id}) == one.symbols().name(Symbol{id}));
+	}
+	// A failed load interns nothing, and a later one continues the numbering
+	Database db;
+	assert(db.load("A(foo).") && !db.load("A(bar). B(") && db.symbols().size() == 1);
+	assert(!db.load(source + "B(", 4) && db.symbols().size() == 1);
+	assert(db.load("A(bar). A(foo).") && db.symbols().size() == 2 && db.query("A", Symbol{1}));
+    }
+
+    {
+	Database db;
+	db.load(R"(
+	    F(3).
+	    F(78).
+	    G(3).
+	    Z(x) :- U(8,x), Y(7,x).
+	    U(8,6).
+	    Y(7,6).
+	    parent(tom, bob).
+	    weight(2.5).
+	)");
+	Rule any{"H", Type<int>(), 4LL};
+	any << RuleVariable{"G", 3};
+	db.add_rule(any);
+	assert(db.save("backtrack-test.snapshot"));
+
+	MappedDatabase mapped{"backtrack-test.snapshot"};
+	assert(mapped.is_open());
+	assert(mapped.query("F", 78) && !mapped.query("F", 5) && !mapped.query("F", 3LL));
+	assert(mapped.query("Z", 6) && !mapped.query("Y", 7, 7));
+	assert(mapped.query("H", 1, 4LL) && !mapped.query("H", 1, 4));
+	assert(mapped.query("weight", 2.5) && !mapped.query("nothing", 1));
+	Symbol tom;
+	assert(mapped.find_symbol("tom", tom) && mapped.name(tom) == "tom");
+	assert(mapped.query("parent", tom, Type<Symbol>()));
+
+	// A file cut short anywhere is rejected rather than read past its end
+	std::string saved;
+	{
+	    std::ifstream file("backtrack-test.snapshot", std::ios::binary);
+	    saved.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	for(std::size_t size = 0; size < saved.size(); ++size) {
+	    std::ofstream("backtrack-test.snapshot", std::ios::binary | std::ios::trunc)
+		.write(saved.data(), static_cast<std::streamsize>(size));
+	    assert(!MappedDatabase{"backtrack-test.snapshot"}.is_open());
+	}
+	std::remove("backtrack-test.snapshot");
+
+	// Nothing to write into the tables of an empty Database
+	assert(Database{}.save("backtrack-test.snapshot"));
+	MappedDatabase empty{"backtrack-test.snapshot"};
+	assert(empty.is_open() && !empty.query("F", 78) && !empty.find_symbol("tom", tom));
+	std::remove("backtrack-test.snapshot");
+    }
+
+    {
+	Database db;
+	std::string source = "Q(x) :- Big(Y), Small(x).\n"
+	    "path(x, y) :- Big(x), edge(x, Z), path(Z, y).\n";
+	for(int i = 0; i < 100; ++i)
+	    source += "Big(" + std::to_string(i) + ").\n";
+	for(int i = 0; i < 10; ++i)
+	    source += "Small(" + std::to_string(i) + ").\n";
+	assert(db.load(source));
+
+	// x is bound by the call, so Small(x) is expected to match one clause
+	auto plan = db.explain(RuleVariable{"Q", 5});
+	auto small = plan.find("\n  1. Small(_0)  ");
+	auto big = plan.find("\n  2. Big(_1)  ");
+	assert(small != std::string::npos && big != std::string::npos && small < big);
+	assert(db.query("Q", 5));
+	// Orders are cached per table, so adding clauses must not keep old ones
+	assert(db.load("T(x) :- Big(Y), Small(Y), Tiny(3)."));
+	assert(!db.query("T", 1));
+	assert(db.load("Tiny(3)."));
+	assert(db.query("T", 1));
+
+	// The recursive call is not moved ahead of the goals before it
+	plan = db.explain(RuleVariable{"path", 1, 2});
+	auto edge = plan.find("\n  1. edge(_0, _2)  ");
+	big = plan.find("\n  2. Big(_0)  ");
+	auto path = plan.find("\n  3. path(_2, _1)  ");
+	assert(edge != std::string::npos && big != std::string::npos && path != std::string::npos);
+	assert(edge < big && big < path);
+
+	Rule kept{"K", Type<int>()};
+	kept << RuleVariable{"Big", Type<int>()} << RuleVariable{"Small", 3};
+	kept.keep_order();
+	db.add_rule(kept);
+	plan = db.explain(RuleVariable{"K", 1});
+	assert(plan.find("(order kept)") != std::string::npos && plan.find("1. Big(_)") != std::string::npos);
+    }
+    {
+	// A lowercase name in a rule body is a variable only if the head has it
+	Database db;
+	assert(db.load("Color(blue). Warm(c) :- Color(red), Color(c)."));
+	assert(!db.query("Warm", db.symbols().intern("blue")));
+	assert(db.load("Color(red)."));
+	assert(db.query("Warm", db.symbols().intern("blue")));
+    }
+
+    {
+	Database db;
+	assert(db.load(R"(
+	    F(3). F(78). G(3).
+	    B(x) :- F(x), G(x).
+	    W(x) :- F(x), B(x).
+	    edge(1, 2). edge(2, 3). edge(3, 4). edge(10, 11).
+	    path(x, y) :- edge(x, y).
+	    path(x, y) :- edge(x, Z), path(Z, y).
+	)"));
+
+	FixpointEngine everything;
+	assert(everything.load(db));
+	everything.evaluate();
+	assert(everything.contains(RuleVariable{"B", 3}) && !everything.contains(RuleVariable{"B", 78}));
+	assert(everything.contains(RuleVariable{"W", 3}) && !everything.contains(RuleVariable{"W", 78}));
+	assert(everything.contains(RuleVariable{"path", 1, 4}) && !everything.contains(RuleVariable{"path", 4, 1}));
+	assert(everything.size("path") == 7);
+
+	// Only paths starting from 2 are relevant to path(2, _)
+	FixpointEngine from_two;
+	assert(from_two.load(db));
+	from_two.rewrite_for(RuleVariable{"path", 2, Type<int>()});
+	from_two.evaluate();
+	assert(from_two.contains(RuleVariable{"path", 2, 4}) && !from_two.contains(RuleVariable{"path", 2, 1}));
+	assert(from_two.size("path^bf") == 3 && from_two.size("magic^path^bf") == 3);
+	// Goals no rewrite_for() call covers are answered by evaluating in full
+	assert(from_two.contains(RuleVariable{"path", 10, 11}) && from_two.contains(RuleVariable{"B", 3}));
+	assert(!from_two.contains(RuleVariable{"path", 4, 1}));
+	// A second seed with the same binding pattern only adds its magic fact
+	std::size_t clause_count = from_two.clauses().size();
+	from_two.rewrite_for(RuleVariable{"path", 10, Type<int>()});
+	assert(from_two.clauses().size() == clause_count + 1);
+	from_two.evaluate();
+	assert(from_two.size("path^bf") == 4 && from_two.size("magic^path^bf") == 5);
+	assert(from_two.contains(RuleVariable{"path", 10, 11}) && from_two.contains(RuleVariable{"path", 2, 4}));
+	assert(!from_two.contains(RuleVariable{"path", 10, 4}));
+
+	Rule open_fact{"open", Type<int>()};
+	db.add_rule(open_fact);
+	FixpointEngine unsupported;
+	assert(!unsupported.load(db));
+    }
+
+    {
+	// The triangle body is cyclic, so it is joined by leapfrog triejoin
+	Database db;
+	assert(db.load(R"(
+	    E(1, 2). E(2, 3). E(1, 3). E(3, 4). E(2, 4). E(4, 5). E(1, 5).
+	    T(a, b, c) :- E(a, b), E(b, c), E(a, c).
+	    L(a, c) :- E(a, B), E(B, c).
+	)"));
+	for(auto strategy : {FixpointEngine::JoinStrategy::NestedLoop,
+			     FixpointEngine::JoinStrategy::Leapfrog,
+			     FixpointEngine::JoinStrategy::Automatic}) {
+	    FixpointEngine engine;
+	    engine.set_join_strategy(strategy);
+	    assert(engine.load(db));
+	    engine.evaluate();
+	    assert(engine.size("T") == 2 && engine.size("L") == 5);
+	    assert(engine.contains(RuleVariable{"T", 1, 2, 3}) && engine.contains(RuleVariable{"T", 2, 3, 4}));
+	    assert(!engine.contains(RuleVariable{"T", 1, 3, 4}));
+	}
+    }
+
+    {
+	// Ground facts go into columns but keep their place among the Rules:
+	// C(2) comes after a Rule that unifies with it and fails
+	Database db;
+	db.add_rule(Rule{"C", 1});
+	Rule unprovable{"C", Type<int>()};
+	unprovable << RuleVariable{"Missing"};
+	db.add_rule(unprovable);
+	db.add_rule(Rule{"C", 2});
+	db.add_rule(Rule{"C", 2.5});
+	assert(db.query("C", 1) && !db.query("C", 2) && db.query("C", 2.5));
+	assert(db.explain(RuleVariable{"C", Type<int>()}).find("C(_) matches C(1)") == 0);
+
+	auto batch = db.begin_batch();
+	batch.add_rule(Rule{"U", 8, 6});
+	batch.add_rule(Rule{"U", 8, 7});
+	batch.add_rule(Rule{"U", 8, 6});
+	assert(batch.commit() == 2);
+	batch.add_rule(Rule{"U", 8, 7});
+	assert(batch.commit() == 0);
+	assert(db.query("U", 8, 7) && !db.query("U", 7, 8) && db.query("U", Type<int>(), 6));
+	assert(!db.query("U", 8, 7LL) && !db.query("U", 8));
+    }
+
+    {
+	// Every kernel level agrees with the scalar loops, including the rows
+	// past the last whole vector
+	std::vector<int> ints;
+	std::vector<long long> big_ints;
+	std::vector<double> reals;
+	std::vector<Symbol> symbols;
+	for(int i = 0; i < 150; ++i) {
+	    ints.push_back(i % 7 - 3);
+	    big_ints.push_back((i % 5) * 10'000'000'000LL);
+	    reals.push_back(i % 3 * 0.5);
+	    symbols.push_back(Symbol{static_cast<std::uint32_t>(i % 4)});
+	}
+	auto scan = [&] {
+	    std::vector<std::uint64_t> bits(4 * 3);
+	    ScanKernels::between(ints.data(), ints.size(), -1, 1, &bits[0]);
+	    ScanKernels::equal(big_ints.data(), big_ints.size(), 20'000'000'000LL, &bits[3]);
+	    ScanKernels::between(reals.data(), reals.size(), 0.25, 1.0, &bits[6]);
+	    ScanKernels::equal(symbols.data(), symbols.size(), Symbol{3}, &bits[9]);
+	    return bits;
+	};
+	ScanKernels::use(ScanKernels::Level::Scalar);
+	auto expected = scan();
+	assert((expected[0] & 0b11111) == 0b11100 && expected[2] >> 22 == 0);
+	for(auto level : {ScanKernels::Level::SSE2, ScanKernels::Level::AVX2}) {
+	    ScanKernels::use(level);
+	    assert(scan() == expected);
+	}
+    }
+
+    {
+	// Failing ground lookups are mostly answered by the filter alone
+	Database db;
+	assert(db.load("F(3). F(78). G(3). B(5)."));
+	assert(db.query("B", 5) && !db.query("B", 78) && db.query("F", 78));
+	for(int i = 100; i < 1100; ++i)
+	    assert(!db.query("F", i));
+	// Counted one in FactTable::sample_rate
+	auto stats = db.filter_stats("F");
+	std::size_t sampled = 1000 / FactTable::sample_rate;
+	assert(stats.fact_count == 2 && stats.lookups >= sampled && stats.lookups <= sampled + 1);
+	assert(stats.rejected + stats.false_positives >= sampled && stats.observed_rate() < 0.05);
+	assert(db.filter_stats("Missing").lookups == 0);
+    }
+
+    {
+	// Ground goals on fact-only predicates are set lookups; the set keeps
+	// working as it grows, and a repeated fact is found once
+	Database db;
+	for(int i = 0; i < 5000; ++i)
+	    db.add_rule(Rule{"P", i, static_cast<double>(i) / 2, db.symbols().intern(i % 2 ? "odd" : "even")});
+	db.add_rule(Rule{"P", 4, 2.0, db.symbols().intern("even")});
+	for(int i = 0; i < 5000; i += 7) {
+	    assert(db.query("P", i, static_cast<double>(i) / 2, db.symbols().intern(i % 2 ? "odd" : "even")));
+	    assert(!db.query("P", i, static_cast<double>(i) / 2, db.symbols().intern(i % 2 ? "even" : "odd")));
+	}
+	assert(!db.query("P", 4, 2, db.symbols().intern("even")) && !db.query("P", 5001, 2500.5, Symbol{0}));
+    }
+
+    {
+	// Comparison constraints unify like Predicates, but can be read back
+	Variable<int> over_30;
+	over_30.constrain_greater(30);
+	Variable<int> thirties = over_30;
+	thirties.constrain_less(40);
+	thirties.constrain_less(45, true);
+	assert(!over_30.can_unify(Variable<int>{30}) && over_30.can_unify(Variable<int>{31}));
+	assert(thirties.can_unify(Variable<int>{39}) && !thirties.can_unify(Variable<int>{40}));
+	assert(thirties.upper()->value == 40 && !thirties.upper()->inclusive && !thirties.equals(over_30));
+
+	BTree<int> tree;
+	for(int i = 0; i < 3000; ++i)
+	    tree.insert(i * 7919 % 500, static_cast<std::size_t>(i));
+	int last_key = -1;
+	std::size_t last_row = 0, count = 0;
+	tree.scan(100, 199, [&](int key, std::size_t row) {
+	    assert(key > last_key || (key == last_key && row > last_row));
+	    last_key = key;
+	    last_row = row;
+	    ++count;
+	    return false;
+	});
+	assert(count == 600 && tree.size() == 3000);
+
+	// Sorted or not, and with either kind of constraint, the same
+	// first matching fact is found
+	auto load_ages = [](Database &db) {
+	    for(int i = 0; i < 2000; ++i)
+		db.add_rule(Rule{"age", db.symbols().intern("p" + std::to_string(i)), (i * 37) % 90});
+	};
+	Database scanned, sorted;
+	assert(sorted.add_index("age", 1));
+	load_ages(scanned);
+	load_ages(sorted);
+	assert(!sorted.add_index("age", 2));
+	for(auto *db : {&scanned, &sorted}) {
+	    auto p = [&](const char *name) { return db->symbols().intern(name); };
+	    assert(db->query(RuleVariable{"age", Type<Symbol>(), thirties}));
+	    assert(db->query(RuleVariable{"age", p("p1"), thirties}));
+	    assert(!db->query(RuleVariable{"age", p("p2"), thirties}));
+	    Variable<int> old;
+	    old.constrain_greater(89);
+	    assert(!db->query(RuleVariable{"age", Type<Symbol>(), old}));
+	    old.constrain_less(0);
+	    assert(!db->query(RuleVariable{"age", Type<Symbol>(), old}));
+	    Variable<int> even_thirties = thirties;
+	    even_thirties.constrain([](const int &age) { return age % 2 == 0; });
+	    assert(db->query(RuleVariable{"age", p("p2000"), 36}) == false);
+	    assert(db->query(RuleVariable{"age", Type<Symbol>(), even_thirties}));
+	    assert(db->query("age", p("p3"), 21) && !db->query("age", p("p3"), 22));
+	}
+	assert(scanned.explain(RuleVariable{"age", Type<Symbol>(), thirties})
+	       == sorted.explain(RuleVariable{"age", Type<Symbol>(), thirties}));
+    }
+
+    {
+	// Ground facts added by reference are copied, so need not outlive the
+	// Database
+	Database db;
+	{
+	    Rule fact{"age", db.symbols().intern("ann"), 41};
+	    assert(db.add_rule(fact));
+	}
+	assert(db.query("age", db.symbols().intern("ann"), 41));
+    }
+
+    {
+	// A wide range on a sorted param doesn't drive the lookup when
+	// another param is far more selective
+	static int checks = 0;
+	Database db;
+	assert(db.add_index("reading", 1));
+	for(int i = 0; i < 2000; ++i)
+	    db.add_rule(Rule{"reading", i % 10, i, i});
+	Variable<int> any;
+	any.constrain_greater(0, true);
+	any.constrain([](const int&) { ++checks; return true; });
+	assert(db.query(RuleVariable{"reading", Type<int>(), any, 1500}));
+	assert(checks < 10);
+	Variable<int> narrow;
+	narrow.constrain_greater(1200);
+	narrow.constrain_less(1203);
+	assert(db.query(RuleVariable{"reading", 1, narrow, Type<int>()}));
+	assert(!db.query(RuleVariable{"reading", 5, narrow, Type<int>()}));
+    }
+
+    {
+	// The head index finds exactly the heads that unify, whichever params
+	// are bound, and the first of them still decides
+	std::deque<Rule> heads;
+	HeadIndex index;
+	for(int i = 0; i < 300; ++i) {
+	    Rule &head = heads.emplace_back("H");
+	    if(i % 4 == 0)
+		head.add_param(Var{0});
+	    else if(i % 4 == 1)
+		head.add_param(Type<int>());
+	    else
+		head.add_param(i % 5);
+	    if(i % 11 == 0)
+		head.add_param(Var{1});
+	    else if(i % 3 == 0)
+		head.add_param(Type<double>());
+	    else
+		head.add_param((i % 7) / 2.0);
+	    if(i % 2)
+		head.add_param(std::string("a"));
+	    else
+		head.add_param(Type<std::string>());
+	    index.add(head, static_cast<std::size_t>(i));
+	}
+	for(int first = 0; first < 8; ++first) {
+	    for(int second = 0; second < 6; ++second) {
+		for(int third = 0; third < 3; ++third) {
+		    RuleVariable conjecture{"H"};
+		    if(first < 5)
+			conjecture.add_param(first);
+		    else if(first == 5)
+			conjecture.add_param(Type<int>());
+		    else if(first == 6)
+			conjecture.add_param(Var{5});
+		    else
+			conjecture.add_param(Type<double>());
+		    if(second < 4)
+			conjecture.add_param(second / 2.0);
+		    else if(second == 4)
+			conjecture.add_param(Type<double>());
+		    else
+			conjecture.add_param(Var{6});
+		    if(third < 2)
+			conjecture.add_param(std::string(third ? "a" : "b"));
+		    else
+			conjecture.add_param(Type<std::string>());
+		    std::vector<std::size_t> found, expected;
+		    index.visit(conjecture, [&](std::size_t position) {
+			found.push_back(position);
+			return false;
+		    });
+		    for(std::size_t i = 0; i < heads.size(); ++i) {
+			if(conjecture.can_unify(heads[i]))
+			    expected.push_back(i);
+		    }
+		    assert(found == expected);
+		}
+	    }
+	}
+
+	Database db;
+	Rule missing{"R", 1, Var{0}};
+	missing << RuleVariable{"Missing", Var{0}};
+	db.add_rule(missing);
+	db.add_rule(Rule{"R", Type<int>(), 2});
+	for(int i = 5; i < 10; ++i)
+	    db.add_rule(Rule{"R", i, Type<int>()});
+	assert(!db.query("R", 1, 2) && db.query("R", 3, 2) && db.query("R", 7, 9));
+	assert(!db.query("R", 7, 2.0) && !db.query("R", 3, 3));
+    }
+
+    {
+	// A frozen Database answers as before, finds every predicate through
+	// its perfect hash and refuses changes; earlier snapshots don't freeze
+	Database db;
+	for(int i = 0; i < 500; ++i) {
+	    std::string name = "P" + std::to_string(i);
+	    db.add_rule(Rule{name, i, i * 2});
+	    Rule rule{name, Var{0}, -1};
+	    rule << RuleVariable{name, Var{0}, i * 2};
+	    db.add_rule(std::move(rule));
+	}
+	auto before = db.snapshot();
+	db.freeze();
+	assert(db.is_frozen() && !before.is_frozen());
+	for(int i = 0; i < 500; ++i) {
+	    std::string name = "P" + std::to_string(i);
+	    assert(db.query(name, i, i * 2) && db.query(name, i, -1));
+	    assert(!db.query(name, i, i * 2 + 1) && !db.query(name, -1, i * 2));
+	}
+	assert(!db.query("P500", 500, 1000) && !db.query("", 0));
+	assert(!db.add_rule(Rule{"P500", 500, 1000}) && !db.query("P500", 500, 1000));
+	auto batch = db.begin_batch();
+	batch.add_rule(Rule{"P0", 7, 7});
+	assert(batch.commit() == 0 && !db.query("P0", 7, 7));
+	assert(!db.load("P0(8, 8).") && !db.add_index("P0", 0));
+	auto after = db.snapshot();
+	assert(after.is_frozen() && after.query("P7", 7, 14));
+	assert(before.add_rule(Rule{"P500", 500, 1000}) && before.query("P500", 500, 1000));
+	Database empty;
+	empty.freeze();
+	assert(!empty.query("P0", 0, 0));
+    }
+
+    {
+	// Predicates named by an enum are found by enumerator; clauses named
+	// any other way are refused
+	enum class Name { F, G, B, Count };
+	BasicDatabase<Name> db;
+	db.add_rule(Rule{Name::F, 3});
+	db.add_rule(Rule{Name::F, 78});
+	db.add_rule(Rule{Name::G, 3});
+	Rule b{Name::B, Var{0}};
+	b << RuleVariable{Name::F, Var{0}} << RuleVariable{Name::G, 3};
+	db.add_rule(b);
+	assert(db.query(Name::F, 78) && !db.query(Name::G, 78) && db.query(Name::B, 5));
+	assert(!db.add_rule(Rule{"F", 4}) && !db.add_rule(Rule{static_cast<Name>(7), 4}));
+	assert(!db.query(Name::F, 4) && !db.query(RuleVariable{"F", 3}) && !db.load("F(4)."));
+	assert(db.explain(RuleVariable{Name::B, 5}).rfind("#2(5) matches #2(_0)\n", 0) == 0);
+	std::size_t clause_count = 0;
+	db.for_each_rule([&](const Rule &rule) {
+	    assert(rule.predicate() < 3);
+	    ++clause_count;
+	});
+	assert(clause_count == 4 && db.filter_stats(Name::F).fact_count == 2);
+	auto batch = db.begin_batch();
+	batch.add_rule(Rule{Name::G, 5});
+	batch.add_rule(Rule{"G", 6});
+	assert(batch.commit() == 1 && db.query(Name::G, 5) && !db.query(Name::G, 6));
+	db.freeze();
+	assert(db.query(Name::B, 5) && !db.query(Name::G, 78) && !db.add_rule(Rule{Name::G, 6}));
+    }
+
+    {
+	// Relations check their arguments' types at compile time
+	Relation<int, double, Symbol> prices;
+	for(int i = 0; i < 1000; ++i)
+	    prices.add(i % 100, i / 2.0, Symbol{static_cast<std::uint32_t>(i % 3)});
+	assert(prices.size() == 1000 && prices.query(7, 3.5, Symbol{1}));
+	assert(!prices.query(7, 4.0, Symbol{1}) && !prices.query(100, Type<double>(), Type<Symbol>()));
+	assert(prices.count(7, Type<double>(), Type<Symbol>()) == 10);
+	assert(prices.count(Type<int>(), Type<double>(), Symbol{2}) == 333);
+	double total = 0;
+	prices.for_each_match([&](const auto &fact) {
+	    total += std::get<1>(fact);
+	    return false;
+	}, 1, Type<double>(), Type<Symbol>());
+	assert(total == 2255);
+	Relation<std::string> names;
+	assert(!names.query(std::string("a")));
+	names.add("a");
+	assert(names.query(std::string("a")) && names.count(Type<std::string>()) == 1);
+    }
+    {
+	// Rules over Relations compiled into nested loops
+	Relation<int> f, g, b;
+	Relation<int, int> parent, grandparent;
+	for(int i = 0; i < 100; ++i) {
+	    f.add(i);
+	    if(i % 3 == 0)
+		g.add(i);
+	    parent.add(i, i + 1);
+	}
+	parent.add(7, 7);
+	constexpr Placeholder<0, int> x;
+	constexpr Placeholder<1, int> y;
+	constexpr Placeholder<2, int> z;
+	auto both = (b(x) <<= f(x) && g(x));
+	assert(both.query(9) && !both.query(10) && !both.query(300) && both.query(Type<int>()));
+	std::size_t solutions = 0;
+	both.for_each_solution([&](const std::tuple<int> &head) {
+	    assert(std::get<0>(head) % 3 == 0);
+	    ++solutions;
+	    return false;
+	});
+	assert(solutions == 34);
+	auto grand = (grandparent(x, z) <<= parent(x, y) && parent(y, z));
+	assert(grand.query(3, 5) && !grand.query(3, 4) && grand.query(Type<int>(), 50));
+	assert(grand.query(7, 7) && grand.query(7, 8) && !grand.query(100, Type<int>()));
+	// A variable used twice in one goal must get the same value
+	auto loop = (b(x) <<= parent(x, x));
+	assert(loop.query(7) && !loop.query(8) && loop.query(Type<int>()));
+	solutions = 0;
+	grand.for_each_solution([&](const std::tuple<int, int> &head) {
+	    assert(std::get<1>(head) - std::get<0>(head) == 2 || std::get<1>(head) == 7
+		   || std::get<0>(head) == 7);
+	    ++solutions;
+	    return false;
+	});
+	// 7 is its own parent, so (7, 7), (7, 8) and (6, 7) are also found
+	assert(solutions == 99 + 3 && grand.query(6, 7));
+	// Goals on a Database's predicates
+	Database db;
+	for(int i = 0; i < 10; ++i)
+	    db.add_rule(Rule{"small", i});
+	auto checked = (b(x) <<= f(x) && goal(db, "small", x));
+	assert(checked.query(5) && !checked.query(50) && checked.query(Type<int>()));
+	auto constant = (b(x) <<= f(x) && goal(db, "small", 3) && g(x));
+	assert(constant.query(3) && !constant.query(4));
+    }
+    {
+	// Prolog programs compiled for the abstract machine
+	AbstractMachine machine;
+	auto loaded = machine.consult(
+	    "app([], L, L).\n"
+	    "app([H|T], L, [H|R]) :- app(T, L, R).\n"
+	    "nrev([], []).\n"
+	    "nrev([H|T], R) :- nrev(T, RT), app(RT, [H], R).\n"
+	    "len([], 0).\n"
+	    "len([_|T], N) :- len(T, M), N is M + 1.\n"
+	    "max(X, Y, X) :- X >= Y, !.\n"
+	    "max(_, Y, Y).\n"
+	    "color(red). color(green). color(blue).\n");
+	assert(loaded && loaded.clause_count == 11);
+	assert(machine.query("nrev([1, 2, 3], [3, 2, 1])") && !machine.query("nrev([1, 2], [1, 2])"));
+	std::vector<std::string> splits;
+	machine.for_each_solution("app(X, Y, [1, 2])", [&](const AbstractMachine::Answer &answer) {
+	    splits.push_back(answer[0].second + " " + answer[1].second);
+	    return false;
+	});
+	assert((splits == std::vector<std::string>{"[] [1, 2]", "[1] [2]", "[1, 2] []"}));
+	std::string value;
+	machine.for_each_solution("len([a, b, c], N), max(N, 2, M)", [&](const AbstractMachine::Answer &answer) {
+	    value = answer[1].second;
+	    return true;
+	});
+	assert(value == "3");
+	assert(machine.query("X = f(Y, [a|Z]), Y = 2.5, Z = [], X = f(2.5, [a])"));
+	assert(machine.query("a \\= b") && !machine.query("X \\= a") && machine.query("color(C), C \\= red"));
+	std::size_t color_count = 0;
+	machine.for_each_solution("color(C)", [&](const AbstractMachine::Answer&) {
+	    ++color_count;
+	    return false;
+	});
+	assert(color_count == 3 && machine.inference_count() > 0);
+	assert(!machine.consult("p(X) :- X is .").error.empty() && !machine.consult("p(X").error.empty());
+	// A Database's clauses, with bindings flowing between goals
+	Database db;
+	db.load("F(3). F(78). G(3). B(x) :- F(x), G(x).");
+	AbstractMachine from_db;
+	assert(from_db.load(db));
+	assert(from_db.query(RuleVariable{"B", 3}, db.symbols()) && !from_db.query(RuleVariable{"B", 78}, db.symbols()));
+	assert(from_db.query(RuleVariable{"B", Var{0}}, db.symbols()) && from_db.query("'F'(78)"));
+	// A Symbol the table never interned matches nothing
+	assert(!from_db.query(RuleVariable{"B", Symbol{1000}}, db.symbols()));
+	// Numbers too large for a cell are boxed, and still compare by value
+	assert(sizeof(AbstractMachine::Cell) == 8);
+	assert(machine.consult("big(4611686018427387904). big(-3000000000000000000). ratio(0.25).\n"));
+	assert(machine.query("big(4611686018427387904)") && !machine.query("big(4611686018427387905)"));
+	assert(machine.query("big(X), X < 0, Y is X * 2, Y < X") && machine.query("ratio(0.25)"));
+	assert(machine.query("X is 2305843009213693952 * 2, big(X)") && !machine.query("ratio(0.5)"));
+	// Number literals that don't fit are errors, and the smallest long long
+	// fits
+	assert(!machine.consult("p(99999999999999999999).\n") && !machine.query("p(9223372036854775807)"));
+	assert(!machine.query("X is 9223372036854775808"));
+	assert(machine.query("X is -9223372036854775808, Y is X + 1, Y = -9223372036854775807"));
+	// Integer arithmetic that overflows fails
+	assert(!machine.query("X is 4611686018427387904 * 2") && !machine.query("X is 9223372036854775807 + 1"));
+	assert(machine.query("X is 0 - 9223372036854775807 - 1, Y is X mod -1, Y = 0"));
+	assert(!machine.query("X is 0 - 9223372036854775807 - 1, Y is X // -1"));
+	assert(!machine.query("X is 0 - 9223372036854775807 - 1, Y is -X"));
+	assert(!machine.query("X is 0 - 9223372036854775807 - 2"));
+	assert(machine.query("X is 9223372036854775807 // -1, X < 0"));
+	value.clear();
+	machine.for_each_solution("big(X), X > 0", [&](const AbstractMachine::Answer &answer) {
+	    value = answer[0].second;
+	    return true;
+	});
+	assert(value == "4611686018427387904");
+	// A query's own boxes go when it ends
+	std::size_t heap_size = machine.heap_size();
+	assert(machine.query("X = 1.5, Y is X * 4611686018427387904") && machine.heap_size() == heap_size);
+	// Solutions as Variables: a Var gets the narrowest type that holds its
+	// value, and a Type<T> a T
+	from_db.consult("pair(1, 7000000000). pair(2, 2.5). pair(3, red).\n");
+	std::vector<std::string> rows;
+	from_db.for_each_solution(RuleVariable{"pair", Var{0}, Var{1}}, db.symbols(), [&](const RuleVariable &solution) {
+	    rows.push_back(solution[0]->to_string() + " " + solution[1]->to_string());
+	    assert(dynamic_cast<const Variable<int>*>(solution[0]));
+	    return false;
+	});
+	assert((rows == std::vector<std::string>{"1 7000000000", "2 2.5", "3 ?"}));
+	std::size_t typed = 0;
+	from_db.for_each_solution(RuleVariable{"pair", Type<long long>(), Type<Symbol>()}, db.symbols(),
+				  [&](const RuleVariable &solution) {
+	    if(auto *color = dynamic_cast<const Variable<Symbol>*>(solution[1]); color && color->is_unified()) {
+		assert(db.symbols().name(color->value()) == "red");
+		assert(static_cast<const Variable<long long>*>(solution[0])->value() == 3);
+		++typed;
+	    } else {
+		assert(!solution[1]->is_unified());
+	    }
+	    return false;
+	});
+	assert(typed == 1);
+    }
+    {
+	// Aliasing unbound variables, then binding any one of them
+	Bindings bindings;
+	std::size_t x = bindings.add(4);
+	assert(bindings.unify(x, x + 1) && bindings.unify(x + 2, x + 1) && !bindings.is_bound(x));
+	Variable<int> five{5}, also_five{5}, six{6}, small;
+	small.constrain_less(10);
+	assert(bindings.bind(x + 3, small) && bindings.unify(x + 3, x));
+	auto mark = bindings.mark();
+	assert(bindings.bind(x + 2, five) && bindings.is_bound(x) && bindings.is_aliased(x, x + 3));
+	assert(static_cast<const Variable<int>*>(bindings.value(x + 3))->value() == 5);
+	assert(!bindings.bind(x, six) && bindings.bind(x + 1, also_five));
+	bindings.undo(mark);
+	assert(!bindings.is_bound(x) && bindings.bind(x, six) && bindings.is_bound(x + 3));
+	// The constraints of both sides still hold after aliasing
+	Variable<int> large, big_value{50}, mid_value{7}, three{3};
+	Variable<long long> wrong_type{7};
+	large.constrain_greater(5);
+	std::size_t y = bindings.add(2);
+	assert(bindings.bind(y, small) && bindings.bind(y + 1, large) && bindings.unify(y, y + 1));
+	mark = bindings.mark();
+	assert(!bindings.bind(y, big_value) && !bindings.bind(y, three));
+	assert(bindings.bind(y + 1, mid_value) && bindings.is_bound(y));
+	bindings.undo(mark);
+	assert(!bindings.is_bound(y) && !bindings.bind(y, wrong_type));
+	// The machine shortens chains of aliased variables, but not past a
+	// binding that backtracking would undo
+	AbstractMachine machine;
+	machine.consult("alias([_]).\n"
+			"alias([X, Y|T]) :- alias([Y|T]), X = Y.\n"
+			"color(red). color(green). color(blue).\n");
+	assert(machine.query("L = [A, B, C, D], alias(L), color(D), A = blue, C = blue"));
+	assert(machine.query("L = [A, B, C], color(B), alias(L), A = green, C = green"));
+	assert(!machine.query("L = [A, B, C], alias(L), A = 1, C = 2"));
+    }
+    {
+	// Resolution with bindings kept per query
+	Database db;
+	db.load("F(3). F(78). G(3). B(x) :- F(x), G(x).\n"
+		"Same(X, X).\n"
+		"P(x, y) :- Same(x, y), F(y).\n"
+		"Edge(1, 2). Edge(2, 3). Edge(3, 4).\n"
+		"Path(x, y) :- Edge(x, y).\n"
+		"Path(x, z) :- Edge(x, Y), Path(Y, z).\n");
+	std::vector<std::string> found;
+	auto collect = [&](const RuleVariable &solution) {
+	    std::string text;
+	    for(std::size_t i = 0; i < solution.arity(); ++i)
+		text += (i ? " " : "") + solution[i]->to_string();
+	    found.push_back(text);
+	    return false;
+	};
+	assert(db.for_each_solution(RuleVariable{"B", Var{0}}, collect));
+	assert((found == std::vector<std::string>{"3"}));
+	// Same(X, X) aliases two unbound variables
+	found.clear();
+	db.for_each_solution(RuleVariable{"P", Var{0}, Var{1}}, collect);
+	assert((found == std::vector<std::string>{"3 3", "78 78"}));
+	found.clear();
+	db.for_each_solution(RuleVariable{"Path", 1, Type<int>()}, collect);
+	assert((found == std::vector<std::string>{"1 2", "1 3", "1 4"}));
+	assert(!db.for_each_solution(RuleVariable{"Path", 4, Var{0}}, collect));
+	assert(db.for_each_solution(RuleVariable{"Path", Var{0}, 4}, [](const RuleVariable &solution) {
+	    return solution[0]->to_string() == "1";
+	}));
+	// K has enough Rules for its head index to be walked, where an
+	// unbound param has to reach the heads with variables too
+	db.load("A(1). A(2). C(0.5). C(1.5).\n"
+		"K(1, x) :- A(x). K(2, x) :- C(x). K(3, 7).\n"
+		"K(4, x) :- C(x), A(x). K(5, 2.5). K(6, x) :- A(x).\n");
+	found.clear();
+	db.for_each_solution(RuleVariable{"K", Var{0}, Var{1}}, collect);
+	assert((found == std::vector<std::string>{"1 1", "1 2", "2 0.5", "2 1.5", "3 7", "5 2.5", "6 1", "6 2"}));
+	found.clear();
+	db.for_each_solution(RuleVariable{"K", 6, Var{0}}, collect);
+	assert((found == std::vector<std::string>{"6 1", "6 2"}));
+	// The same Database from several threads at once
+	std::vector<std::thread> workers;
+	std::atomic<std::size_t> path_count{0};
+	for(int t = 0; t < 4; ++t) {
+	    workers.emplace_back([&] {
+		for(int i = 0; i < 50; ++i) {
+		    db.for_each_solution(RuleVariable{"Path", Var{0}, Var{1}}, [&](const RuleVariable&) {
+			++path_count;
+			return false;
+		    });
+		}
+	    });
+	}
+	for(auto &worker : workers)
+	    worker.join();
+	assert(path_count == 4 * 50 * 6);
+    }
+    {
+	// Probes and the values of fact rows are reused on backtracking,
+	// also when the next value has another type
+	Database db;
+	db.load("A(1). A(2). C(0.5). C(1.5).\n"
+		"R(x, y) :- A(x), C(y).\n"
+		"R(x, y) :- C(x), A(y).\n");
+	std::vector<std::string> found;
+	auto collect = [&](const RuleVariable &solution) {
+	    found.push_back(solution[0]->to_string() + " " + solution[1]->to_string());
+	    return false;
+	};
+	db.for_each_solution(RuleVariable{"R", Var{0}, Var{1}}, collect);
+	assert((found == std::vector<std::string>{"1 0.5", "1 1.5", "2 0.5", "2 1.5",
+						   "0.5 1", "0.5 2", "1.5 1", "1.5 2"}));
+    }
+    {
+	// Dropping slots moves the newer ones down; one whose root is dropped
+	// becomes the root, with the class's value and constraints
+	Bindings bindings;
+	Variable<int> small, large, seven{7}, fifty{50}, three{3};
+	small.constrain_less(10);
+	large.constrain_greater(5);
+	std::size_t x = bindings.add(5);
+	assert(bindings.bind(x + 1, small) && bindings.bind(x + 4, large));
+	assert(bindings.unify(x + 3, x + 1) && bindings.unify(x + 4, x + 3) && bindings.unify(x, x + 2));
+	auto mark = bindings.mark();
+	assert(!bindings.discard(x + 1, x + 3));
+	bindings.release(mark);
+	assert(bindings.discard(x + 1, x + 3) && bindings.size() == x + 3);
+	assert(bindings.is_aliased(x + 1, x + 2) && !bindings.is_aliased(x, x + 1));
+	assert(!bindings.bind(x + 2, fifty) && !bindings.bind(x + 2, three));
+	assert(bindings.bind(x + 1, seven) && bindings.is_bound(x + 2));
+
+	// Deterministic tail calls reuse their caller's frame, also when the
+	// caller's slots are aliased with the callee's
+	Database db;
+	std::string source = "Last(x, y) :- Step(x, Z), Last(Z, y).\n"
+	    "Last(1000, 1000).\n"
+	    "Bind(7).\n"
+	    "Twin(x) :- Both(W, W, x).\n"
+	    "Both(a, b, x) :- Bind(a), Copy(b, x).\n"
+	    "Copy(X, X).\n";
+	for(int i = 0; i < 1000; ++i)
+	    source += "Step(" + std::to_string(i) + ", " + std::to_string(i + 1) + ").\n";
+	db.load(source);
+	std::vector<std::string> found;
+	auto collect = [&](const RuleVariable &solution) {
+	    found.push_back(solution[solution.arity() - 1]->to_string());
+	    return false;
+	};
+	db.for_each_solution(RuleVariable{"Last", 0, Var{0}}, collect);
+	db.for_each_solution(RuleVariable{"Twin", Var{0}}, collect);
+	assert((found == std::vector<std::string>{"1000", "7"}));
+	// A tail call with clauses left to try keeps its frame
+	found.clear();
+	db.load("Path(x, y) :- Step(x, y).\nPath(x, z) :- Step(x, Y), Path(Y, z).\n");
+	db.for_each_solution(RuleVariable{"Path", 995, Var{0}}, collect);
+	assert((found == std::vector<std::string>{"996", "997", "998", "999", "1000"}));
+    }
     return 0;
 }